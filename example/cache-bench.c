@@ -0,0 +1,142 @@
+
+#include "flexop.h"
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+/* options in the options file, a vector every 100 */
+#define NOPTS   20000
+#define VLEN    100
+
+static FLEXOP_INT ivar[NOPTS];
+static FLEXOP_FLOAT fvar[NOPTS];
+static char *svar[NOPTS];
+static FLEXOP_VEC vvar[NOPTS / 100];
+
+static double elapsed(struct timeval *t0)
+{
+    struct timeval t1;
+
+    gettimeofday(&t1, NULL);
+
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_usec - t0->tv_usec) * 1e-6;
+}
+
+static void register_options(void)
+{
+    char name[32];
+    int i;
+
+    for (i = 0; i < NOPTS; i++) {
+        sprintf(name, "bench.opt%d", i);
+
+        if (i % 100 == 0) {
+            flexop_register_vec_float(name, "a vector", vvar + i / 100);
+        }
+        else if (i % 3 == 0) {
+            flexop_register_string(name, "a string", svar + i);
+        }
+        else if (i % 3 == 1) {
+            flexop_register_int(name, "an integer", ivar + i);
+        }
+        else {
+            flexop_register_float(name, "a real", fvar + i);
+        }
+    }
+}
+
+static int write_file(const char *fn)
+{
+    FILE *fp;
+    int i, j;
+
+    if ((fp = fopen(fn, "w")) == NULL) return 0;
+
+    for (i = 0; i < NOPTS; i++) {
+        fprintf(fp, "-bench.opt%d ", i);
+
+        if (i % 100 == 0) {
+            fputc('"', fp);
+            for (j = 0; j < VLEN; j++) fprintf(fp, "%s%.17g", j > 0 ? " " : "", (i + j) / 7.);
+            fputs("\"\n", fp);
+        }
+        else if (i % 3 == 0) {
+            fprintf(fp, "\"value %d\"\n", i);
+        }
+        else if (i % 3 == 1) {
+            fprintf(fp, "%d\n", -i);
+        }
+        else {
+            fprintf(fp, "%.17g\n", i / 3.);
+        }
+    }
+
+    return fclose(fp) == 0;
+}
+
+/* flexop_init reads the options file in a new process, as a program which
+ * starts */
+static void run(const char *label, const char *fn, int cache)
+{
+    char *args[] = {"cache-bench", "-option_file", NULL, NULL}, **argv = args;
+    struct timeval t0;
+    double t;
+    int argc = 3, status;
+    pid_t pid;
+
+    fflush(stdout);
+
+    if ((pid = fork()) < 0) {
+        perror("fork");
+        exit(1);
+    }
+
+    if (pid > 0) {
+        waitpid(pid, &status, 0);
+        return;
+    }
+
+    args[2] = (char *)fn;
+    register_options();
+    if (cache) flexop_enable_cache(NULL);
+
+    gettimeofday(&t0, NULL);
+    flexop_init(&argc, &argv);
+    t = elapsed(&t0);
+
+    if (ivar[1] != -1 || flexop_vec_get_size(vvar + 1) != VLEN) {
+        printf("%s: wrong values\n", label);
+        exit(1);
+    }
+
+    printf("%-24s %8.2f ms\n", label, t * 1e3);
+
+    flexop_finalize();
+    exit(0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *fn = argc > 1 ? argv[1] : "/tmp/flexop-cache-bench.opt";
+    char cache[1024];
+    int i;
+
+    if (!write_file(fn)) {
+        fprintf(stderr, "cannot write \"%s\"\n", fn);
+        return 1;
+    }
+
+    snprintf(cache, sizeof(cache), "%s.cache", fn);
+    unlink(cache);
+
+    printf("flexop_init with an options file of %d options:\n", NOPTS);
+
+    run("without cache", fn, 0);
+    run("cold (cache saved)", fn, 1);
+    for (i = 0; i < 3; i++) run("warm (cache loaded)", fn, 1);
+
+    unlink(cache);
+    unlink(fn);
+
+    return 0;
+}
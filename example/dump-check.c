@@ -0,0 +1,171 @@
+
+#include "flexop.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static int b_opt;
+static FLEXOP_INT i_opt;
+static FLEXOP_UINT u_opt;
+static FLEXOP_FLOAT f_opt;
+static char *s_opt = "default";
+static FLEXOP_SIZE z_opt;
+static FLEXOP_DURATION d_opt;
+static int k_opt;
+static float f32_opt;
+static int64_t i64_opt;
+static FLEXOP_VEC vi_opt, vf_opt, vs_opt, vz_opt;
+
+/* options set before the dump, each case in new processes */
+static const char *cases[] = {
+    "",
+    "-vec_string \"\"",
+    "-vec_string \"a b\" -vec_int \"\"",
+    "-bool -int -42 -uint 7 -float 2.5e-3 -string \"two \\\"quoted\\\" words # not a comment\" -size 64k "
+        "-duration 150ms -keyword ilu -float32 0.1 -int64 -9000000000000000000 -vec_int \"1 -2 3\" "
+        "-vec_float \"1e-300 2.5 inf\" -vec_string \"a b\\\\c d\" -vec_size \"1k 3M\"",
+    "+bool -string \"\" -float -0",
+    NULL
+};
+
+static void register_options(void)
+{
+    static const char *keys[] = {"jacobi", "gauss-seidel", "ilu", NULL};
+
+    flexop_register_title("Solver", "options of the solver", "solver");
+    flexop_register_bool("bool", "a boolean", &b_opt);
+    flexop_register_int("int", "an integer", &i_opt);
+    flexop_register_uint("uint", "an unsigned integer", &u_opt);
+    flexop_register_float("float", "a real", &f_opt);
+    flexop_register_string("string", "a string\nwith a second line", &s_opt);
+    flexop_register_size("size", "a size", &z_opt);
+    flexop_register_duration("duration", "a duration", &d_opt);
+    flexop_register_keyword("keyword", "a keyword", keys, &k_opt);
+    flexop_register_number("float32", "a single precision real", &f32_opt, FLEXOP_FLOAT32);
+    flexop_register_number("int64", "a 64-bit integer", &i64_opt, FLEXOP_INT64);
+
+    flexop_register_vec_int("vec_int", "integers", &vi_opt);
+    flexop_register_vec_float("vec_float", "reals", &vf_opt);
+    flexop_register_vec_string("vec_string", "strings", &vs_opt);
+    flexop_register_vec_size("vec_size", "sizes", &vz_opt);
+}
+
+/* runs f(opts, fn) in a new process, returns 1 if it succeeds */
+static int spawn(int (*f)(const char *, const char *), const char *opts, const char *fn)
+{
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+
+    if ((pid = fork()) < 0) {
+        perror("fork");
+        exit(1);
+    }
+
+    if (pid == 0) exit(f(opts, fn));
+
+    waitpid(pid, &status, 0);
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/* sets the options of case 'opts' and dumps all of them to fn */
+static int writer(const char *opts, const char *fn)
+{
+    char *args[] = {"dump-check", NULL}, **argv = args;
+    int argc = 1, fd, ok;
+
+    register_options();
+    flexop_init(&argc, &argv);
+
+    if (*opts != '\0') flexop_set_options(opts);
+
+    if ((fd = open(fn, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) return 1;
+
+    ok = flexop_dump_fd(fd, FLEXOP_DUMP_ALL | FLEXOP_DUMP_COMMENTS);
+    close(fd);
+
+    flexop_finalize();
+
+    return !ok;
+}
+
+/* reads fn back with -option_file and dumps again to fn + ".2" */
+static int reader(const char *opts, const char *fn)
+{
+    char *args[] = {"dump-check", "-option_file", NULL, NULL}, **argv = args;
+    char out[1024];
+    FILE *fp;
+    int argc = 3, ok;
+
+    args[2] = (char *)fn;
+    register_options();
+    flexop_init(&argc, &argv);
+
+    snprintf(out, sizeof(out), "%s.2", fn);
+    if ((fp = fopen(out, "w")) == NULL) return 1;
+
+    ok = flexop_dump(fp, FLEXOP_DUMP_ALL | FLEXOP_DUMP_COMMENTS);
+    fclose(fp);
+
+    flexop_finalize();
+    (void)opts;
+
+    return !ok;
+}
+
+static char * read_file(const char *fn, size_t *n)
+{
+    FILE *fp;
+    char *s;
+    long len;
+
+    if ((fp = fopen(fn, "r")) == NULL) return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    rewind(fp);
+
+    s = flexop_malloc(len + 1);
+    *n = fread(s, 1, len, fp);
+    s[*n] = '\0';
+    fclose(fp);
+
+    return s;
+}
+
+int main(int argc, char **argv)
+{
+    const char *fn = argc > 1 ? argv[1] : "/tmp/flexop-dump-check.opt";
+    char fn2[1024], *a, *b;
+    size_t na = 0, nb = 0;
+    int i, bad = 0;
+
+    snprintf(fn2, sizeof(fn2), "%s.2", fn);
+
+    for (i = 0; cases[i] != NULL; i++) {
+        a = b = NULL;
+
+        if (!spawn(writer, cases[i], fn) || !spawn(reader, NULL, fn)) {
+            printf("case %d: failed\n", i);
+            bad++;
+        }
+        else if ((a = read_file(fn, &na)) == NULL || (b = read_file(fn2, &nb)) == NULL
+                || na != nb || memcmp(a, b, na) != 0) {
+            printf("case %d: read back differs\n--- dump\n%s--- read back\n%s", i, a ? a : "", b ? b : "");
+            bad++;
+        }
+
+        flexop_free(a);
+        flexop_free(b);
+    }
+
+    printf("%d dumps read back with -option_file: %s\n", i, bad ? "FAILED" : "ok");
+
+    unlink(fn);
+    unlink(fn2);
+
+    return bad != 0;
+}
@@ -0,0 +1,236 @@
+
+#include "flexop.h"
+
+#include <float.h>
+#include <math.h>
+
+/* random inputs of each kind, and numbers of the vector benchmark */
+#define NRANDOM     200000
+#define NVEC        1000000
+
+static uint64_t seed;
+static int nfail = 0, ntest = 0;
+
+/* xorshift64, the same inputs every run for a given seed */
+static uint64_t rnd(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+
+    return seed;
+}
+
+static double elapsed(struct timeval *t0)
+{
+    struct timeval t1;
+
+    gettimeofday(&t1, NULL);
+
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_usec - t0->tv_usec) * 1e-6;
+}
+
+/* flexop_parse_double must give the bits and the end of strtod */
+static void check(const char *s)
+{
+    const char *e1;
+    char *e2;
+    double v1 = 0, v2;
+    int r;
+
+    ntest++;
+
+    r = flexop_parse_double(s, &e1, &v1);
+    v2 = strtod(s, &e2);
+
+    if (r == 1 && e1 == e2 && (memcmp(&v1, &v2, sizeof(v1)) == 0 || (isnan(v1) && isnan(v2)))) return;
+    if (r == 0 && e2 == s) return;
+
+    if (nfail++ < 10) {
+        printf("mismatch for \"%.80s%s\": flexop %d %.17g (end %d), strtod %.17g (end %d)\n", s,
+                strlen(s) > 80 ? "..." : "", r, v1, r ? (int)(e1 - s) : -1, v2, (int)(e2 - s));
+    }
+}
+
+static double random_double(void)
+{
+    uint64_t u;
+    double x;
+
+    /* finite values of all exponents, subnormals included */
+    do {
+        u = rnd();
+        memcpy(&x, &u, sizeof(x));
+    } while (isnan(x) || isinf(x));
+
+    return x;
+}
+
+/* shortest and longer representations of random doubles */
+static void check_doubles(void)
+{
+    char s[64];
+    double x;
+    int i;
+
+    for (i = 0; i < NRANDOM; i++) {
+        x = random_double();
+
+        sprintf(s, "%.17g", x);
+        check(s);
+
+        sprintf(s, "%.*g", 1 + (int)(rnd() % 17), x);
+        check(s);
+    }
+}
+
+/* random decimal strings: up to 40 digits, a decimal point anywhere and
+ * exponents beyond the range of doubles */
+static void check_decimals(void)
+{
+    char s[128], *p;
+    int i, j, n, dot;
+
+    for (i = 0; i < NRANDOM; i++) {
+        p = s;
+        if (rnd() & 1) *(p++) = '-';
+
+        n = 1 + (int)(rnd() % 40);
+        dot = (int)(rnd() % (n + 1));
+
+        for (j = 0; j < n; j++) {
+            if (j == dot) *(p++) = '.';
+            *(p++) = '0' + (char)(rnd() % 10);
+        }
+
+        sprintf(p, "e%d", (int)(rnd() % 700) - 360);
+        check(s);
+    }
+}
+
+/* exactly halfway between two neighbouring doubles, with up to 770
+ * significant digits, and just above and below. The midpoint of doubles
+ * needs 54 bits, it is exact in long double where it has more. */
+static void check_halfway(void)
+{
+    static char s[1024];
+    long double m;
+    double x, y;
+    char *p, *e;
+    int i;
+
+    if (LDBL_MANT_DIG < DBL_MANT_DIG + 1) {
+        printf("halfway cases skipped, long double has %d bits\n", LDBL_MANT_DIG);
+        return;
+    }
+
+    for (i = 0; i < NRANDOM / 10; i++) {
+        x = fabs(random_double());
+        y = nextafter(x, INFINITY);
+        if (isinf(y)) continue;
+
+        m = (long double)x / 2 + (long double)y / 2;
+        sprintf(s, "%.800Le", m);
+        check(s);
+
+        /* the last nonzero digit of the exact value, just above */
+        e = strchr(s, 'e');
+        for (p = e - 1; *p == '0'; p--);
+        p[1] = '1';
+        check(s);
+
+        /* and just below: the value with the digit decreased and 9s */
+        sprintf(s, "%.800Le", m);
+        for (p = e - 1; *p == '0'; p--) *p = '9';
+        if (*p != '.') {
+            (*p)--;
+            check(s);
+        }
+    }
+}
+
+/* hard cases: ties, the limits of normal and subnormal numbers, 19 and
+ * more digits, long mantissas */
+static void check_hard(void)
+{
+    static const char *hard[] = {
+        "0", "-0", "0.0e999999", "1e-999999", "1e999999", "inf", "-Infinity", "nan", ".5", "5.", "1e", "+.e1",
+        "0.1", "0.2", "0.3", "1e23", "8.41e21", "5e-324", "4e-324", "3e-324", "2e-324",
+        "2.4703282292062327e-324", "2.4703282292062328e-324",
+        "2.2250738585072011e-308", "2.2250738585072012e-308", "2.2250738585072014e-308",
+        "1.7976931348623157e308", "1.7976931348623158e308", "1.7976931348623159e308",
+        "9007199254740992", "9007199254740993", "9007199254740994", "9007199254740995",
+        "9223372036854775807", "9223372036854775808", "18446744073709551615", "18446744073709551616",
+        "1234567890123456789", "12345678901234567890", "123456789012345678901234567890",
+        "0.000000000000000000000000000000000000000000001234567890123456789",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203124999999999999999999999",
+        "1.00000000000000011102230246251565404236316680908203125000000000000000000001",
+        "7.2057594037927933e16", "72057594037927933", "72057594037927935",
+        "3.4028235677973366e38", "1.1754943508222875e-38",
+        "179769313486231580793728971405303415079934132710037826936173778980444968292764750946649017977587"
+        "207096330286416692887910946555547851940402630657488671505820681908902000708383676273854845817711"
+        "531764475730270069855571366959622842914819860834936475292719074168444365510704342711559699508093"
+        "042880177904174497791.9999999999999999999999999999999999999999999999999999999999999999999999",
+        NULL
+    };
+    const char **p;
+
+    for (p = hard; *p != NULL; p++) check(*p);
+}
+
+/* parsing a long vector, number by number and as option v */
+static void bench_vector(FLEXOP_VEC *v)
+{
+    FLEXOP_BUF b;
+    FLEXOP_FLOAT f;
+    struct timeval t0;
+    const char *p;
+    char *q, *e;
+    double t, sum = 0;
+    int i, n;
+
+    flexop_buf_init(&b);
+    for (i = 0; i < NVEC; i++) flexop_buf_printf(&b, "%s%.*g", i > 0 ? " " : "", 1 + i % 17, random_double());
+
+    gettimeofday(&t0, NULL);
+    for (p = b.d, n = 0; flexop_parse_float(p, &p, &f) == 1; n++);
+    t = elapsed(&t0);
+    printf("flexop_parse_float: %d numbers, %.1f MB/s, %.1f M numbers/s\n", n, b.size / t * 1e-6, n / t * 1e-6);
+
+    gettimeofday(&t0, NULL);
+    for (q = b.d, n = 0; sum += strtod(q, &e), e != q; q = e, n++);
+    t = elapsed(&t0);
+    printf("strtod:             %d numbers, %.1f MB/s, %.1f M numbers/s\n", n, b.size / t * 1e-6, n / t * 1e-6);
+
+    gettimeofday(&t0, NULL);
+    flexop_set_vec_float("vec", b.d);
+    t = elapsed(&t0);
+    printf("flexop_set_vec_float: %ld elements, %.1f MB/s\n", (long)flexop_vec_get_size(v), b.size / t * 1e-6);
+
+    flexop_buf_destroy(&b);
+}
+
+int main(int argc, char **argv)
+{
+    FLEXOP_UINT s = 0;
+    FLEXOP_VEC v;
+
+    flexop_register_uint("seed", "seed of the random inputs", &s);
+    flexop_register_vec_float("vec", "the vector of the benchmark", &v);
+    flexop_init(&argc, &argv);
+
+    seed = 88172645463325252ull ^ s;
+
+    check_hard();
+    check_doubles();
+    check_decimals();
+    check_halfway();
+
+    printf("flexop_parse_double against strtod: %d inputs, %d mismatches\n", ntest, nfail);
+
+    bench_vector(&v);
+    flexop_finalize();
+
+    return nfail != 0;
+}
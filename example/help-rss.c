@@ -0,0 +1,84 @@
+
+#include "flexop.h"
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+/* 9000 distinct help strings, string literals as in real programs */
+#define H1(n)       "Option " #n " of a large registry: this help text is long enough to be " \
+                    "representative of real programs, with a default, units and a range of values.",
+#define H10(n)      H1(n##0) H1(n##1) H1(n##2) H1(n##3) H1(n##4) \
+                    H1(n##5) H1(n##6) H1(n##7) H1(n##8) H1(n##9)
+#define H100(n)     H10(n##0) H10(n##1) H10(n##2) H10(n##3) H10(n##4) \
+                    H10(n##5) H10(n##6) H10(n##7) H10(n##8) H10(n##9)
+#define H1000(n)    H100(n##0) H100(n##1) H100(n##2) H100(n##3) H100(n##4) \
+                    H100(n##5) H100(n##6) H100(n##7) H100(n##8) H100(n##9)
+
+static const char *helps[] = {
+    H1000(1) H1000(2) H1000(3) H1000(4) H1000(5) H1000(6) H1000(7) H1000(8) H1000(9)
+};
+
+#define NOPTS   ((int)(sizeof(helps) / sizeof(*helps)))
+
+static FLEXOP_INT vars[NOPTS];
+
+/* resident set size in KiB, -1 if unknown */
+static long rss(void)
+{
+    unsigned long size, res;
+    FILE *fp;
+    int n;
+
+    if ((fp = fopen("/proc/self/statm", "r")) == NULL) return -1;
+
+    n = fscanf(fp, "%lu %lu", &size, &res);
+    fclose(fp);
+
+    return n == 2 ? (long)(res * (sysconf(_SC_PAGESIZE) / 1024)) : -1;
+}
+
+/* registers the options in a new process, the help copied or referenced */
+static void measure(int mode, const char *label)
+{
+    FLEXOP_MEMORY m;
+    char name[32], *args[] = {"help-rss", NULL}, **argv = args;
+    long r0;
+    int i, argc = 1, status;
+    pid_t pid;
+
+    if ((pid = fork()) < 0) {
+        perror("fork");
+        exit(1);
+    }
+
+    if (pid > 0) {
+        waitpid(pid, &status, 0);
+        return;
+    }
+
+    r0 = rss();
+
+    flexop_set_help_mode(mode);
+
+    for (i = 0; i < NOPTS; i++) {
+        sprintf(name, "opt%d", i);
+        flexop_register_int(name, helps[i], vars + i);
+    }
+
+    flexop_init(&argc, &argv);
+    flexop_memory_usage(&m);
+
+    printf("%s: %d options, registry %lu bytes (help %lu), resident +%ld KiB\n", label, NOPTS,
+            (unsigned long)m.total, (unsigned long)m.help, rss() - r0);
+
+    flexop_finalize();
+    exit(0);
+}
+
+int main(void)
+{
+    measure(FLEXOP_HELP_COPY, "copied help");
+    measure(FLEXOP_HELP_STATIC, "static help");
+
+    return 0;
+}
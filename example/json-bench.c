@@ -0,0 +1,93 @@
+
+#include "flexop.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/* options of the registry, a vector every 1000 */
+#define NOPTS   100000
+#define VLEN    10000
+
+static double elapsed(struct timeval *t0)
+{
+    struct timeval t1;
+
+    gettimeofday(&t1, NULL);
+
+    return (t1.tv_sec - t0->tv_sec) + (t1.tv_usec - t0->tv_usec) * 1e-6;
+}
+
+int main(int argc, char **argv)
+{
+    static FLEXOP_INT ivar[NOPTS];
+    static FLEXOP_FLOAT fvar[NOPTS];
+    static char *svar[NOPTS];
+    static FLEXOP_VEC vvar[NOPTS / 1000];
+    struct timeval t0;
+    FLEXOP_BUF b;
+    char name[32];
+    FLEXOP_FLOAT f;
+    double t;
+    int i, j, fd;
+
+    flexop_set_help_mode(FLEXOP_HELP_STATIC);
+
+    gettimeofday(&t0, NULL);
+
+    for (i = 0; i < NOPTS; i++) {
+        sprintf(name, "bench.opt%d", i);
+
+        if (i % 1000 == 0) {
+            flexop_register_vec_float(name, "a vector", vvar + i / 1000);
+        }
+        else if (i % 3 == 0) {
+            flexop_register_string(name, "a string", svar + i);
+        }
+        else if (i % 3 == 1) {
+            flexop_register_int(name, "an integer", ivar + i);
+        }
+        else {
+            flexop_register_float(name, "a real", fvar + i);
+        }
+    }
+
+    flexop_init(&argc, &argv);
+
+    for (i = 0; i < NOPTS / 1000; i++) {
+        for (j = 0; j < VLEN; j++) {
+            f = j * 0.1;
+            flexop_vec_add_entry(vvar + i, &f);
+        }
+    }
+
+    for (i = 0; i < NOPTS; i++) {
+        ivar[i] = i;
+        fvar[i] = i / 7.;
+        if (i % 3 == 0 && i % 1000 != 0) svar[i] = "value \"quoted\"\twith a tab";
+    }
+
+    printf("%d options registered in %.3f s\n", NOPTS, elapsed(&t0));
+
+    /* into a buffer */
+    flexop_buf_init(&b);
+    gettimeofday(&t0, NULL);
+    flexop_json(&b, FLEXOP_JSON_ALL);
+    t = elapsed(&t0);
+
+    printf("flexop_json: %.3f s, %lu bytes, %.0f options/s\n", t, (unsigned long)b.size, NOPTS / t);
+    flexop_buf_destroy(&b);
+
+    /* streamed to a descriptor */
+    if ((fd = open("/dev/null", O_WRONLY)) >= 0) {
+        gettimeofday(&t0, NULL);
+        flexop_json_fd(fd, FLEXOP_JSON_ALL | FLEXOP_JSON_LINES);
+        t = elapsed(&t0);
+
+        printf("flexop_json_fd (NDJSON): %.3f s, %.0f options/s\n", t, NOPTS / t);
+        close(fd);
+    }
+
+    flexop_finalize();
+
+    return 0;
+}
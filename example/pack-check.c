@@ -0,0 +1,201 @@
+
+#include "flexop.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/* workers which receive the packed options */
+#define NWORKERS    4
+
+static int b_opt;
+static FLEXOP_INT i_opt;
+static FLEXOP_UINT u_opt;
+static FLEXOP_FLOAT f_opt;
+static char *s_opt = "default";
+static FLEXOP_SIZE z_opt;
+static FLEXOP_DURATION d_opt;
+static int k_opt;
+static int16_t i16_opt;
+static float f32_opt;
+static int64_t i64_opt;
+static long double ld_opt;
+static FLEXOP_VEC vi_opt, vf_opt, vs_opt, v8_opt, vu64_opt;
+
+/* the same options in the master and in every worker */
+static void register_options(void)
+{
+    static const char *keys[] = {"jacobi", "gauss-seidel", "ilu", NULL};
+
+    flexop_register_bool("bool", "a boolean", &b_opt);
+    flexop_register_int("int", "an integer", &i_opt);
+    flexop_register_uint("uint", "an unsigned integer", &u_opt);
+    flexop_register_float("float", "a real", &f_opt);
+    flexop_register_string("string", "a string", &s_opt);
+    flexop_register_size("size", "a size", &z_opt);
+    flexop_register_duration("duration", "a duration", &d_opt);
+    flexop_register_keyword("keyword", "a keyword", keys, &k_opt);
+    flexop_register_number("int16", "a 16-bit integer", &i16_opt, FLEXOP_INT16);
+    flexop_register_number("float32", "a single precision real", &f32_opt, FLEXOP_FLOAT32);
+    flexop_register_number("int64", "a 64-bit integer", &i64_opt, FLEXOP_INT64);
+    flexop_register_number("long_double", "an extended precision real", &ld_opt, FLEXOP_LONG_DOUBLE);
+
+    flexop_register_vec_int("vec_int", "integers", &vi_opt);
+    flexop_register_vec_float("vec_float", "reals", &vf_opt);
+    flexop_register_vec_string("vec_string", "strings", &vs_opt);
+    flexop_register_vec_number("vec_int8", "8-bit integers", &v8_opt, FLEXOP_INT8);
+    flexop_register_vec_number("vec_uint64", "64-bit unsigned integers", &vu64_opt, FLEXOP_UINT64);
+}
+
+static int read_all(int fd, void *p, size_t n)
+{
+    ssize_t r;
+
+    while (n > 0) {
+        if ((r = read(fd, p, n)) < 0 && errno == EINTR) continue;
+        if (r <= 0) return 0;
+
+        p = (char *)p + r;
+        n -= r;
+    }
+
+    return 1;
+}
+
+static int write_all(int fd, const void *p, size_t n)
+{
+    ssize_t r;
+
+    while (n > 0) {
+        if ((r = write(fd, p, n)) < 0 && errno == EINTR) continue;
+        if (r <= 0) return 0;
+
+        p = (const char *)p + r;
+        n -= r;
+    }
+
+    return 1;
+}
+
+/* a worker: receives the image on fd 'in' instead of calling flexop_init
+ * and sends back the JSON of its options on 'out' */
+static int worker(int in, int out)
+{
+    FLEXOP_BUF b;
+    size_t len;
+    void *buf;
+
+    register_options();
+
+    if (!read_all(in, &len, sizeof(len))) return 1;
+
+    buf = flexop_malloc(len);
+    if (!read_all(in, buf, len)) return 1;
+
+    if (!flexop_unpack(buf, len)) return 1;
+    flexop_free(buf);
+
+    flexop_buf_init(&b);
+    flexop_json(&b, FLEXOP_JSON_ALL);
+
+    if (!write_all(out, &b.size, sizeof(b.size)) || !write_all(out, b.d, b.size)) return 1;
+
+    flexop_buf_destroy(&b);
+    flexop_finalize();
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int to[NWORKERS][2], from[NWORKERS][2];
+    pid_t pid[NWORKERS];
+    FLEXOP_BUF expect;
+    size_t len, n;
+    void *buf;
+    char *got;
+    int i, status, bad = 0;
+
+    /* the workers start before the master parses its options */
+    for (i = 0; i < NWORKERS; i++) {
+        if (pipe(to[i]) < 0 || pipe(from[i]) < 0) {
+            perror("pipe");
+            return 1;
+        }
+
+        if ((pid[i] = fork()) < 0) {
+            perror("fork");
+            return 1;
+        }
+
+        if (pid[i] == 0) {
+            close(to[i][1]);
+            close(from[i][0]);
+            exit(worker(to[i][0], from[i][1]));
+        }
+
+        close(to[i][0]);
+        close(from[i][1]);
+    }
+
+    register_options();
+    flexop_init(&argc, &argv);
+
+    /* values which differ from the defaults, of every type */
+    flexop_set_options("-bool -int -42 -uint 7 -float 2.5e-3 -string \"two words\" -size 64k "
+            "-duration 150ms -keyword ilu -int16 -300 -float32 0.1 -vec_int \"1 -2 3\" "
+            "-vec_float \"1e-300 2.5\" -vec_string \"a 'b c' d\" -vec_int8 \"-128 0 127\" "
+            "-int64 -9000000000000000000 -long_double 0.1 -vec_uint64 \"0 18446744073709551615\"");
+
+    if (!flexop_pack(&buf, &len)) {
+        fprintf(stderr, "flexop_pack failed\n");
+        return 1;
+    }
+
+    flexop_buf_init(&expect);
+    flexop_json(&expect, FLEXOP_JSON_ALL);
+
+    for (i = 0; i < NWORKERS; i++) {
+        if (!write_all(to[i][1], &len, sizeof(len)) || !write_all(to[i][1], buf, len)) {
+            fprintf(stderr, "worker %d: cannot send the image\n", i);
+            bad++;
+        }
+
+        close(to[i][1]);
+    }
+
+    for (i = 0; i < NWORKERS; i++) {
+        got = NULL;
+
+        if (!read_all(from[i][0], &n, sizeof(n))) {
+            fprintf(stderr, "worker %d: no reply\n", i);
+            bad++;
+        }
+        else if (!read_all(from[i][0], got = flexop_malloc(n + 1), n)) {
+            fprintf(stderr, "worker %d: short reply\n", i);
+            bad++;
+        }
+        else if (n != expect.size || memcmp(got, expect.d, n) != 0) {
+            got[n] = '\0';
+            fprintf(stderr, "worker %d: options differ\n--- master\n%s--- worker\n%s", i, expect.d, got);
+            bad++;
+        }
+
+        flexop_free(got);
+        close(from[i][0]);
+
+        waitpid(pid[i], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "worker %d: failed\n", i);
+            bad++;
+        }
+    }
+
+    printf("%d workers, image of %lu bytes: %s\n", NWORKERS, (unsigned long)len, bad ? "FAILED" : "ok");
+
+    flexop_free(buf);
+    flexop_buf_destroy(&expect);
+    flexop_finalize();
+
+    return bad != 0;
+}
@@ -0,0 +1,50 @@
+
+#ifndef FLEX_OPTION_BUF_H
+#define FLEX_OPTION_BUF_H
+
+#include "flexop-utils.h" 
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void flexop_buf_init(FLEXOP_BUF *b);
+void flexop_buf_destroy(FLEXOP_BUF *b);
+void flexop_buf_reset(FLEXOP_BUF *b);
+
+/* makes room for n more bytes */
+void flexop_buf_reserve(FLEXOP_BUF *b, size_t n);
+
+/* append */
+void flexop_buf_append(FLEXOP_BUF *b, const char *s, size_t n);
+void flexop_buf_puts(FLEXOP_BUF *b, const char *s);
+void flexop_buf_putc(FLEXOP_BUF *b, char c);
+void flexop_buf_printf(FLEXOP_BUF *b, const char *fmt, ...);
+void flexop_buf_vprintf(FLEXOP_BUF *b, const char *fmt, va_list ap);
+
+void flexop_buf_put_int(FLEXOP_BUF *b, FLEXOP_INT v);
+void flexop_buf_put_uint(FLEXOP_BUF *b, FLEXOP_UINT v);
+void flexop_buf_put_float(FLEXOP_BUF *b, FLEXOP_FLOAT v);
+void flexop_buf_put_size(FLEXOP_BUF *b, FLEXOP_SIZE v);
+void flexop_buf_put_duration(FLEXOP_BUF *b, FLEXOP_DURATION v);
+
+/* a number of width w at p, see FLEXOP_WIDTH */
+void flexop_buf_put_number(FLEXOP_BUF *b, FLEXOP_WIDTH w, const void *p);
+
+/* writes the content by flexop_write and empties the buffer */
+void flexop_buf_flush(FLEXOP_BUF *b);
+
+/* Word wrapping: the text given to flexop_wrap_puts, in any number of
+ * pieces, is appended to b as lines of at most 'width' columns which start
+ * with 'indent'. Tabs are expanded, a newline starts a new line and the
+ * blanks which follow it are dropped. A word longer than a line is not
+ * broken. flexop_wrap_end terminates the last line. */
+void flexop_wrap_init(FLEXOP_WRAP *w, FLEXOP_BUF *b, const char *indent, int width);
+void flexop_wrap_puts(FLEXOP_WRAP *w, const char *s);
+void flexop_wrap_end(FLEXOP_WRAP *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
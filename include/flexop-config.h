@@ -0,0 +1,18 @@
+/* include/flexop-config.h.  Generated from flexop-config.h.in by configure.  */
+
+#ifndef FLEXOP_CONFIG_H
+#define FLEXOP_CONFIG_H
+
+#define FLEXOP_USE_LONG 0
+#define FLEXOP_USE_LONG_LONG 0
+#define IFMT "d"
+#define UFMT "u"
+
+#define FLEXOP_USE_LONG_DOUBLE 0
+#define FFMT "g"
+
+#define HAVE_STDINT_H 1
+
+#define FLEXOP_USE_CONTROL 1
+
+#endif
@@ -0,0 +1,85 @@
+
+#ifndef FLEX_OPTION_NUM_H
+#define FLEX_OPTION_NUM_H
+
+#include "flexop-types.h" 
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Locale-independent, correctly rounded parsing of floating point numbers.
+ * Leading white spaces are skipped. On success returns 1, stores the value
+ * in *v and, if end != NULL, sets *end to the first character after the
+ * number. Returns 0 if no number was found. */
+int flexop_parse_double(const char *s, const char **end, double *v);
+int flexop_parse_float(const char *s, const char **end, FLEXOP_FLOAT *v);
+
+/* Overflow-checked parsing of integers in decimal, hexadecimal ("0x") or
+ * binary ("0b"). Leading white spaces are skipped, unsigned numbers don't
+ * accept a minus sign. Returns 1 on success, 0 if no number was found and
+ * -1 if the number doesn't fit in the type, *end is set as above. */
+int flexop_parse_int(const char *s, const char **end, FLEXOP_INT *v);
+int flexop_parse_uint(const char *s, const char **end, FLEXOP_UINT *v);
+
+/* Sizes and durations: a non-negative decimal number, optionally with a
+ * fraction, followed by an optional unit (case insensitive):
+ *
+ *   size:     b, k (kb, kib), m, g, t, p, e; powers of 1024, default: b
+ *   duration: ns, us, ms, s, m (min), h, d; default: ns
+ *
+ * The value is normalized to bytes / nanoseconds, rounding down. Return
+ * values are the same as flexop_parse_int. */
+int flexop_parse_size(const char *s, const char **end, FLEXOP_SIZE *v);
+int flexop_parse_duration(const char *s, const char **end, FLEXOP_DURATION *v);
+
+/* size of a buffer large enough for any number written by flexop_format_xxx */
+#define FLEXOP_NUM_BUFSIZE     48
+
+/* Writes the shortest string which reads back to exactly the same value
+ * (for double), or a decimal integer. buf should have at least
+ * FLEXOP_NUM_BUFSIZE bytes, the string is NUL terminated and its length
+ * is returned. */
+int flexop_format_double(char *buf, double v);
+int flexop_format_float(char *buf, FLEXOP_FLOAT v);
+int flexop_format_int(char *buf, FLEXOP_INT v);
+int flexop_format_uint(char *buf, FLEXOP_UINT v);
+
+/* with the largest unit which represents the value exactly, e.g. "4G" */
+int flexop_format_size(char *buf, FLEXOP_SIZE v);
+int flexop_format_duration(char *buf, FLEXOP_DURATION v);
+
+/* the shortest string which reads back to the same float */
+int flexop_format_float32(char *buf, float v);
+
+/* Numbers of a given width, see FLEXOP_WIDTH. flexop_width_type is VT_INT,
+ * VT_UINT or VT_FLOAT, flexop_width_native the default width of a type of
+ * option or vector (FLEXOP_WNONE if it is not a number).
+ *
+ * flexop_load converts the number of width w at p to *x, a FLEXOP_INT,
+ * FLEXOP_UINT or FLEXOP_FLOAT by the type of w. flexop_store does the
+ * opposite, it returns 0 and changes nothing if the value is out of the
+ * range of w; p may be NULL to only check the range. */
+int flexop_width_size(FLEXOP_WIDTH w);
+const char * flexop_width_name(FLEXOP_WIDTH w);
+FLEXOP_VTYPE flexop_width_type(FLEXOP_WIDTH w);
+FLEXOP_WIDTH flexop_width_native(FLEXOP_VTYPE type);
+
+void flexop_load(void *x, FLEXOP_WIDTH w, const void *p);
+int flexop_store(void *p, FLEXOP_WIDTH w, const void *x);
+
+/* The same through FLEXOP_WIDE, which holds any width in any build.
+ * flexop_parse_wide parses a number of the type of w into *x, in 64 bits or
+ * with the precision of w for floats, and returns as flexop_parse_int; the
+ * range of w is checked by flexop_store_wide. flexop_format_wide writes the
+ * number as flexop_format_xxx. */
+int flexop_parse_wide(const char *s, const char **end, FLEXOP_WIDTH w, FLEXOP_WIDE *x);
+int flexop_format_wide(char *buf, FLEXOP_WIDTH w, const FLEXOP_WIDE *x);
+void flexop_load_wide(FLEXOP_WIDE *x, FLEXOP_WIDTH w, const void *p);
+int flexop_store_wide(void *p, FLEXOP_WIDTH w, const FLEXOP_WIDE *x);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
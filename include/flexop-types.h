@@ -9,6 +9,9 @@
 #include <string.h>
 #include <assert.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/time.h>
 
 #include "flexop-config.h"
 
@@ -30,6 +33,24 @@ typedef int                      FLEXOP_INT;
 typedef unsigned int             FLEXOP_UINT;
 #endif
 
+#if FLEXOP_USE_LONG_LONG
+#define FLEXOP_INT_MAX                 LLONG_MAX
+#define FLEXOP_INT_MIN                 LLONG_MIN
+#define FLEXOP_UINT_MAX                ULLONG_MAX
+#elif FLEXOP_USE_LONG
+#define FLEXOP_INT_MAX                 LONG_MAX
+#define FLEXOP_INT_MIN                 LONG_MIN
+#define FLEXOP_UINT_MAX                ULONG_MAX
+#else
+#define FLEXOP_INT_MAX                 INT_MAX
+#define FLEXOP_INT_MIN                 INT_MIN
+#define FLEXOP_UINT_MAX                UINT_MAX
+#endif
+
+/* sizes in bytes and durations in nanoseconds */
+typedef uint64_t                 FLEXOP_SIZE;
+typedef uint64_t                 FLEXOP_DURATION;
+
 #define FLEXOP_VEC_MAGIC_NUMBER        (0x2619EFE)
 
 /* All options are stored in a list 'options'. When parsing a cmdline option,
@@ -37,9 +58,11 @@ typedef unsigned int             FLEXOP_UINT;
  * o->var points to the location of the variable with one of the following
  * types:
  *
- * - For VT_INT, o->var is intepreted as (FLEXOP_INT *)o->var
+ * - For VT_INT, o->var is intepreted as (FLEXOP_INT *)o->var, or as a
+ *   pointer to the type of o->width, see FLEXOP_WIDTH
  *
- * - For VT_FLOAT, o->var is intepreted as (FLEXOP_FLOAT *)o->var
+ * - For VT_FLOAT, o->var is intepreted as (FLEXOP_FLOAT *)o->var, or as
+ *   for VT_INT
  *
  * - For options without argument (VT_BOOL), o->var is intepreted as
  *   (int *)o->var, the cmdline option '-name' sets it to (1) TRUE,
@@ -55,7 +78,14 @@ typedef unsigned int             FLEXOP_UINT;
  *   for this option, and o->var o->var is intepreted as (int *)o->var
  *   which is an index to the list of keywords 
  *
- * - For VT_VEC_INT (_FLOAT or _STRING),  o->var is intepreted as (FLEXOP_VEC *)o->var 
+ * - For VT_SIZE, o->var is intepreted as (FLEXOP_SIZE *)o->var, the value
+ *   is in bytes and may be given with a unit suffix, such as "4G", "1.5M"
+ *
+ * - For VT_DURATION, o->var is intepreted as (FLEXOP_DURATION *)o->var, the
+ *   value is in nanoseconds and may be given with a unit suffix, such as
+ *   "250us", "3s", "1.5h"
+ *
+ * - For VT_VEC_INT (_FLOAT, _STRING, _SIZE or _DURATION),  o->var is intepreted as (FLEXOP_VEC *)o->var 
  *
  */
 
@@ -71,19 +101,115 @@ typedef enum {
     VT_UINT,
     VT_FLOAT,
     VT_STRING,
+    VT_SIZE,
+    VT_DURATION,
 
     VT_VEC_INT,
     VT_VEC_UINT,
     VT_VEC_FLOAT,
     VT_VEC_STRING,
+    VT_VEC_SIZE,
+    VT_VEC_DURATION,
 
 } FLEXOP_VTYPE;
 
+/* Storage of the numbers of an option (VT_INT, VT_UINT, VT_FLOAT) or of the
+ * elements of a vector of numbers. By default it is the width of FLEXOP_INT,
+ * FLEXOP_UINT or FLEXOP_FLOAT; flexop_register_number and
+ * flexop_register_vec_number give any width in any build, e.g.
+ * FLEXOP_FLOAT32 for a large vector or FLEXOP_INT64 without
+ * --enable-big-int. Values are parsed and printed in the full range of the
+ * width, and converted to and from FLEXOP_INT, FLEXOP_UINT and FLEXOP_FLOAT
+ * by the other functions, saturated if those are narrower. Values out of
+ * the range of the width are invalid. */
+typedef enum {
+    FLEXOP_WNONE,           /* not a number */
+
+    FLEXOP_INT8,            /* int8_t */
+    FLEXOP_INT16,
+    FLEXOP_INT32,
+    FLEXOP_INT64,
+
+    FLEXOP_UINT8,           /* uint8_t */
+    FLEXOP_UINT16,
+    FLEXOP_UINT32,
+    FLEXOP_UINT64,
+
+    FLEXOP_FLOAT32,         /* float */
+    FLEXOP_FLOAT64,         /* double */
+    FLEXOP_LONG_DOUBLE,     /* long double */
+
+} FLEXOP_WIDTH;
+
+/* a number of any width, by its type */
+typedef union FLEXOP_WIDE_
+{
+    int64_t i;
+    uint64_t u;
+    long double f;
+
+} FLEXOP_WIDE;
+
+/* constraints of an option, see flexop_constrain */
+typedef struct FLEXOP_CHECK_
+{
+    int flags;              /* FLEXOP_CHECK_xxx */
+
+    /* bounds, in the field of the type of the values */
+    FLEXOP_INT imin, imax;
+    FLEXOP_UINT umin, umax;
+    FLEXOP_FLOAT fmin, fmax;
+    uint64_t zmin, zmax;    /* sizes and durations */
+    char *smin, *smax;      /* as given, for messages */
+
+    FLEXOP_INT min_len, max_len;
+    char **keys;            /* allowed values, NULL terminated */
+
+} FLEXOP_CHECK;
+
+/* where the current value of an option comes from */
+typedef enum {
+    FLEXOP_SRC_DEFAULT,     /* never set, registered value */
+    FLEXOP_SRC_PRESET,      /* flexop_preset_cmdline */
+    FLEXOP_SRC_CMDLINE,     /* argv */
+    FLEXOP_SRC_FILE,        /* -option_file */
+    FLEXOP_SRC_SET,         /* flexop_set_options */
+    FLEXOP_SRC_API,         /* flexop_set_xxx */
+    FLEXOP_SRC_PROFILE,     /* -profile, see flexop_register_profile */
+
+} FLEXOP_SOURCE;
+
+/* provenance of an option, updated in place each time the option is set */
+typedef struct FLEXOP_ORIGIN_
+{
+    FLEXOP_SOURCE src;
+    const char *file;   /* options file for FLEXOP_SRC_FILE, profile for
+                           FLEXOP_SRC_PROFILE, NULL otherwise */
+    int pos;            /* line in file, or index in argv / option string / profile,
+                           -1 for FLEXOP_SRC_DEFAULT and FLEXOP_SRC_API */
+    int count;          /* number of times the option has been set */
+    double time;        /* wall clock time (seconds since epoch) of last set */
+
+} FLEXOP_ORIGIN;
+
+/* an error of flexop_set_options or flexop_set_xxx, see flexop_diag_get */
+typedef struct FLEXOP_DIAG_
+{
+    char *option;           /* the option as given, NULL if the error is not about one */
+    FLEXOP_SOURCE src;      /* FLEXOP_SRC_SET or FLEXOP_SRC_API */
+    int pos;                /* index in the option string, -1 if unknown or for FLEXOP_SRC_API */
+    char *reason;
+
+} FLEXOP_DIAG;
+
 typedef struct FLEXOP_KEY
 {
     char  *name;        /* option name without leading dash */
     char  *help;        /* help text for this option */
     char  **keys;       /* list of key words if type is VT_KEYWORD */
+    int   *khash;       /* hash of keys, positions in keys plus one (0:
+                           empty slot), see flexop_keyword_index */
+    int   kmask;        /* size of khash minus one */
     void  *hvar;        /* variable address for VT_HANDLER */
     void  *var;         /* address of the variable to assign value to
                            It's assumed to have the following type:
@@ -93,13 +219,21 @@ typedef struct FLEXOP_KEY
                                - VT_KEYWORD  (int *)var
                                - VT_INT  (FLEXOP_INT *)var
                                - VT_FLOAT  (FLEXOP_FLOAT *)var
+                               - VT_SIZE  (FLEXOP_SIZE *)var
+                               - VT_DURATION  (FLEXOP_DURATION *)var
                                - VT_VEC_INT  (FLEXOP_VEC *)var
                                - VT_VEC_FLOAT  (FLEXOP_VEC *)var
                                - VT_VEC_STRING  (FLEXOP_VEC *)var
+                               - VT_VEC_SIZE  (FLEXOP_VEC *)var
+                               - VT_VEC_DURATION  (FLEXOP_VEC *)var
                                - VT_BOOL  (int *)var */
 
     FLEXOP_VTYPE type;  /* type of the variable */
+    FLEXOP_WIDTH width; /* storage of numbers, FLEXOP_WNONE for other types */
     int  used;          /* whether the option is specified in cmdline */
+    FLEXOP_ORIGIN origin;   /* who set the option last */
+    FLEXOP_CHECK *check;    /* constraints, NULL if none */
+    int borrowed;       /* help is not a copy, see flexop_set_help_mode */
 
 } FLEXOP_KEY;
 
@@ -110,10 +244,107 @@ typedef struct FLEXOP_KEY
  * Returns (1) TRUE if succeed. */
 typedef int (*FLEXOP_HANDLER)(FLEXOP_KEY *o, const char *arg);
 
+/* called for each option by flexop_foreach_prefix */
+typedef void (*FLEXOP_VISITOR)(FLEXOP_KEY *o, void *data);
+
+/* severity of the output, see flexop_set_sink */
+typedef enum
+{
+    FLEXOP_LEVEL_INFO,      /* flexop_printf: help, reports */
+    FLEXOP_LEVEL_WARNING,   /* flexop_warning */
+    FLEXOP_LEVEL_ERROR,     /* flexop_error */
+
+} FLEXOP_LEVEL;
+
+/* receives n bytes of output, complete lines for FLEXOP_LEVEL_INFO, or one
+ * message; s is not NUL terminated */
+typedef void (*FLEXOP_SINK)(FLEXOP_LEVEL level, const char *s, size_t n, void *data);
+
+/* a namespace resolved by flexop_namespace */
+typedef struct FLEXOP_NS_
+{
+    int node;           /* node in FLEXOP.trie, -1 if it has no options */
+    int depth;          /* length of "prefix." */
+
+} FLEXOP_NS;
+
+/* node of the radix trie over the sorted option names: the names of the
+ * options index[lo] to index[hi - 1] share their first 'depth' characters,
+ * the label of the node being those after the depth of its parent */
+typedef struct FLEXOP_TRIE_
+{
+    int lo, hi;
+    int depth;
+    int child;          /* first child, children are in the order of their
+                           first character */
+    int nchild;
+
+} FLEXOP_TRIE;
+
+/* the options after a title, up to the next title, see
+ * flexop_register_title. FLEXOP.cats is sorted by category, then by
+ * position, a category being the run of its titles. */
+typedef struct FLEXOP_CATEGORY_
+{
+    const char *name;   /* NULL for titles without category */
+    int title;          /* position of the title in the registry, -1 for
+                           the options registered before any title */
+    int lo, hi;         /* positions of the options */
+
+} FLEXOP_CATEGORY;
+
+/* an option as returned by flexop_cursor_next, pointing into the registry:
+ * value is the variable of numbers and booleans (stored with 'width'), the
+ * string of strings, the keyword of keywords (NULL if none), the last
+ * argument of handlers and the FLEXOP_VEC of vectors */
+typedef struct FLEXOP_VIEW_
+{
+    const FLEXOP_KEY *key;
+    const char *name;
+    const char *help;
+    FLEXOP_VTYPE type;
+    FLEXOP_WIDTH width;
+    int used;
+    const void *value;
+    const FLEXOP_ORIGIN *origin;
+
+} FLEXOP_VIEW;
+
+/* state of flexop_cursor_next */
+typedef struct FLEXOP_CURSOR_
+{
+    const char *category;
+    unsigned int types;
+    int used;
+    int cat, cend;      /* range of FLEXOP.cats */
+    int pos, end;       /* range of the options */
+
+} FLEXOP_CURSOR;
+
+/* types for flexop_cursor_init, e.g.
+ * FLEXOP_TYPE_BIT(VT_INT) | FLEXOP_TYPE_BIT(VT_FLOAT) */
+#define FLEXOP_TYPE_BIT(t)          (1u << (t))
+
+/* bytes held by the registry, see flexop_memory_usage */
+typedef struct FLEXOP_MEMORY_
+{
+    size_t options;         /* the array of options */
+    size_t names;           /* names, keywords and their hashes */
+    size_t help;            /* help text copied at registration */
+    size_t nborrowed;       /* options whose help is referenced, it is not
+                               read to be measured */
+    size_t index;           /* index, trie and categories */
+    size_t total;           /* bytes of all the above */
+
+} FLEXOP_MEMORY;
+
 typedef struct FLEXOP_
 {
     FLEXOP_KEY *options;
     int *index;
+    FLEXOP_TRIE *trie;  /* built with index, titles are not in it */
+    FLEXOP_CATEGORY *cats;  /* built with index */
+    int ncats;
     char *help_category;
     char *opt_file;
 
@@ -130,6 +361,16 @@ typedef struct FLEXOP_
     int argcf;
     char **argvf;
     int allocf;
+    int *linef;         /* line of each argvf entry */
+
+    /* names of parsed options files, referenced by FLEXOP_ORIGIN.file */
+    char **files;
+    int nfiles;
+
+    /* images mapped by flexop_attach, vectors may point into them */
+    void **maps;
+    size_t *map_size;
+    int nmaps;
 
     size_t size;
     size_t alloc;
@@ -151,8 +392,110 @@ typedef struct FLEXOP_VEC_
     FLEXOP_INT tsize;
     FLEXOP_INT magic;
 
+    FLEXOP_WIDTH width; /* storage of the elements of numeric vectors, see
+                           flexop_vec_set_width */
+
+    int mapped;         /* d points to read-only memory owned by an image,
+                           it is copied before the vector is modified */
+
 } FLEXOP_VEC;
 
+/* Image of the registry, written by flexop_export and read by flexop_attach.
+ * It is also the binary options file format: a file starting with
+ * FLEXOP_IMAGE_MAGIC given to -option_file is mapped instead of parsed,
+ * see README.md. All positions are byte offsets from the beginning of the
+ * image, so it can be mapped at any address. Numbers are in the byte order
+ * and widths of the writer (see endian, int_size, float_size).
+ *
+ * Layout: the header, then the entry table at 'entries', names, strings
+ * and values anywhere after it. Entries may be in any order and only the
+ * options to set need an entry. 'schema' is not checked when loading,
+ * options are found by name, so generators may write 0. */
+#define FLEXOP_IMAGE_MAGIC          "FLEXOPIM"
+#define FLEXOP_IMAGE_VERSION        1
+#define FLEXOP_IMAGE_ENDIAN         0x01020304
+
+typedef struct FLEXOP_IMAGE_HEADER_
+{
+    char magic[8];          /* FLEXOP_IMAGE_MAGIC, not NUL terminated */
+    uint32_t version;       /* FLEXOP_IMAGE_VERSION */
+    uint32_t endian;        /* FLEXOP_IMAGE_ENDIAN */
+    uint32_t int_size;      /* sizeof(FLEXOP_INT) */
+    uint32_t float_size;    /* sizeof(FLEXOP_FLOAT) */
+    uint64_t size;          /* size of the image in bytes */
+    uint64_t schema;        /* hash of the names and types of all options */
+    uint64_t nentries;      /* number of entries */
+    uint64_t entries;       /* offset of the entry table */
+
+} FLEXOP_IMAGE_HEADER;
+
+/* one option. The value is at offset 'value':
+ *  - VT_BOOL: int
+ *  - VT_INT, VT_UINT, VT_FLOAT, VT_SIZE, VT_DURATION: the type itself, of
+ *    'width' for numbers (elements of vectors too), 0 means the width of
+ *    FLEXOP_INT, FLEXOP_UINT or FLEXOP_FLOAT
+ *  - VT_STRING, VT_KEYWORD, VT_HANDLER: NUL terminated string of 'count'
+ *    bytes, value is 0 for NULL
+ *  - VT_VEC_XXX: 'count' elements, aligned to 64 bytes; for VT_VEC_STRING
+ *    the elements are uint64_t offsets of NUL terminated strings
+ *
+ * A numeric vector payload aligned to its element size is not copied, d of
+ * the FLEXOP_VEC points into the read-only mapping. In an options file the
+ * origin fields (file, time, src, pos, nset) and 'used' are ignored: every
+ * entry is set by that file, pos being the index of the entry plus 1. */
+typedef struct FLEXOP_IMAGE_ENTRY_
+{
+    uint64_t name;          /* offset of the name, NUL terminated */
+    uint64_t value;         /* offset of the value */
+    uint64_t count;         /* number of elements or length of string */
+    uint64_t file;          /* offset of origin.file, 0 for NULL */
+    double time;            /* origin.time */
+    uint32_t type;          /* FLEXOP_VTYPE */
+    int32_t used;
+    int32_t src;            /* origin.src */
+    int32_t pos;            /* origin.pos */
+    int32_t nset;           /* origin.count */
+    int32_t width;          /* FLEXOP_WIDTH */
+
+} FLEXOP_IMAGE_ENTRY;
+
+/* an options file read from a descriptor, see flexop_stream_open */
+typedef struct FLEXOP_STREAM_
+{
+    int fd;
+    const char *file;       /* name, for FLEXOP_ORIGIN.file */
+    char *buf;              /* the incomplete last line */
+    size_t size;
+    size_t alloc;
+    int line;               /* number of lines read */
+    int first;              /* first argument not applied, see flexop_stream_line */
+    int eof;
+
+} FLEXOP_STREAM;
+
+/* growable output buffer, d is always NUL terminated */
+typedef struct FLEXOP_BUF_
+{
+    char *d;
+    size_t size;
+    size_t alloc;
+
+} FLEXOP_BUF;
+
+/* word wrapping into a FLEXOP_BUF, see flexop_wrap_init */
+typedef struct FLEXOP_WRAP_
+{
+    FLEXOP_BUF *b;
+    const char *indent;     /* of every line */
+    int width;              /* maximum number of columns */
+    int col;                /* column of the end of b */
+    size_t line;            /* the first byte after the indent */
+    size_t space;           /* the blanks before the current word */
+    size_t word;            /* the current word */
+    int state;              /* at the start of a line, in blanks, in a word */
+
+} FLEXOP_WRAP;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
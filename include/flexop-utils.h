@@ -3,6 +3,7 @@
 #define FLEX_OPTION_UT_H
 
 #include "flexop-types.h" 
+#include "flexop-num.h" 
 
 #ifdef __cplusplus
 extern "C" {
@@ -11,6 +12,7 @@ extern "C" {
 void flexop_warning(const char *fmt, ...);
 void flexop_error(int code, const char *fmt, ...);
 int  flexop_printf(const char *fmt, ...);
+void flexop_write(const char *s, size_t n);
 
 void * flexop_malloc(size_t size);
 void * flexop_realloc(void *ptr, size_t size);
@@ -20,9 +22,39 @@ void   flexop_free(void *ptr);
 FLEXOP_FLOAT flexop_atof(const char *ptr);
 FLEXOP_INT flexop_atoi(const char *ptr);
 FLEXOP_UINT flexop_atou(const char *ptr);
+FLEXOP_SIZE flexop_atosize(const char *ptr);
+FLEXOP_DURATION flexop_atoduration(const char *ptr);
+
+/* a number of the type of w in 64 bits or with the precision of w, its
+ * range is checked by flexop_store_wide */
+void flexop_atowide(const char *ptr, FLEXOP_WIDTH w, FLEXOP_WIDE *x);
 
 void flexop_set_print_mark(int m);
 
+/* Output sinks. All output of the library goes to stdout by default, or
+ * to func, file descriptor fd or the end of buffer b (not emptied, read it
+ * when no thread prints); flexop_set_sink(NULL, NULL) restores stdout.
+ * Each thread buffers its FLEXOP_LEVEL_INFO output and passes it on by
+ * complete lines, warnings and errors are passed on at once, after the
+ * pending output of the thread. The sink is called by one thread at a
+ * time and must not change the sink; what it prints through the library
+ * goes straight to stdout instead of back to the sink. Output below 'level' is
+ * dropped, flexop_set_print_mark(0) drops FLEXOP_LEVEL_INFO as well.
+ * flexop_sink_flush passes on the incomplete last line of the calling
+ * thread, as is done at exit and when a thread exits. Built without
+ * threads (./configure --disable-control), all threads share one buffer
+ * and nothing is locked. */
+void flexop_set_sink(FLEXOP_SINK func, void *data);
+void flexop_set_sink_fd(int fd);
+void flexop_set_sink_buffer(FLEXOP_BUF *b);
+void flexop_set_sink_level(FLEXOP_LEVEL level);
+void flexop_sink_flush(void);
+
+/* output of a given level through the sink, flexop_sink_vprintf returns
+ * the length of the text as vprintf */
+void flexop_sink_write(FLEXOP_LEVEL level, const char *s, size_t n);
+int flexop_sink_vprintf(FLEXOP_LEVEL level, const char *fmt, va_list ap);
+
 #ifdef __cplusplus
 }
 #endif
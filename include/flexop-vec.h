@@ -2,7 +2,7 @@
 #ifndef FLEX_OPTION_VEC_H
 #define FLEX_OPTION_VEC_H
 
-#include "flexop-utils.h" 
+#include "flexop-buf.h" 
 
 #ifdef __cplusplus
 extern "C" {
@@ -13,19 +13,57 @@ int flexop_vec_initialized(FLEXOP_VEC *vec);
 void flexop_vec_init(FLEXOP_VEC *vec, FLEXOP_VTYPE type, FLEXOP_INT tsize, const char *key);
 void flexop_vec_destroy(FLEXOP_VEC *vec);
 
+/* initializes dst with a copy of the elements of src */
+void flexop_vec_copy(FLEXOP_VEC *dst, FLEXOP_VEC *src);
+
+/* stores the elements of a vector of numbers with width w (see FLEXOP_WIDTH)
+ * instead of as FLEXOP_INT, FLEXOP_UINT or FLEXOP_FLOAT, the vector must be
+ * empty. The elements are still added and read as those types, or directly
+ * with the getter of the width; flexop_vec_add_wide adds a value of any
+ * width */
+void flexop_vec_set_width(FLEXOP_VEC *vec, FLEXOP_WIDTH w);
+
 /* add entry */
 void flexop_vec_add_entry(FLEXOP_VEC *v, void *e);
+void flexop_vec_add_wide(FLEXOP_VEC *v, const FLEXOP_WIDE *x);
 
 /* get value */
 FLEXOP_INT flexop_vec_int_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
 FLEXOP_UINT flexop_vec_uint_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
 FLEXOP_FLOAT flexop_vec_float_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
 char * flexop_vec_string_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
+FLEXOP_SIZE flexop_vec_size_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
+FLEXOP_DURATION flexop_vec_duration_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
+
+/* elements of vectors with a width, which must be the one of the getter */
+int8_t flexop_vec_int8_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
+int16_t flexop_vec_int16_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
+int32_t flexop_vec_int32_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
+int64_t flexop_vec_int64_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
+uint8_t flexop_vec_uint8_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
+uint16_t flexop_vec_uint16_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
+uint32_t flexop_vec_uint32_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
+uint64_t flexop_vec_uint64_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
+float flexop_vec_float32_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
+double flexop_vec_float64_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
+long double flexop_vec_long_double_get_value(FLEXOP_VEC *v, FLEXOP_INT n);
 
 FLEXOP_INT flexop_vec_get_size(FLEXOP_VEC *v);
 
 void flexop_vec_print(FLEXOP_VEC *v);
 
+/* flags of flexop_vec_format */
+#define FLEXOP_VFMT_SUMMARY     1   /* summarize vectors longer than the print limit */
+#define FLEXOP_VFMT_QUOTE       2   /* quote strings */
+
+/* appends the values of v, separated by spaces, to b */
+void flexop_vec_format(FLEXOP_BUF *b, FLEXOP_VEC *v, int flags);
+
+/* Vectors longer than the limit are printed as "head ... tail (size, min,
+ * max)". Zero means no limit. */
+void flexop_vec_set_print_limit(FLEXOP_INT n);
+FLEXOP_INT flexop_vec_get_print_limit(void);
+
 #ifdef __cplusplus
 }
 #endif
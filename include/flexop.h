@@ -22,12 +22,205 @@ void flexop_show_cmdline(void);
 void flexop_show_used(void);
 void flexop_help(void);
 
+/* The help of 'category' as flexop_help prints it for -help, "all" if NULL,
+ * without printing or exiting. Help callbacks of handlers are not called.
+ * Returns NULL if nothing matches, else the text which the caller frees
+ * with flexop_free, its length is stored in *len if len is not NULL. */
+char * flexop_help_to_buffer(const char *category, size_t *len);
+
+/* Writes the options as an options file which -option_file reads back to
+ * the same values: only the options which have been set, or all of them
+ * with FLEXOP_DUMP_ALL. Returns 1 on success, 0 on a write error or if an
+ * option cannot be written exactly (a string with a newline, an element of
+ * a vector of strings with blanks), which is skipped with a warning.
+ * flexop_dump_fd writes to descriptor fd, as the text is produced. */
+#define FLEXOP_DUMP_ALL         1   /* also options at their defaults */
+#define FLEXOP_DUMP_COMMENTS    2   /* titles and help as comments */
+
+int flexop_dump(FILE *fp, int flags);
+int flexop_dump_fd(int fd, int flags);
+
+/* JSON for telemetry: the options which have been set, or all of them with
+ * FLEXOP_JSON_ALL, as objects {"name", "type", "value", "source",
+ * "category"} in registration order, in an array or, with
+ * FLEXOP_JSON_LINES, one per line (NDJSON). Vectors are arrays, sizes and
+ * durations numbers of bytes and nanoseconds, infinities and NaN strings,
+ * strings, keywords and the last argument of handlers strings or null.
+ * flexop_json appends to b, flexop_json_fd writes to fd as the text is
+ * produced, large vectors included, and returns 0 on a write error. It
+ * does not hold flexop_lock while writing, so options changed meanwhile
+ * may be written with their new values. */
+#define FLEXOP_JSON_ALL         1   /* also options at their defaults */
+#define FLEXOP_JSON_LINES       2   /* NDJSON */
+
+void flexop_json(FLEXOP_BUF *b, int flags);
+int flexop_json_fd(int fd, int flags);
+
+/* Errors. By default, an invalid option given to flexop_set_options or
+ * flexop_set_xxx is fatal: the errors are printed and the program exits.
+ * With FLEXOP_ERRORS_RETURN, e.g. for servers applying live updates, they
+ * return 0 instead and the errors of the last call are available through
+ * flexop_diag_get, i < flexop_diag_count(). flexop_set_options checks the
+ * whole string and reports every error, no option is changed if there is
+ * any (a handler which rejects its argument can only be found when it is
+ * called). Parsing the command line and the options file in flexop_init
+ * is always fatal. */
+#define FLEXOP_ERRORS_EXIT      0
+#define FLEXOP_ERRORS_RETURN    1
+
+void flexop_set_error_mode(int mode);
+int flexop_get_error_mode(void);
+int flexop_diag_count(void);
+const FLEXOP_DIAG * flexop_diag_get(int i);
+
+/* Help text. The help is only read by -help, but it is copied at
+ * registration and usually takes most of the memory of the registry. With
+ * FLEXOP_HELP_STATIC, set before registering, the help strings of the
+ * options registered next are not copied but referenced, they must stay
+ * valid until flexop_finalize, e.g. string literals: their pages are only
+ * read, hence made resident, by -help. flexop_memory_usage reports the
+ * bytes held by the registry and flexop_show_memory prints them. */
+#define FLEXOP_HELP_COPY        0
+#define FLEXOP_HELP_STATIC      1
+
+void flexop_set_help_mode(int mode);
+int flexop_get_help_mode(void);
+void flexop_memory_usage(FLEXOP_MEMORY *m);
+void flexop_show_memory(void);
+
+/* Provenance: every option records where its value was set last, see
+ * FLEXOP_ORIGIN. flexop_origin_next iterates over all options, *it starts
+ * at 0, returns 0 at the end. flexop_show_origin prints the options which
+ * are not at their defaults. */
+const char * flexop_source_name(FLEXOP_SOURCE src);
+int flexop_get_origin(const char *op_name, FLEXOP_ORIGIN *origin);
+int flexop_origin_next(int *it, const char **name, FLEXOP_ORIGIN *origin);
+
+/* Options may be abbreviated on the command line, in options files and in
+ * flexop_set_options: "-solver_tol" or "-solv_tol" (prefixes of the
+ * components separated by '_' or '.') for "-solver_tolerance", as long as
+ * one option matches. flexop_prefix_next iterates over the options whose
+ * names start with 'prefix' in alphabetical order, *it starts at 0,
+ * returns 0 at the end. */
+int flexop_prefix_next(const char *prefix, int *it, const char **name);
+
+/* Introspection without copies: a cursor iterates over the options in
+ * alphabetical order (category NULL), or over those of a category in
+ * registration order, see flexop_register_title. 'types' is a mask of
+ * FLEXOP_TYPE_BIT (0: all types), 'used' is 1 or 0 to select the options
+ * which have been set or not, -1 for all. flexop_cursor_next returns 0 at
+ * the end, views stay valid until flexop_finalize. No option may be
+ * registered while iterating. flexop_category_next iterates over the
+ * categories in alphabetical order, *it starts at 0. */
+void flexop_cursor_init(FLEXOP_CURSOR *c, const char *category, unsigned int types, int used);
+int flexop_cursor_next(FLEXOP_CURSOR *c, FLEXOP_VIEW *v);
+int flexop_category_next(int *it, const char **name);
+
+/* Namespaces: option "solver.gmres.restart" is in namespaces "solver" and
+ * "solver.gmres", "-help solver.gmres" prints the help of the options of
+ * the latter. flexop_foreach_prefix calls func for each option of namespace
+ * 'prefix' in alphabetical order and returns their number. A module can
+ * resolve its namespace once after flexop_init with flexop_namespace (0 if
+ * it has no options), then find options by their relative names ("restart")
+ * with flexop_ns_lookup (NULL if unknown) or flexop_ns_get_xxx, which only
+ * walk the subtree of the namespace. */
+int flexop_foreach_prefix(const char *prefix, FLEXOP_VISITOR func, void *data);
+int flexop_namespace(FLEXOP_NS *ns, const char *prefix);
+FLEXOP_KEY * flexop_ns_lookup(const FLEXOP_NS *ns, const char *name);
+
+int flexop_ns_get_bool(const FLEXOP_NS *ns, const char *name);
+FLEXOP_INT flexop_ns_get_int(const FLEXOP_NS *ns, const char *name);
+FLEXOP_UINT flexop_ns_get_uint(const FLEXOP_NS *ns, const char *name);
+FLEXOP_FLOAT flexop_ns_get_float(const FLEXOP_NS *ns, const char *name);
+FLEXOP_SIZE flexop_ns_get_size(const FLEXOP_NS *ns, const char *name);
+FLEXOP_DURATION flexop_ns_get_duration(const FLEXOP_NS *ns, const char *name);
+const char * flexop_ns_get_keyword(const FLEXOP_NS *ns, const char *name);
+const char * flexop_ns_get_string(const FLEXOP_NS *ns, const char *name);
+FLEXOP_VEC * flexop_ns_get_vec(const FLEXOP_NS *ns, const char *name);
+void flexop_show_origin(void);
+
+/* Control socket: a thread serving a Unix domain socket at 'path', so
+ * options can be changed without restarting. One request per line:
+ *
+ *   set <options>   same as flexop_set_options, replies "name value" for
+ *                   each option given; nothing is applied if any is invalid
+ *   get <name>      replies "name value"
+ *   list            replies "name value" for all options of the program
+ *
+ * String values are quoted as in flexop_dump. Each reply ends with "ok" or
+ * "error: <reason>". Updates are made while holding flexop_lock, lock it
+ * as well to read a consistent set of values. Returns 1 if the service is running, 0 otherwise. */
+int flexop_control_start(const char *path);
+void flexop_control_stop(void);
+void flexop_lock(void);
+void flexop_unlock(void);
+
+/* Reloading the options file when it changes, for daemons: a thread
+ * watches 'path' (the -option_file if NULL) with inotify where available
+ * and reloads it on SIGHUP or flexop_reload. The file is read as by
+ * flexop_init, only lines which changed are split again, and only the
+ * options whose values changed are applied, at once while holding
+ * flexop_lock. An invalid file changes nothing, and neither does a handler
+ * which rejects its argument: the options of the reload are restored and
+ * the process goes on. An option removed from the file keeps its value.
+ *
+ * The getters and the variables of the options do not take flexop_lock.
+ * Other threads either hold it while they read options, or read
+ * flexop_generation before and after and read again if it was odd or
+ * changed: it is odd while a reload applies options. */
+int flexop_watch_start(const char *path);
+void flexop_watch_stop(void);
+int flexop_reload(void);
+unsigned long flexop_generation(void);
+
+/* Streamed options files, e.g. from a generator: "-option_file -" reads the
+ * options file from stdin, and a pipe, FIFO or any file which is not a
+ * regular file is read the same way. Options are applied as soon as they
+ * are complete, a line, or the next one for an option whose argument is
+ * on the next line. flexop_init returns at the end of the stream.
+ *
+ * To set up the application while the generator is still writing, read
+ * the options file from descriptor fd after flexop_init: flexop_stream_read
+ * applies the options which have arrived, waiting for a line if 'wait' is
+ * set, and returns 0 at the end of the stream, 1 otherwise. 'name' is the
+ * file name for provenance (NULL: "stdin"). Errors are fatal as in any
+ * options file. One stream can be open at a time, flexop_stream_close does
+ * not close fd. */
+FLEXOP_STREAM * flexop_stream_open(int fd, const char *name);
+int flexop_stream_read(FLEXOP_STREAM *s, int wait);
+void flexop_stream_close(FLEXOP_STREAM *s);
+
+/* Shared images for pre-forked or re-executed workers. flexop_export writes
+ * all options and their current values to the file 'path', e.g. in
+ * /dev/shm. flexop_attach maps such a file read-only and takes the values
+ * from it, vectors are used in place without copying. It can be called
+ * after flexop_init, or instead of it once all options are registered.
+ * Both return 1 on success, 0 otherwise. */
+int flexop_export(const char *path);
+int flexop_attach(const char *path);
+
+/* The same image in memory, e.g. to broadcast the options parsed by one MPI
+ * rank: flexop_pack returns a buffer of *len bytes to be freed with
+ * flexop_free, flexop_unpack takes the values from it (copied) and, like
+ * flexop_attach, can be called instead of flexop_init. */
+int flexop_pack(void **buf, size_t *len);
+int flexop_unpack(const void *buf, size_t len);
+
+/* Cache of parsed options files, off by default. When enabled, the result
+ * of parsing an options file is saved to "file.cache", or to a file in
+ * 'dir' if it is not NULL, and is mapped instead of parsing the file again
+ * as long as the file content and the registered options are the same. */
+void flexop_enable_cache(const char *dir);
+void flexop_disable_cache(void);
+
 /* registration */
 void flexop_register_bool(const char *name, const char *help, int *var);
 void flexop_register_int(const char *name, const char *help, FLEXOP_INT *var);
 void flexop_register_uint(const char *name, const char *help, FLEXOP_UINT *var);
 void flexop_register_float(const char *name, const char *help, FLEXOP_FLOAT *var);
 void flexop_register_string(const char *name, const char *help, char **var);
+void flexop_register_size(const char *name, const char *help, FLEXOP_SIZE *var);
+void flexop_register_duration(const char *name, const char *help, FLEXOP_DURATION *var);
 void flexop_register_keyword(const char *name, const char *help, const char **keys, int *var);
 void flexop_register_handler(const char *name, const char *help, FLEXOP_HANDLER func, void *hvar);
 void flexop_register_title(const char *str, const char *help, const char *category);
@@ -36,6 +229,55 @@ void flexop_register_vec_int(const char *name, const char *help, FLEXOP_VEC *var
 void flexop_register_vec_uint(const char *name, const char *help, FLEXOP_VEC *var);
 void flexop_register_vec_float(const char *name, const char *help, FLEXOP_VEC *var);
 void flexop_register_vec_string(const char *name, const char *help, FLEXOP_VEC *var);
+void flexop_register_vec_size(const char *name, const char *help, FLEXOP_VEC *var);
+void flexop_register_vec_duration(const char *name, const char *help, FLEXOP_VEC *var);
+
+/* Numbers stored with width w instead of as FLEXOP_INT, FLEXOP_UINT or
+ * FLEXOP_FLOAT, see FLEXOP_WIDTH: var points to an int8_t for FLEXOP_INT8,
+ * a float for FLEXOP_FLOAT32, etc. The type of the option follows from w.
+ * The other functions (flexop_get_int, flexop_set_float, ...) convert the
+ * values, flexop_get_xxx below return them as stored. */
+void flexop_register_number(const char *name, const char *help, void *var, FLEXOP_WIDTH w);
+void flexop_register_vec_number(const char *name, const char *help, FLEXOP_VEC *var, FLEXOP_WIDTH w);
+
+/* Profiles: named option strings applied with "-profile a,b", in this
+ * order, where -profile is given, e.g. flexop_register_profile("fast",
+ * "-order 1 -tol 1e-3"). A profile is parsed once, when flexop_init has all
+ * options (immediately if registered later), invalid ones are fatal then,
+ * applying it only stores the values. It cannot contain -profile. Options
+ * set by a profile have source FLEXOP_SRC_PROFILE. */
+void flexop_register_profile(const char *name, const char *optstr);
+
+/* Constraints, declared after registering the option and checked each time
+ * it is set: a value from the command line, an options file or
+ * flexop_set_options which violates them is an error, flexop_set_xxx (which
+ * return 0), the control socket and reloading reject it and keep the old
+ * value. The default value is not checked.
+ *
+ * flexop_constrain_range: bounds of the values (elements of vectors), in
+ * the syntax of the option, e.g. "1", "0.5", "4k" or "10ms"; NULL means
+ * unbounded.
+ * flexop_constrain: FLEXOP_CHECK_POSITIVE, _FINITE (floats), _INCREASING or
+ * _DECREASING, optionally with _STRICT (vectors of numbers).
+ * flexop_constrain_length: number of elements of vectors, or characters of
+ * strings, max < 0 means no limit.
+ * flexop_constrain_keys: a subset of the keywords of a keyword option, or
+ * the allowed values of a string or of the elements of a vector of
+ * strings. */
+#define FLEXOP_CHECK_MIN            0x01
+#define FLEXOP_CHECK_MAX            0x02
+#define FLEXOP_CHECK_POSITIVE       0x04
+#define FLEXOP_CHECK_FINITE         0x08
+#define FLEXOP_CHECK_INCREASING     0x10
+#define FLEXOP_CHECK_DECREASING     0x20
+#define FLEXOP_CHECK_STRICT         0x40
+#define FLEXOP_CHECK_LENGTH         0x80
+#define FLEXOP_CHECK_KEYS           0x100
+
+void flexop_constrain_range(const char *name, const char *min, const char *max);
+void flexop_constrain(const char *name, int flags);
+void flexop_constrain_length(const char *name, FLEXOP_INT min, FLEXOP_INT max);
+void flexop_constrain_keys(const char *name, const char **keys);
 
 /* getter */
 int flexop_get_bool(const char *op_name);
@@ -43,15 +285,32 @@ FLEXOP_INT flexop_get_int(const char *op_name);
 FLEXOP_UINT flexop_get_uint(const char *op_name);
 FLEXOP_FLOAT flexop_get_float(const char *op_name);
 const char * flexop_get_keyword(const char *op_name);
+int flexop_get_keyword_index(const char *op_name);
 const char * flexop_get_string(const char *op_name);
+FLEXOP_SIZE flexop_get_size(const char *op_name);
+FLEXOP_DURATION flexop_get_duration(const char *op_name);
+
+int8_t flexop_get_int8(const char *op_name);
+int16_t flexop_get_int16(const char *op_name);
+int32_t flexop_get_int32(const char *op_name);
+int64_t flexop_get_int64(const char *op_name);
+uint8_t flexop_get_uint8(const char *op_name);
+uint16_t flexop_get_uint16(const char *op_name);
+uint32_t flexop_get_uint32(const char *op_name);
+uint64_t flexop_get_uint64(const char *op_name);
+float flexop_get_float32(const char *op_name);
+double flexop_get_float64(const char *op_name);
+long double flexop_get_long_double(const char *op_name);
 
 FLEXOP_VEC * flexop_get_vec_int(const char *op_name);
 FLEXOP_VEC * flexop_get_vec_uint(const char *op_name);
 FLEXOP_VEC * flexop_get_vec_float(const char *op_name);
 FLEXOP_VEC * flexop_get_vec_string(const char *op_name);
+FLEXOP_VEC * flexop_get_vec_size(const char *op_name);
+FLEXOP_VEC * flexop_get_vec_duration(const char *op_name);
 
 /* setter */
-void flexop_set_options(const char *str);
+int flexop_set_options(const char *str);
 int flexop_set_bool(const char *op_name, int value);
 int flexop_set_int(const char *op_name, FLEXOP_INT value);
 int flexop_set_uint(const char *op_name, FLEXOP_UINT value);
@@ -60,11 +319,15 @@ int flexop_set_float(const char *op_name, FLEXOP_FLOAT value);
 int flexop_set_keyword(const char *op_name, const char *value);
 int flexop_set_string(const char *op_name, const char *value);
 int flexop_set_handler(const char *op_name, const char *value);
+int flexop_set_size(const char *op_name, FLEXOP_SIZE value);
+int flexop_set_duration(const char *op_name, FLEXOP_DURATION value);
 
 int flexop_set_vec_int(const char *op_name, const char *value);
 int flexop_set_vec_uint(const char *op_name, const char *value);
 int flexop_set_vec_float(const char *op_name, const char *value);
 int flexop_set_vec_string(const char *op_name, const char *value);
+int flexop_set_vec_size(const char *op_name, const char *value);
+int flexop_set_vec_duration(const char *op_name, const char *value);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,249 @@
+
+#include "flexop-buf.h"
+
+void flexop_buf_init(FLEXOP_BUF *b)
+{
+    assert(b != NULL);
+
+    b->d = NULL;
+    b->size = b->alloc = 0;
+}
+
+void flexop_buf_destroy(FLEXOP_BUF *b)
+{
+    if (b == NULL) return;
+
+    flexop_free(b->d);
+    flexop_buf_init(b);
+}
+
+void flexop_buf_reset(FLEXOP_BUF *b)
+{
+    assert(b != NULL);
+
+    b->size = 0;
+    if (b->d != NULL) b->d[0] = '\0';
+}
+
+void flexop_buf_reserve(FLEXOP_BUF *b, size_t n)
+{
+    assert(b != NULL);
+
+    /* +1 for '\0' */
+    if (b->size + n + 1 <= b->alloc) return;
+
+    b->alloc = b->alloc < 256 ? 256 : b->alloc;
+    while (b->size + n + 1 > b->alloc) b->alloc *= 2;
+
+    b->d = flexop_realloc(b->d, b->alloc);
+}
+
+void flexop_buf_append(FLEXOP_BUF *b, const char *s, size_t n)
+{
+    flexop_buf_reserve(b, n);
+
+    memcpy(b->d + b->size, s, n);
+    b->size += n;
+    b->d[b->size] = '\0';
+}
+
+void flexop_buf_puts(FLEXOP_BUF *b, const char *s)
+{
+    flexop_buf_append(b, s, strlen(s));
+}
+
+void flexop_buf_putc(FLEXOP_BUF *b, char c)
+{
+    flexop_buf_reserve(b, 1);
+
+    b->d[b->size++] = c;
+    b->d[b->size] = '\0';
+}
+
+void flexop_buf_vprintf(FLEXOP_BUF *b, const char *fmt, va_list ap)
+{
+    va_list aq;
+    int n;
+
+    flexop_buf_reserve(b, 128);
+
+    va_copy(aq, ap);
+    n = vsnprintf(b->d + b->size, b->alloc - b->size, fmt, aq);
+    va_end(aq);
+
+    if (n < 0) return;
+
+    if (b->size + n + 1 > b->alloc) {
+        flexop_buf_reserve(b, n);
+        vsnprintf(b->d + b->size, b->alloc - b->size, fmt, ap);
+    }
+
+    b->size += n;
+}
+
+void flexop_buf_printf(FLEXOP_BUF *b, const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    flexop_buf_vprintf(b, fmt, ap);
+    va_end(ap);
+}
+
+void flexop_buf_put_int(FLEXOP_BUF *b, FLEXOP_INT v)
+{
+    flexop_buf_reserve(b, FLEXOP_NUM_BUFSIZE);
+    b->size += flexop_format_int(b->d + b->size, v);
+}
+
+void flexop_buf_put_uint(FLEXOP_BUF *b, FLEXOP_UINT v)
+{
+    flexop_buf_reserve(b, FLEXOP_NUM_BUFSIZE);
+    b->size += flexop_format_uint(b->d + b->size, v);
+}
+
+void flexop_buf_put_float(FLEXOP_BUF *b, FLEXOP_FLOAT v)
+{
+    flexop_buf_reserve(b, FLEXOP_NUM_BUFSIZE);
+    b->size += flexop_format_float(b->d + b->size, v);
+}
+
+void flexop_buf_put_size(FLEXOP_BUF *b, FLEXOP_SIZE v)
+{
+    flexop_buf_reserve(b, FLEXOP_NUM_BUFSIZE);
+    b->size += flexop_format_size(b->d + b->size, v);
+}
+
+void flexop_buf_put_duration(FLEXOP_BUF *b, FLEXOP_DURATION v)
+{
+    flexop_buf_reserve(b, FLEXOP_NUM_BUFSIZE);
+    b->size += flexop_format_duration(b->d + b->size, v);
+}
+
+void flexop_buf_put_number(FLEXOP_BUF *b, FLEXOP_WIDTH w, const void *p)
+{
+    FLEXOP_WIDE v;
+
+    flexop_load_wide(&v, w, p);
+
+    flexop_buf_reserve(b, FLEXOP_NUM_BUFSIZE);
+    b->size += flexop_format_wide(b->d + b->size, w, &v);
+}
+
+void flexop_buf_flush(FLEXOP_BUF *b)
+{
+    assert(b != NULL);
+
+    flexop_write(b->d, b->size);
+    flexop_buf_reset(b);
+}
+
+#define FLEXOP_WRAP_BOL     0
+#define FLEXOP_WRAP_SPACE   1
+#define FLEXOP_WRAP_WORD    2
+
+/* starts a new line, after dropping the blanks at the end of the current one */
+static void flexop_wrap_newline(FLEXOP_WRAP *w)
+{
+    FLEXOP_BUF *b = w->b;
+
+    if (w->state == FLEXOP_WRAP_SPACE) b->size = w->space;
+
+    flexop_buf_putc(b, '\n');
+    flexop_buf_puts(b, w->indent);
+
+    w->col = strlen(w->indent);
+    w->line = b->size;
+    w->state = FLEXOP_WRAP_BOL;
+}
+
+/* the current word is complete, moves it to a new line if it is too long */
+static void flexop_wrap_word(FLEXOP_WRAP *w)
+{
+    FLEXOP_BUF *b = w->b;
+    size_t n = strlen(w->indent) + 1;
+    size_t len = b->size - w->word;
+
+    if (w->col <= w->width || w->space == w->line) return;
+
+    /* the blanks before the word are replaced by the newline and indent */
+    flexop_buf_reserve(b, n);
+    memmove(b->d + w->space + n, b->d + w->word, len);
+
+    b->d[w->space] = '\n';
+    memcpy(b->d + w->space + 1, w->indent, n - 1);
+
+    w->line = w->space + n;
+    w->space = w->word = w->line;
+    b->size = w->word + len;
+    b->d[b->size] = '\0';
+
+    w->col = n - 1 + len;
+}
+
+void flexop_wrap_init(FLEXOP_WRAP *w, FLEXOP_BUF *b, const char *indent, int width)
+{
+    assert(w != NULL && b != NULL && indent != NULL);
+
+    w->b = b;
+    w->indent = indent;
+    w->width = width;
+
+    flexop_buf_puts(b, indent);
+
+    w->col = strlen(indent);
+    w->line = w->space = w->word = b->size;
+    w->state = FLEXOP_WRAP_BOL;
+}
+
+void flexop_wrap_puts(FLEXOP_WRAP *w, const char *s)
+{
+    FLEXOP_BUF *b = w->b;
+    int n;
+
+    for (; *s != '\0'; s++) {
+        if (*s == '\n') {
+            if (w->state == FLEXOP_WRAP_WORD) flexop_wrap_word(w);
+            if (w->state != FLEXOP_WRAP_BOL) flexop_wrap_newline(w);
+
+            continue;
+        }
+
+        if (isspace(*(const unsigned char *)s)) {
+            if (w->state == FLEXOP_WRAP_BOL) continue;
+
+            if (w->state == FLEXOP_WRAP_WORD) {
+                flexop_wrap_word(w);
+
+                w->space = b->size;
+                w->state = FLEXOP_WRAP_SPACE;
+            }
+
+            /* tab stops every 8 columns of the text */
+            n = *s != '\t' ? 1 : 8 - (w->col - (int)strlen(w->indent)) % 8;
+            w->col += n;
+
+            while (n-- > 0) flexop_buf_putc(b, ' ');
+            continue;
+        }
+
+        if (w->state != FLEXOP_WRAP_WORD) {
+            if (w->state == FLEXOP_WRAP_BOL) w->space = b->size;
+
+            w->word = b->size;
+            w->state = FLEXOP_WRAP_WORD;
+        }
+
+        flexop_buf_putc(b, *s);
+        w->col++;
+    }
+}
+
+void flexop_wrap_end(FLEXOP_WRAP *w)
+{
+    if (w->state == FLEXOP_WRAP_WORD) flexop_wrap_word(w);
+    if (w->state == FLEXOP_WRAP_SPACE) w->b->size = w->space;
+
+    flexop_buf_putc(w->b, '\n');
+    w->state = FLEXOP_WRAP_BOL;
+}
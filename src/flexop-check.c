@@ -0,0 +1,705 @@
+
+#include "flexop-priv.h"
+
+#include <float.h>
+#include <math.h>
+
+/* Numeric values are checked in blocks of this many elements. The loops over
+ * a whole block have a constant trip count and no early exit, so that the
+ * compiler turns them into SIMD compares and OR reductions; a block which
+ * fails is scanned again element by element for the message. */
+#define FLEXOP_CHECK_BLOCK      512
+
+/* why a value failed */
+#define FLEXOP_WHY_MIN          1
+#define FLEXOP_WHY_MAX          2
+#define FLEXOP_WHY_POSITIVE     3
+#define FLEXOP_WHY_FINITE       4
+#define FLEXOP_WHY_ORDER        5
+#define FLEXOP_WHY_NAN          6
+
+/* order of vectors: 0, or 1 to 4 for increasing, strictly increasing,
+ * decreasing and strictly decreasing */
+static int flexop_check_order(const FLEXOP_CHECK *c)
+{
+    int strict = (c->flags & FLEXOP_CHECK_STRICT) != 0;
+
+    if (c->flags & FLEXOP_CHECK_INCREASING) return 1 + strict;
+    if (c->flags & FLEXOP_CHECK_DECREASING) return 3 + strict;
+
+    return 0;
+}
+
+/* The kernels compare keys of type K, "not a >= b" is returned in the most
+ * significant bit of a value of type A, so that the results of a block are
+ * OR'ed in a vector register and tested once. Integers are compared with
+ * subtractions and bit operations (Hacker's Delight, 2-12) and doubles as
+ * integers with the same order, since SSE2, the baseline of x86-64, has no
+ * compares of 64 bit integers and the compiler does not vectorize turning
+ * compares of doubles into integers. */
+#define FLEXOP_MSB(A, x)            ((A)(x) >> (sizeof(A) * CHAR_BIT - 1))
+
+#define FLEXOP_NGE_SIGNED(A, a, b)  (((A)(a) - (A)(b)) ^ (((A)(a) ^ (A)(b)) & (((A)(a) - (A)(b)) ^ (A)(a))))
+#define FLEXOP_NGE_UNSIGNED(A, a, b) ((~(A)(a) & (A)(b)) | ((~(A)(a) | (A)(b)) & ((A)(a) - (A)(b))))
+#define FLEXOP_NGE_NATIVE(A, a, b)  ((A)!((a) >= (b)) << (sizeof(A) * CHAR_BIT - 1))
+
+#define FLEXOP_KEY_ID(p)            (*(p))
+
+#if !FLEXOP_USE_LONG_DOUBLE
+/* sign and magnitude to two's complement: the order of doubles, -0 is 0 and
+ * NaNs are beyond the infinities */
+static uint64_t flexop_check_fkey(const FLEXOP_FLOAT *p)
+{
+    uint64_t b, s;
+
+    memcpy(&b, p, sizeof(b));
+    s = 0 - (b >> 63);
+
+    return ((b & ~((uint64_t)1 << 63)) ^ s) - s;
+}
+#endif
+
+/* Defines flexop_check_scan_S(x, n, range, lo, hi, order) for values of
+ * type T: the index of the first element not in 'order', or not in [lo, hi]
+ * if 'range' is set, n if none. Floats are always checked against a range,
+ * which excludes NaN. */
+#define FLEXOP_CHECK_DEFINE(S, T, K, A, KEY, NGE)                                   \
+static FLEXOP_INT flexop_check_scan_##S(const T *x, FLEXOP_INT n, int range, T lo, T hi, int order) \
+{                                                                                   \
+    const T *y;                                                                     \
+    FLEXOP_INT b, i;                                                                \
+    K klo = KEY(&lo), khi = KEY(&hi);                                               \
+    A bad;                                                                          \
+                                                                                    \
+    if (n == 0) return 0;                                                           \
+    if (FLEXOP_MSB(A, NGE(A, KEY(x), klo) | NGE(A, khi, KEY(x)))) return 0;         \
+                                                                                    \
+    /* blocks of elements 1 ... n - 1, each compared with the previous one */      \
+    for (b = 1; b + FLEXOP_CHECK_BLOCK <= n; b += FLEXOP_CHECK_BLOCK) {             \
+        y = x + b;                                                                  \
+        bad = 0;                                                                    \
+                                                                                    \
+        if (range) {                                                                \
+            for (i = 0; i < FLEXOP_CHECK_BLOCK; i++) {                              \
+                bad |= NGE(A, KEY(y + i), klo) | NGE(A, khi, KEY(y + i));           \
+            }                                                                       \
+        }                                                                           \
+                                                                                    \
+        switch (order) {                                                            \
+            case 1:                                                                 \
+                for (i = 0; i < FLEXOP_CHECK_BLOCK; i++) bad |= NGE(A, KEY(y + i), KEY(y + i - 1)); \
+                break;                                                              \
+                                                                                    \
+            case 2:                                                                 \
+                for (i = 0; i < FLEXOP_CHECK_BLOCK; i++) bad |= ~NGE(A, KEY(y + i - 1), KEY(y + i)); \
+                break;                                                              \
+                                                                                    \
+            case 3:                                                                 \
+                for (i = 0; i < FLEXOP_CHECK_BLOCK; i++) bad |= NGE(A, KEY(y + i - 1), KEY(y + i)); \
+                break;                                                              \
+                                                                                    \
+            case 4:                                                                 \
+                for (i = 0; i < FLEXOP_CHECK_BLOCK; i++) bad |= ~NGE(A, KEY(y + i), KEY(y + i - 1)); \
+                break;                                                              \
+        }                                                                           \
+                                                                                    \
+        if (FLEXOP_MSB(A, bad)) break;                                              \
+    }                                                                               \
+                                                                                    \
+    /* the failing block or the rest */                                             \
+    for (i = b; i < n; i++) {                                                       \
+        bad = NGE(A, KEY(x + i), klo) | NGE(A, khi, KEY(x + i));                    \
+                                                                                    \
+        switch (order) {                                                            \
+            case 1:                                                                 \
+                bad |= NGE(A, KEY(x + i), KEY(x + i - 1));                          \
+                break;                                                              \
+                                                                                    \
+            case 2:                                                                 \
+                bad |= ~NGE(A, KEY(x + i - 1), KEY(x + i));                         \
+                break;                                                              \
+                                                                                    \
+            case 3:                                                                 \
+                bad |= NGE(A, KEY(x + i - 1), KEY(x + i));                          \
+                break;                                                              \
+                                                                                    \
+            case 4:                                                                 \
+                bad |= ~NGE(A, KEY(x + i), KEY(x + i - 1));                         \
+                break;                                                              \
+        }                                                                           \
+                                                                                    \
+        if (FLEXOP_MSB(A, bad)) return i;                                           \
+    }                                                                               \
+                                                                                    \
+    return n;                                                                       \
+}
+
+/* Defines flexop_check_why_S(x, i, c): why x[i] failed, if not out of order */
+#define FLEXOP_CHECK_DEFINE_WHY(S, T, MIN, MAX)                                     \
+static int flexop_check_why_##S(const T *x, FLEXOP_INT i, const FLEXOP_CHECK *c)    \
+{                                                                                   \
+    if (x[i] != x[i]) return FLEXOP_WHY_NAN;                                        \
+    if ((c->flags & FLEXOP_CHECK_MIN) && !(x[i] >= c->MIN)) return FLEXOP_WHY_MIN;  \
+    if ((c->flags & FLEXOP_CHECK_MAX) && !(x[i] <= c->MAX)) return FLEXOP_WHY_MAX;  \
+    if ((c->flags & FLEXOP_CHECK_POSITIVE) && !(x[i] > 0)) return FLEXOP_WHY_POSITIVE; \
+    if ((c->flags & FLEXOP_CHECK_FINITE) && !(x[i] - x[i] == 0)) return FLEXOP_WHY_FINITE; \
+                                                                                    \
+    return FLEXOP_WHY_ORDER;                                                        \
+}
+
+FLEXOP_CHECK_DEFINE_WHY(int, FLEXOP_INT, imin, imax)
+FLEXOP_CHECK_DEFINE_WHY(uint, FLEXOP_UINT, umin, umax)
+FLEXOP_CHECK_DEFINE_WHY(float, FLEXOP_FLOAT, fmin, fmax)
+FLEXOP_CHECK_DEFINE_WHY(u64, uint64_t, zmin, zmax)
+
+FLEXOP_CHECK_DEFINE(int, FLEXOP_INT, FLEXOP_INT, FLEXOP_UINT, FLEXOP_KEY_ID, FLEXOP_NGE_SIGNED)
+FLEXOP_CHECK_DEFINE(uint, FLEXOP_UINT, FLEXOP_UINT, FLEXOP_UINT, FLEXOP_KEY_ID, FLEXOP_NGE_UNSIGNED)
+FLEXOP_CHECK_DEFINE(u64, uint64_t, uint64_t, uint64_t, FLEXOP_KEY_ID, FLEXOP_NGE_UNSIGNED)
+#if FLEXOP_USE_LONG_DOUBLE
+FLEXOP_CHECK_DEFINE(float, FLEXOP_FLOAT, FLEXOP_FLOAT, uint64_t, FLEXOP_KEY_ID, FLEXOP_NGE_NATIVE)
+#else
+FLEXOP_CHECK_DEFINE(float, FLEXOP_FLOAT, uint64_t, uint64_t, flexop_check_fkey, FLEXOP_NGE_SIGNED)
+#endif
+
+/* type of the values of 'o' */
+static FLEXOP_VTYPE flexop_check_etype(FLEXOP_KEY *o)
+{
+    switch (o->type) {
+        case VT_VEC_INT:
+        case VT_VEC_UINT:
+        case VT_VEC_FLOAT:
+        case VT_VEC_STRING:
+        case VT_VEC_SIZE:
+        case VT_VEC_DURATION:
+            return ((FLEXOP_VEC *)o->var)->type;
+
+        case VT_KEYWORD:
+            return VT_STRING;
+
+        default:
+            return o->type;
+    }
+}
+
+static int flexop_check_is_vec(FLEXOP_KEY *o)
+{
+    return o->type >= VT_VEC_INT && o->type <= VT_VEC_DURATION;
+}
+
+/* writes "value x[i]" or "element i (x[i])" of a vector to buf */
+static void flexop_check_what(char *buf, size_t n, FLEXOP_KEY *o, const void *x, FLEXOP_INT i)
+{
+    char v[FLEXOP_NUM_BUFSIZE];
+
+    switch (flexop_check_etype(o)) {
+        case VT_INT:
+            flexop_format_int(v, ((const FLEXOP_INT *)x)[i]);
+            break;
+
+        case VT_UINT:
+            flexop_format_uint(v, ((const FLEXOP_UINT *)x)[i]);
+            break;
+
+        case VT_FLOAT:
+            flexop_format_float(v, ((const FLEXOP_FLOAT *)x)[i]);
+            break;
+
+        case VT_SIZE:
+            flexop_format_size(v, ((const FLEXOP_SIZE *)x)[i]);
+            break;
+
+        case VT_DURATION:
+            flexop_format_duration(v, ((const FLEXOP_DURATION *)x)[i]);
+            break;
+
+        default:
+            v[0] = '\0';
+            break;
+    }
+
+    if (flexop_check_is_vec(o)) {
+        snprintf(buf, n, "element %ld (%s)", (long)i, v);
+    }
+    else {
+        snprintf(buf, n, "value %s", v);
+    }
+}
+
+/* strings: lengths and allowed values */
+static int flexop_check_strings(FLEXOP_KEY *o, const void *x, FLEXOP_INT n, char *msg, size_t len)
+{
+    const FLEXOP_CHECK *c = o->check;
+    const char *const *s = x;
+    FLEXOP_INT i, l;
+    char **pp;
+
+    for (i = 0; i < n; i++) {
+        if (s[i] == NULL) continue;
+
+        if (!flexop_check_is_vec(o) && (c->flags & FLEXOP_CHECK_LENGTH)) {
+            l = strlen(s[i]);
+
+            if (l < c->min_len || (c->max_len >= 0 && l > c->max_len)) {
+                snprintf(msg, len, "\"%s\" has %ld characters, allowed are %ld to %ld", s[i], (long)l,
+                        (long)c->min_len, (long)(c->max_len >= 0 ? c->max_len : FLEXOP_INT_MAX));
+                return 0;
+            }
+        }
+
+        if (c->flags & FLEXOP_CHECK_KEYS) {
+            for (pp = c->keys; *pp != NULL && strcmp(*pp, s[i]); pp++);
+
+            if (*pp == NULL) {
+                snprintf(msg, len, "\"%s\" is not allowed", s[i]);
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+int flexop_constraint_check(FLEXOP_KEY *o, const void *x, FLEXOP_INT n, char *msg, size_t len)
+{
+    const FLEXOP_CHECK *c = o->check;
+    char what[2 * FLEXOP_NUM_BUFSIZE];
+    int order, range, why = 0;
+    FLEXOP_INT i = n;
+    FLEXOP_INT ilo, ihi;
+    FLEXOP_UINT ulo, uhi;
+    FLEXOP_FLOAT flo, fhi;
+    uint64_t zlo, zhi;
+
+    if (c == NULL) return 1;
+
+    if (flexop_check_is_vec(o) && (c->flags & FLEXOP_CHECK_LENGTH)
+            && (n < c->min_len || (c->max_len >= 0 && n > c->max_len))) {
+        snprintf(msg, len, "%ld elements, allowed are %ld to %ld", (long)n, (long)c->min_len,
+                (long)(c->max_len >= 0 ? c->max_len : FLEXOP_INT_MAX));
+        return 0;
+    }
+
+    order = flexop_check_order(c);
+    range = (c->flags & (FLEXOP_CHECK_MIN | FLEXOP_CHECK_MAX | FLEXOP_CHECK_POSITIVE | FLEXOP_CHECK_FINITE)) != 0;
+
+    /* numbers with a length only */
+    if (!order && !range && flexop_check_etype(o) != VT_STRING) return 1;
+
+    /* the flags are folded into one range [lo, hi] */
+    switch (flexop_check_etype(o)) {
+        case VT_INT:
+            ilo = (c->flags & FLEXOP_CHECK_MIN) ? c->imin : FLEXOP_INT_MIN;
+            ihi = (c->flags & FLEXOP_CHECK_MAX) ? c->imax : FLEXOP_INT_MAX;
+            if ((c->flags & FLEXOP_CHECK_POSITIVE) && ilo < 1) ilo = 1;
+
+            i = flexop_check_scan_int(x, n, range, ilo, ihi, order);
+            if (i < n) why = flexop_check_why_int(x, i, c);
+            break;
+
+        case VT_UINT:
+            ulo = (c->flags & FLEXOP_CHECK_MIN) ? c->umin : 0;
+            uhi = (c->flags & FLEXOP_CHECK_MAX) ? c->umax : FLEXOP_UINT_MAX;
+            if ((c->flags & FLEXOP_CHECK_POSITIVE) && ulo < 1) ulo = 1;
+
+            i = flexop_check_scan_uint(x, n, range, ulo, uhi, order);
+            if (i < n) why = flexop_check_why_uint(x, i, c);
+            break;
+
+        case VT_FLOAT:
+            flo = (c->flags & FLEXOP_CHECK_MIN) ? c->fmin : -(FLEXOP_FLOAT)HUGE_VAL;
+            fhi = (c->flags & FLEXOP_CHECK_MAX) ? c->fmax : (FLEXOP_FLOAT)HUGE_VAL;
+
+#if FLEXOP_USE_LONG_DOUBLE
+            if ((c->flags & FLEXOP_CHECK_POSITIVE) && flo <= 0) flo = nextafterl(0, 1);
+            if ((c->flags & FLEXOP_CHECK_FINITE) && flo < -LDBL_MAX) flo = -LDBL_MAX;
+            if ((c->flags & FLEXOP_CHECK_FINITE) && fhi > LDBL_MAX) fhi = LDBL_MAX;
+#else
+            if ((c->flags & FLEXOP_CHECK_POSITIVE) && flo <= 0) flo = nextafter(0, 1);
+            if ((c->flags & FLEXOP_CHECK_FINITE) && flo < -DBL_MAX) flo = -DBL_MAX;
+            if ((c->flags & FLEXOP_CHECK_FINITE) && fhi > DBL_MAX) fhi = DBL_MAX;
+#endif
+
+            i = flexop_check_scan_float(x, n, 1, flo, fhi, order);
+            if (i < n) why = flexop_check_why_float(x, i, c);
+            break;
+
+        case VT_SIZE:
+        case VT_DURATION:
+            zlo = (c->flags & FLEXOP_CHECK_MIN) ? c->zmin : 0;
+            zhi = (c->flags & FLEXOP_CHECK_MAX) ? c->zmax : UINT64_MAX;
+            if ((c->flags & FLEXOP_CHECK_POSITIVE) && zlo < 1) zlo = 1;
+
+            i = flexop_check_scan_u64(x, n, range, zlo, zhi, order);
+            if (i < n) why = flexop_check_why_u64(x, i, c);
+            break;
+
+        case VT_STRING:
+            return flexop_check_strings(o, x, n, msg, len);
+
+        default:
+            return 1;
+    }
+
+    if (i >= n) return 1;
+
+    flexop_check_what(what, sizeof(what), o, x, i);
+
+    switch (why) {
+        case FLEXOP_WHY_MIN:
+            snprintf(msg, len, "%s is less than %s", what, c->smin);
+            break;
+
+        case FLEXOP_WHY_MAX:
+            snprintf(msg, len, "%s is greater than %s", what, c->smax);
+            break;
+
+        case FLEXOP_WHY_POSITIVE:
+            snprintf(msg, len, "%s is not positive", what);
+            break;
+
+        case FLEXOP_WHY_FINITE:
+            snprintf(msg, len, "%s is not a finite number", what);
+            break;
+
+        case FLEXOP_WHY_NAN:
+            snprintf(msg, len, "%s is not a number", what);
+            break;
+
+        default:
+            snprintf(msg, len, "%s is %s than the previous one", what,
+                    (c->flags & FLEXOP_CHECK_STRICT) ? ((c->flags & FLEXOP_CHECK_INCREASING) ? "not greater" : "not less")
+                    : ((c->flags & FLEXOP_CHECK_INCREASING) ? "less" : "greater"));
+            break;
+    }
+
+    return 0;
+}
+
+int flexop_constraint_check_stored(FLEXOP_KEY *o, const void *x, FLEXOP_INT n, char *msg, size_t len)
+{
+    FLEXOP_INT i;
+    size_t es, ws;
+    char *t;
+    int ok;
+
+    if (o->width == flexop_width_native(o->type)) return flexop_constraint_check(o, x, n, msg, len);
+
+    /* converted to the type of the bounds */
+    es = flexop_width_size(flexop_width_native(o->type));
+    ws = flexop_width_size(o->width);
+    t = flexop_malloc((n + 1) * es);
+
+    for (i = 0; i < n; i++) flexop_load(t + i * es, o->width, (const char *)x + i * ws);
+
+    ok = flexop_constraint_check(o, t, n, msg, len);
+    flexop_free(t);
+
+    return ok;
+}
+
+int flexop_constraint_check_key(FLEXOP_KEY *o, char *msg, size_t len)
+{
+    FLEXOP_VEC *v;
+    const char *s;
+
+    if (o->check == NULL) return 1;
+
+    if (flexop_check_is_vec(o)) {
+        v = o->var;
+        return flexop_constraint_check_stored(o, v->d, v->size, msg, len);
+    }
+
+    switch (o->type) {
+        case VT_STRING:
+            s = *(char **)o->var;
+            return flexop_constraint_check(o, &s, 1, msg, len);
+
+        case VT_KEYWORD:
+            s = *(int *)o->var < 0 ? NULL : o->keys[*(int *)o->var];
+            return flexop_constraint_check(o, &s, 1, msg, len);
+
+        default:
+            return flexop_constraint_check_stored(o, o->var, 1, msg, len);
+    }
+}
+
+/* parses one value of type 'type' at s into x, *end is set after it */
+static int flexop_check_parse(FLEXOP_VTYPE type, const char *s, const char **end, void *x)
+{
+    switch (type) {
+        case VT_INT:
+            return flexop_parse_int(s, end, x) == 1;
+
+        case VT_UINT:
+            return flexop_parse_uint(s, end, x) == 1;
+
+        case VT_FLOAT:
+            return flexop_parse_float(s, end, x) == 1;
+
+        case VT_SIZE:
+            return flexop_parse_size(s, end, x) == 1;
+
+        case VT_DURATION:
+            return flexop_parse_duration(s, end, x) == 1;
+
+        default:
+            return 0;
+    }
+}
+
+int flexop_constraint_check_arg(FLEXOP_KEY *o, const char *arg, char *msg, size_t len)
+{
+    FLEXOP_VTYPE type;
+    FLEXOP_INT n, k;
+    const char *p, *end;
+    char **s, *t, *q;
+    size_t es;
+    void *x;
+    int ok;
+    union {
+        FLEXOP_INT i;
+        FLEXOP_UINT u;
+        FLEXOP_FLOAT f;
+        uint64_t z;
+    } tp;
+
+    if (o->check == NULL) return 1;
+
+    type = flexop_check_etype(o);
+
+    if (!flexop_check_is_vec(o)) {
+        if (type == VT_STRING) return flexop_constraint_check(o, &arg, 1, msg, len);
+
+        /* syntax errors are reported by the parser */
+        return !flexop_check_parse(type, arg, &end, &tp) || flexop_constraint_check(o, &tp, 1, msg, len);
+    }
+
+    /* count the elements, as flexop_parse_vec splits them */
+    for (n = 0, p = arg; *p != '\0'; n++) {
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0') break;
+        while (*p != '\0' && *p != ' ' && *p != '\t') p++;
+    }
+
+    if (type == VT_STRING) {
+        t = strdup(arg);
+        s = flexop_malloc((n + 1) * sizeof(*s));
+
+        for (k = 0, q = strtok(t, " \t"); q != NULL; q = strtok(NULL, " \t")) s[k++] = q;
+
+        ok = flexop_constraint_check(o, s, k, msg, len);
+
+        flexop_free(s);
+        flexop_free(t);
+        return ok;
+    }
+
+    switch (type) {
+        case VT_INT:
+            es = sizeof(FLEXOP_INT);
+            break;
+
+        case VT_UINT:
+            es = sizeof(FLEXOP_UINT);
+            break;
+
+        case VT_FLOAT:
+            es = sizeof(FLEXOP_FLOAT);
+            break;
+
+        default:
+            es = sizeof(uint64_t);
+            break;
+    }
+
+    x = flexop_malloc((n + 1) * es);
+
+    for (k = 0, p = arg; k < n; k++, p = end) {
+        /* syntax errors are reported by the parser */
+        if (!flexop_check_parse(type, p, &end, (char *)x + k * es)) {
+            flexop_free(x);
+            return 1;
+        }
+    }
+
+    ok = flexop_constraint_check(o, x, n, msg, len);
+    flexop_free(x);
+
+    return ok;
+}
+
+void flexop_constraint_free(FLEXOP_CHECK *c)
+{
+    char **pp;
+
+    if (c == NULL) return;
+
+    if (c->keys != NULL) {
+        for (pp = c->keys; *pp != NULL; pp++) flexop_free(*pp);
+        flexop_free(c->keys);
+    }
+
+    flexop_free(c->smin);
+    flexop_free(c->smax);
+    flexop_free(c);
+}
+
+/* the constraints of option 'name', created if needed */
+static FLEXOP_CHECK * flexop_check_get(const char *name, const char *func, FLEXOP_KEY **key)
+{
+    FLEXOP_KEY *o = name == NULL ? NULL : flexop_lookup(name);
+
+    if (o == NULL || o->type == VT_TITLE) {
+        flexop_error(1, "%s: unknown option \"-%s\"!\n", func, name == NULL ? "" : name);
+    }
+
+    if (o->type == VT_BOOL || o->type == VT_HANDLER) {
+        flexop_error(1, "%s: option \"-%s\" cannot have constraints.\n", func, o->name);
+    }
+
+    if (o->check == NULL) o->check = flexop_calloc(1, sizeof(*o->check));
+
+    *key = o;
+    return o->check;
+}
+
+/* parses bound 's' of option 'o' into the field of its type */
+static void flexop_check_bound(FLEXOP_KEY *o, FLEXOP_CHECK *c, const char *s, int max, const char *func)
+{
+    const char *end;
+    int ok;
+
+    switch (flexop_check_etype(o)) {
+        case VT_INT:
+            ok = flexop_check_parse(VT_INT, s, &end, max ? (void *)&c->imax : (void *)&c->imin);
+            break;
+
+        case VT_UINT:
+            ok = flexop_check_parse(VT_UINT, s, &end, max ? (void *)&c->umax : (void *)&c->umin);
+            break;
+
+        case VT_FLOAT:
+            ok = flexop_check_parse(VT_FLOAT, s, &end, max ? (void *)&c->fmax : (void *)&c->fmin);
+            break;
+
+        case VT_SIZE:
+        case VT_DURATION:
+            ok = flexop_check_parse(flexop_check_etype(o), s, &end, max ? (void *)&c->zmax : (void *)&c->zmin);
+            break;
+
+        default:
+            flexop_error(1, "%s: option \"-%s\" is not a number.\n", func, o->name);
+            return;
+    }
+
+    /* NaN */
+    if (!ok || *end != '\0' || (c->fmin != c->fmin || c->fmax != c->fmax)) {
+        flexop_error(1, "%s: invalid bound \"%s\" for option \"-%s\".\n", func, s, o->name);
+    }
+
+    if (max) {
+        flexop_free(c->smax);
+        c->smax = strdup(s);
+        c->flags |= FLEXOP_CHECK_MAX;
+    }
+    else {
+        flexop_free(c->smin);
+        c->smin = strdup(s);
+        c->flags |= FLEXOP_CHECK_MIN;
+    }
+}
+
+void flexop_constrain_range(const char *name, const char *min, const char *max)
+{
+    FLEXOP_CHECK *c;
+    FLEXOP_KEY *o;
+
+    c = flexop_check_get(name, __func__, &o);
+
+    if (min != NULL) flexop_check_bound(o, c, min, 0, __func__);
+    if (max != NULL) flexop_check_bound(o, c, max, 1, __func__);
+}
+
+void flexop_constrain(const char *name, int flags)
+{
+    FLEXOP_CHECK *c;
+    FLEXOP_KEY *o;
+    FLEXOP_VTYPE type;
+
+    c = flexop_check_get(name, __func__, &o);
+    type = flexop_check_etype(o);
+
+    if ((flags & ~(FLEXOP_CHECK_POSITIVE | FLEXOP_CHECK_FINITE | FLEXOP_CHECK_INCREASING
+                    | FLEXOP_CHECK_DECREASING | FLEXOP_CHECK_STRICT))
+            || ((flags & FLEXOP_CHECK_INCREASING) && (flags & FLEXOP_CHECK_DECREASING))) {
+        flexop_error(1, "%s: invalid constraints for option \"-%s\".\n", __func__, o->name);
+    }
+
+    if ((flags & (FLEXOP_CHECK_POSITIVE | FLEXOP_CHECK_FINITE)) && type == VT_STRING) {
+        flexop_error(1, "%s: option \"-%s\" is not a number.\n", __func__, o->name);
+    }
+
+    if ((flags & FLEXOP_CHECK_FINITE) && type != VT_FLOAT) {
+        flexop_error(1, "%s: option \"-%s\" is not a floating point number.\n", __func__, o->name);
+    }
+
+    if ((flags & (FLEXOP_CHECK_INCREASING | FLEXOP_CHECK_DECREASING | FLEXOP_CHECK_STRICT))
+            && (!flexop_check_is_vec(o) || type == VT_STRING)) {
+        flexop_error(1, "%s: option \"-%s\" is not a vector of numbers.\n", __func__, o->name);
+    }
+
+    if (flags & (FLEXOP_CHECK_INCREASING | FLEXOP_CHECK_DECREASING)) {
+        c->flags &= ~(FLEXOP_CHECK_INCREASING | FLEXOP_CHECK_DECREASING | FLEXOP_CHECK_STRICT);
+    }
+
+    c->flags |= flags;
+}
+
+void flexop_constrain_length(const char *name, FLEXOP_INT min, FLEXOP_INT max)
+{
+    FLEXOP_CHECK *c;
+    FLEXOP_KEY *o;
+
+    c = flexop_check_get(name, __func__, &o);
+
+    if (!flexop_check_is_vec(o) && o->type != VT_STRING) {
+        flexop_error(1, "%s: option \"-%s\" is neither a vector nor a string.\n", __func__, o->name);
+    }
+
+    c->min_len = min < 0 ? 0 : min;
+    c->max_len = max;
+    c->flags |= FLEXOP_CHECK_LENGTH;
+}
+
+void flexop_constrain_keys(const char *name, const char **keys)
+{
+    FLEXOP_CHECK *c;
+    FLEXOP_KEY *o;
+    char **pp;
+    int i, n;
+
+    c = flexop_check_get(name, __func__, &o);
+
+    if (flexop_check_etype(o) != VT_STRING || keys == NULL) {
+        flexop_error(1, "%s: option \"-%s\" is not a keyword or a string.\n", __func__, o->name);
+    }
+
+    for (n = 0; keys[n] != NULL; n++) {
+        if (o->type != VT_KEYWORD) continue;
+
+        if (flexop_keyword_index(o, keys[n]) < 0) {
+            flexop_error(1, "%s: \"%s\" is not a keyword of option \"-%s\".\n", __func__, keys[n], o->name);
+        }
+    }
+
+    if (c->keys != NULL) {
+        for (pp = c->keys; *pp != NULL; pp++) flexop_free(*pp);
+        flexop_free(c->keys);
+    }
+
+    c->keys = flexop_malloc((n + 1) * sizeof(*c->keys));
+    for (i = 0; i < n; i++) c->keys[i] = strdup(keys[i]);
+    c->keys[n] = NULL;
+
+    c->flags |= FLEXOP_CHECK_KEYS;
+}
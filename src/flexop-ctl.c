@@ -0,0 +1,417 @@
+
+#include "flexop-priv.h"
+
+#if FLEXOP_USE_CONTROL
+
+#include <pthread.h>
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifdef MSG_NOSIGNAL
+#define FLEXOP_CTL_SEND_FLAGS   MSG_NOSIGNAL
+#else
+#define FLEXOP_CTL_SEND_FLAGS   0
+#endif
+
+/* longest request accepted, longer ones close the connection */
+#define FLEXOP_CTL_MAX_LINE     65536
+
+/* milliseconds without accepting after accept failed, e.g. with EMFILE */
+#define FLEXOP_CTL_RETRY_MS     100
+
+static pthread_mutex_t flexop_ctl_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct
+{
+    int running;
+    int fd;             /* listening socket */
+    int wake[2];        /* pipe to stop the thread */
+    char *path;
+    pthread_t thread;
+
+} flexop_ctl;
+
+void flexop_lock(void)
+{
+    pthread_mutex_lock(&flexop_ctl_lock);
+}
+
+void flexop_unlock(void)
+{
+    pthread_mutex_unlock(&flexop_ctl_lock);
+}
+
+static int flexop_ctl_send(int fd, FLEXOP_BUF *b)
+{
+    size_t n = 0;
+    ssize_t r;
+
+    while (n < b->size) {
+        r = send(fd, b->d + n, b->size - n, FLEXOP_CTL_SEND_FLAGS);
+
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return 0;
+
+        n += r;
+    }
+
+    flexop_buf_reset(b);
+    return 1;
+}
+
+/* appends "name value\n", strings quoted as flexop_dump does. Line breaks,
+ * which an options file cannot hold, are written as \n and \r. */
+static void flexop_ctl_put_option(FLEXOP_BUF *b, FLEXOP_KEY *o)
+{
+    const char *s, *p;
+
+    flexop_buf_puts(b, o->name);
+    flexop_buf_putc(b, ' ');
+
+    switch (o->type) {
+        case VT_STRING:
+            s = *(char **)o->var == NULL ? "" : *(char **)o->var;
+            break;
+
+        case VT_KEYWORD:
+            s = *(int *)o->var < 0 ? "none" : o->keys[*(int *)o->var];
+            break;
+
+        case VT_HANDLER:
+            s = o->keys == NULL || o->keys[0] == NULL ? "" : o->keys[0];
+            break;
+
+        default:
+            s = NULL;
+            break;
+    }
+
+    if (s == NULL) {
+        flexop_format_value(b, o);
+    }
+    else if (!flexop_dump_quote(b, s)) {
+        flexop_buf_putc(b, '"');
+
+        for (p = s; *p != '\0'; p++) {
+            if (*p == '\n' || *p == '\r') {
+                flexop_buf_puts(b, *p == '\n' ? "\\n" : "\\r");
+                continue;
+            }
+
+            if (*p == '"' || *p == '\\') flexop_buf_putc(b, '\\');
+            flexop_buf_putc(b, *p);
+        }
+
+        flexop_buf_putc(b, '"');
+    }
+
+    flexop_buf_putc(b, '\n');
+}
+
+/* whether 'o' is -help, -option_file or -profile, which are options of the
+ * library rather than of the program */
+static int flexop_ctl_internal(FLEXOP_KEY *o)
+{
+    FLEXOP *r = flexop_registry();
+
+    return o->var == &r->help_category || o->var == &r->opt_file
+        || (o->type == VT_HANDLER && o->var == (void *)flexop_profile_handler);
+}
+
+/* set: checks the whole string first so that a bad request changes nothing,
+ * then applies it and replies with the new values. A handler which rejects
+ * its argument does not stop the server whatever the error mode, the
+ * request is undone instead. */
+static void flexop_ctl_set(FLEXOP_BUF *b, const char *str)
+{
+    char msg[256], **argv = NULL, *p, *q;
+    int i, m, argc = 0, alloc = 0, ok;
+    FLEXOP_KEY *o;
+
+    flexop_lock();
+
+    if (!flexop_check_options(str, msg, sizeof(msg))) {
+        flexop_unlock();
+        flexop_buf_printf(b, "error: %s\n", msg);
+        return;
+    }
+
+    flexop_split_options(&argc, &argv, &alloc, str);
+
+    ok = flexop_apply_options(argc, argv, FLEXOP_SRC_SET, NULL, NULL, msg, sizeof(msg));
+
+    for (i = 0; ok && i < argc; i++) {
+        p = argv[i];
+        if (p[0] != '-' && p[0] != '+') continue;
+
+        q = strdup(p[0] == '-' && p[1] == '-' ? p + 2 : p + 1);
+        if ((p = strchr(q, '=')) != NULL) *p = '\0';
+
+        if ((o = flexop_match(q, &m)) != NULL) flexop_ctl_put_option(b, o);
+        flexop_free(q);
+    }
+
+    flexop_unlock();
+
+    for (i = 0; i < argc; i++) flexop_free(argv[i]);
+    flexop_free(argv);
+
+    if (ok) {
+        flexop_buf_puts(b, "ok\n");
+    }
+    else {
+        flexop_buf_printf(b, "error: %s\n", msg);
+    }
+}
+
+/* handles one request line, the reply is appended to b */
+static void flexop_ctl_request(FLEXOP_BUF *b, char *line)
+{
+    FLEXOP_KEY *o;
+    const char *name;
+    char *arg;
+    int it = 0;
+
+    for (arg = line + strlen(line); arg > line && isspace(arg[-1]); ) *(--arg) = '\0';
+    while (isspace(*line)) line++;
+
+    for (arg = line; *arg != '\0' && !isspace(*arg); arg++);
+    if (*arg != '\0') *(arg++) = '\0';
+    while (isspace(*arg)) arg++;
+
+    if (!strcmp(line, "set")) {
+        flexop_ctl_set(b, arg);
+    }
+    else if (!strcmp(line, "get")) {
+        flexop_lock();
+
+        if (*arg == '\0' || (o = flexop_lookup(arg)) == NULL || o->type == VT_TITLE) {
+            flexop_buf_printf(b, "error: unknown option \"%s\"\n", arg);
+        }
+        else {
+            flexop_ctl_put_option(b, o);
+            flexop_buf_puts(b, "ok\n");
+        }
+
+        flexop_unlock();
+    }
+    else if (!strcmp(line, "list")) {
+        flexop_lock();
+
+        while (flexop_origin_next(&it, &name, NULL)) {
+            o = flexop_lookup(name);
+            if (!flexop_ctl_internal(o)) flexop_ctl_put_option(b, o);
+        }
+
+        flexop_unlock();
+        flexop_buf_puts(b, "ok\n");
+    }
+    else if (*line != '\0') {
+        flexop_buf_printf(b, "error: unknown command \"%s\"\n", line);
+    }
+}
+
+/* serves one connection until it is closed or the service is stopped */
+static void flexop_ctl_serve(int fd)
+{
+    FLEXOP_BUF in, out;
+    struct pollfd pfd[2];
+    char buf[4096], *p, *e;
+    ssize_t r;
+
+    flexop_buf_init(&in);
+    flexop_buf_init(&out);
+
+    pfd[0].fd = fd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = flexop_ctl.wake[0];
+    pfd[1].events = POLLIN;
+
+    while (1) {
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (pfd[1].revents) break;
+
+        r = recv(fd, buf, sizeof(buf), 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+
+        flexop_buf_append(&in, buf, r);
+
+        /* complete lines */
+        p = in.d;
+        while ((e = memchr(p, '\n', in.size - (p - in.d))) != NULL) {
+            *e = '\0';
+            if (e > p && e[-1] == '\r') e[-1] = '\0';
+
+            flexop_ctl_request(&out, p);
+            p = e + 1;
+        }
+
+        /* keep the incomplete line */
+        in.size -= p - in.d;
+        memmove(in.d, p, in.size);
+        in.d[in.size] = '\0';
+
+        if (in.size > FLEXOP_CTL_MAX_LINE) {
+            flexop_buf_puts(&out, "error: request too long\n");
+            flexop_ctl_send(fd, &out);
+            break;
+        }
+
+        if (!flexop_ctl_send(fd, &out)) break;
+    }
+
+    flexop_buf_destroy(&in);
+    flexop_buf_destroy(&out);
+}
+
+/* a failing accept leaves the connection pending, the listening socket is
+ * then only polled again after FLEXOP_CTL_RETRY_MS instead of spinning */
+static void * flexop_ctl_main(void *arg)
+{
+    struct pollfd pfd[2];
+    int fd, n, retry = 0;
+
+    (void)arg;
+
+    pfd[0].fd = flexop_ctl.wake[0];
+    pfd[0].events = POLLIN;
+    pfd[1].fd = flexop_ctl.fd;
+    pfd[1].events = POLLIN;
+
+    while (1) {
+        if ((n = poll(pfd, retry ? 1 : 2, retry ? FLEXOP_CTL_RETRY_MS : -1)) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (pfd[0].revents) break;
+
+        retry = 0;
+        if (n == 0) continue;
+
+        if ((fd = accept(flexop_ctl.fd, NULL, NULL)) < 0) {
+            retry = errno != EINTR && errno != EAGAIN && errno != ECONNABORTED;
+            continue;
+        }
+
+        flexop_ctl_serve(fd);
+        close(fd);
+    }
+
+    return NULL;
+}
+
+int flexop_control_start(const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    if (flexop_ctl.running) {
+        flexop_warning("flexop: control socket is running already.\n");
+        return 0;
+    }
+
+    if (path == NULL || strlen(path) >= sizeof(addr.sun_path)) {
+        flexop_warning("flexop: invalid control socket path.\n");
+        return 0;
+    }
+
+    /* a stale socket of a previous run */
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        flexop_warning("flexop: cannot create control socket: %s.\n", strerror(errno));
+        return 0;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || chmod(path, 0600) < 0
+            || listen(fd, 4) < 0) {
+        flexop_warning("flexop: cannot listen on \"%s\": %s.\n", path, strerror(errno));
+        close(fd);
+        return 0;
+    }
+
+    if (pipe(flexop_ctl.wake) < 0) {
+        flexop_warning("flexop: cannot create pipe: %s.\n", strerror(errno));
+        close(fd);
+        unlink(path);
+        return 0;
+    }
+
+    flexop_ctl.fd = fd;
+    flexop_ctl.path = strdup(path);
+
+    if (pthread_create(&flexop_ctl.thread, NULL, flexop_ctl_main, NULL) != 0) {
+        flexop_warning("flexop: cannot create control thread.\n");
+        close(flexop_ctl.wake[0]);
+        close(flexop_ctl.wake[1]);
+        close(fd);
+        unlink(path);
+        flexop_free(flexop_ctl.path);
+        flexop_ctl.path = NULL;
+        return 0;
+    }
+
+    flexop_ctl.running = 1;
+    return 1;
+}
+
+void flexop_control_stop(void)
+{
+    char c = 0;
+
+    if (!flexop_ctl.running) return;
+
+    if (write(flexop_ctl.wake[1], &c, 1) < 0) {
+        flexop_warning("flexop: cannot stop control thread: %s.\n", strerror(errno));
+    }
+
+    pthread_join(flexop_ctl.thread, NULL);
+
+    close(flexop_ctl.wake[0]);
+    close(flexop_ctl.wake[1]);
+    close(flexop_ctl.fd);
+    unlink(flexop_ctl.path);
+
+    flexop_free(flexop_ctl.path);
+    flexop_ctl.path = NULL;
+    flexop_ctl.running = 0;
+}
+
+#else
+
+void flexop_lock(void)
+{
+}
+
+void flexop_unlock(void)
+{
+}
+
+int flexop_control_start(const char *path)
+{
+    (void)path;
+
+    flexop_warning("flexop: control socket is not available, see ./configure --enable-control.\n");
+    return 0;
+}
+
+void flexop_control_stop(void)
+{
+}
+
+#endif
@@ -0,0 +1,180 @@
+
+#include "flexop-priv.h"
+
+static int flexop_category_comp(const void *p0, const void *p1)
+{
+    const FLEXOP_CATEGORY *c0 = p0, *c1 = p1;
+    int r;
+
+    /* titles without category first, then by title */
+    if (c0->name == NULL || c1->name == NULL) {
+        if (c0->name != c1->name) return c0->name == NULL ? -1 : 1;
+    }
+    else if ((r = strcmp(c0->name, c1->name)) != 0) {
+        return r;
+    }
+
+    return c0->title - c1->title;
+}
+
+void flexop_category_build(FLEXOP *opt)
+{
+    FLEXOP_CATEGORY *c = NULL;
+    int i;
+
+    opt->cats = flexop_malloc((opt->size + 1) * sizeof(*opt->cats));
+    opt->ncats = 0;
+
+    for (i = 0; i < (int)opt->size; i++) {
+        if (c == NULL || opt->options[i].type == VT_TITLE) {
+            c = opt->cats + opt->ncats++;
+
+            /* options registered before any title have no category */
+            c->title = opt->options[i].type == VT_TITLE ? i : -1;
+            c->name = c->title < 0 ? NULL : opt->options[i].var;
+            c->lo = c->title + 1;
+        }
+
+        c->hi = i + 1;
+    }
+
+    qsort(opt->cats, opt->ncats, sizeof(*opt->cats), flexop_category_comp);
+}
+
+int flexop_category_find(const char *name, int *end)
+{
+    FLEXOP *r = flexop_registry();
+    FLEXOP_CATEGORY key;
+    int lo = 0, hi, mid;
+
+    flexop_sort(r);
+
+    key.name = name;
+    key.title = -2;
+
+    /* the first title of the category */
+    for (hi = r->ncats; lo < hi; ) {
+        mid = (lo + hi) / 2;
+
+        if (flexop_category_comp(r->cats + mid, &key) < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    /* and the last one */
+    for (hi = lo; hi < r->ncats; hi++) {
+        if (name == NULL ? r->cats[hi].name != NULL : r->cats[hi].name == NULL || strcmp(r->cats[hi].name, name)) {
+            break;
+        }
+    }
+
+    *end = hi;
+
+    return lo;
+}
+
+int flexop_category_next(int *it, const char **name)
+{
+    FLEXOP *r = flexop_registry();
+
+    assert(it != NULL);
+
+    flexop_sort(r);
+
+    /* skips titles without category and repeated categories */
+    while (*it >= 0 && *it < r->ncats) {
+        if (r->cats[*it].name != NULL && (*it == 0 || r->cats[*it - 1].name == NULL
+                    || strcmp(r->cats[*it - 1].name, r->cats[*it].name))) {
+            if (name != NULL) *name = r->cats[*it].name;
+            (*it)++;
+
+            return 1;
+        }
+
+        (*it)++;
+    }
+
+    return 0;
+}
+
+void flexop_cursor_init(FLEXOP_CURSOR *c, const char *category, unsigned int types, int used)
+{
+    FLEXOP *r = flexop_registry();
+
+    flexop_sort(r);
+
+    c->category = category;
+    c->types = types;
+    c->used = used;
+
+    if (category == NULL) {
+        /* the trie covers the options but not the titles */
+        c->cat = c->cend = 0;
+        c->pos = 0;
+        c->end = r->trie == NULL ? 0 : r->trie->hi;
+    }
+    else {
+        c->cat = flexop_category_find(category, &c->cend);
+        c->pos = c->end = 0;
+
+        if (c->cat < c->cend) {
+            c->pos = r->cats[c->cat].lo;
+            c->end = r->cats[c->cat].hi;
+        }
+    }
+}
+
+int flexop_cursor_next(FLEXOP_CURSOR *c, FLEXOP_VIEW *v)
+{
+    FLEXOP *r = flexop_registry();
+    FLEXOP_KEY *o;
+
+    while (1) {
+        while (c->pos >= c->end) {
+            if (c->category == NULL || ++c->cat >= c->cend) return 0;
+
+            c->pos = r->cats[c->cat].lo;
+            c->end = r->cats[c->cat].hi;
+        }
+
+        o = r->options + (c->category == NULL ? r->index[c->pos] : c->pos);
+        c->pos++;
+
+        if (c->types != 0 && !(c->types & FLEXOP_TYPE_BIT(o->type))) continue;
+        if (c->used >= 0 && o->used != c->used) continue;
+
+        break;
+    }
+
+    v->key = o;
+    v->name = o->name;
+    v->help = o->help;
+    v->type = o->type;
+    v->width = o->width;
+    v->used = o->used;
+    v->origin = &o->origin;
+
+    switch (o->type) {
+        case VT_STRING:
+            v->value = *(char **)o->var;
+            break;
+
+        case VT_KEYWORD:
+            v->value = *(int *)o->var < 0 ? NULL : o->keys[*(int *)o->var];
+            break;
+
+        case VT_HANDLER:
+            /* the last argument */
+            v->value = o->keys == NULL ? NULL : o->keys[0];
+            break;
+
+        default:
+            v->value = o->var;
+            break;
+    }
+
+    return 1;
+}
@@ -0,0 +1,909 @@
+
+#include "flexop-priv.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* alignment of values and of vector payloads */
+#define FLEXOP_IMAGE_ALIGN          16
+#define FLEXOP_IMAGE_VEC_ALIGN      64
+
+#define FLEXOP_HASH_INIT            0xcbf29ce484222325ULL
+#define FLEXOP_CACHE_MAGIC          "FLEXOPCC"
+
+/* cache of options files, see flexop_enable_cache */
+static int flexop_cache_on = 0;
+static char *flexop_cache_dir = NULL;
+
+/* 8 bytes per step, the bytes left with FNV-1a */
+uint64_t flexop_hash(const void *p, size_t n, uint64_t h)
+{
+    const unsigned char *s = p;
+    uint64_t w;
+
+    for (; n >= 8; n -= 8, s += 8) {
+        memcpy(&w, s, 8);
+        h = (h ^ w) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+    }
+
+    for (; n > 0; n--, s++) {
+        h ^= *s;
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+uint64_t flexop_image_schema(void)
+{
+    FLEXOP *r = flexop_registry();
+    FLEXOP_KEY *o;
+    uint64_t h = FLEXOP_HASH_INIT;
+    uint32_t t, w;
+    size_t i;
+
+    flexop_sort(r);
+
+    for (i = 0; i < r->size; i++) {
+        o = r->options + r->index[i];
+        if (o->type == VT_TITLE) continue;
+
+        t = o->type;
+        w = o->width;
+        h = flexop_hash(o->name, strlen(o->name) + 1, h);
+        h = flexop_hash(&t, sizeof(t), h);
+        h = flexop_hash(&w, sizeof(w), h);
+    }
+
+    return h;
+}
+
+/* size of an element of vector 'o' */
+static size_t flexop_image_esize(FLEXOP_KEY *o)
+{
+    switch (o->type) {
+        case VT_VEC_INT:
+        case VT_VEC_UINT:
+        case VT_VEC_FLOAT:
+            return flexop_width_size(o->width);
+
+        case VT_VEC_SIZE:
+            return sizeof(FLEXOP_SIZE);
+
+        case VT_VEC_DURATION:
+            return sizeof(FLEXOP_DURATION);
+
+        case VT_VEC_STRING:
+            return sizeof(uint64_t);
+
+        default:
+            return 0;
+    }
+}
+
+/* size of scalar 'o', 0 for strings */
+static size_t flexop_image_ssize(FLEXOP_KEY *o)
+{
+    switch (o->type) {
+        case VT_BOOL:
+            return sizeof(int);
+
+        case VT_INT:
+        case VT_UINT:
+        case VT_FLOAT:
+            return flexop_width_size(o->width);
+
+        case VT_SIZE:
+            return sizeof(FLEXOP_SIZE);
+
+        case VT_DURATION:
+            return sizeof(FLEXOP_DURATION);
+
+        default:
+            return 0;
+    }
+}
+
+/* pads b with zeros to a multiple of 'align', returns the new size */
+static uint64_t flexop_image_pad(FLEXOP_BUF *b, size_t align)
+{
+    size_t n = (align - b->size % align) % align;
+
+    flexop_buf_reserve(b, n);
+    memset(b->d + b->size, 0, n);
+    b->size += n;
+
+    return b->size;
+}
+
+static uint64_t flexop_image_put_string(FLEXOP_BUF *b, const char *s)
+{
+    uint64_t off = b->size;
+
+    if (s == NULL) return 0;
+
+    flexop_buf_append(b, s, strlen(s) + 1);
+    return off;
+}
+
+/* whether 'o' goes to an image of options set by 'file' (NULL: all) */
+static int flexop_image_wanted(FLEXOP_KEY *o, const char *file)
+{
+    if (o->type == VT_TITLE) return 0;
+    if (file == NULL) return 1;
+
+    return o->origin.src == FLEXOP_SRC_FILE && o->origin.file == file;
+}
+
+void flexop_image_build(FLEXOP_BUF *b, const char *file)
+{
+    FLEXOP *r = flexop_registry();
+    FLEXOP_IMAGE_HEADER h;
+    FLEXOP_IMAGE_ENTRY *tab, *e;
+    FLEXOP_KEY *o;
+    FLEXOP_VEC *v;
+    uint64_t *offs;
+    const char *p;
+    size_t i, n, k;
+    FLEXOP_INT j;
+
+    for (n = 0, i = 0; i < r->size; i++) {
+        if (flexop_image_wanted(r->options + i, file)) n++;
+    }
+
+    tab = flexop_calloc(n + 1, sizeof(*tab));
+
+    /* header and table are written at the end */
+    flexop_buf_reset(b);
+    flexop_buf_reserve(b, sizeof(h) + n * sizeof(*tab));
+    memset(b->d, 0, sizeof(h) + n * sizeof(*tab));
+    b->size = sizeof(h) + n * sizeof(*tab);
+
+    for (k = 0, i = 0; i < r->size; i++) {
+        o = r->options + i;
+        if (!flexop_image_wanted(o, file)) continue;
+
+        e = tab + k++;
+        e->name = flexop_image_put_string(b, o->name);
+        e->file = flexop_image_put_string(b, o->origin.file);
+        e->type = o->type;
+        e->width = o->width;
+        e->used = o->used;
+        e->src = o->origin.src;
+        e->pos = o->origin.pos;
+        e->nset = o->origin.count;
+        e->time = o->origin.time;
+
+        switch (o->type) {
+            case VT_BOOL:
+            case VT_INT:
+            case VT_UINT:
+            case VT_FLOAT:
+            case VT_SIZE:
+            case VT_DURATION:
+                e->value = flexop_image_pad(b, FLEXOP_IMAGE_ALIGN);
+                e->count = 1;
+                flexop_buf_append(b, o->var, flexop_image_ssize(o));
+                break;
+
+            case VT_STRING:
+                p = *(char **)o->var;
+                e->value = flexop_image_put_string(b, p);
+                e->count = p == NULL ? 0 : strlen(p);
+                break;
+
+            case VT_KEYWORD:
+                p = *(int *)o->var < 0 ? NULL : o->keys[*(int *)o->var];
+                e->value = flexop_image_put_string(b, p);
+                e->count = p == NULL ? 0 : strlen(p);
+                break;
+
+            case VT_HANDLER:
+                p = o->keys == NULL ? NULL : o->keys[0];
+                e->value = flexop_image_put_string(b, p);
+                e->count = p == NULL ? 0 : strlen(p);
+                break;
+
+            case VT_VEC_STRING:
+                v = o->var;
+                offs = flexop_malloc((v->size + 1) * sizeof(*offs));
+
+                for (j = 0; j < v->size; j++) {
+                    offs[j] = flexop_image_put_string(b, ((char **)v->d)[j]);
+                }
+
+                e->value = flexop_image_pad(b, FLEXOP_IMAGE_VEC_ALIGN);
+                e->count = v->size;
+                flexop_buf_append(b, (char *)offs, v->size * sizeof(*offs));
+                flexop_free(offs);
+                break;
+
+            case VT_VEC_INT:
+            case VT_VEC_UINT:
+            case VT_VEC_FLOAT:
+            case VT_VEC_SIZE:
+            case VT_VEC_DURATION:
+                v = o->var;
+                e->value = flexop_image_pad(b, FLEXOP_IMAGE_VEC_ALIGN);
+                e->count = v->size;
+                flexop_buf_append(b, v->d, v->size * flexop_image_esize(o));
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    flexop_image_pad(b, FLEXOP_IMAGE_ALIGN);
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, FLEXOP_IMAGE_MAGIC, sizeof(h.magic));
+    h.version = FLEXOP_IMAGE_VERSION;
+    h.endian = FLEXOP_IMAGE_ENDIAN;
+    h.int_size = sizeof(FLEXOP_INT);
+    h.float_size = sizeof(FLEXOP_FLOAT);
+    h.size = b->size;
+    h.schema = flexop_image_schema();
+    h.nentries = n;
+    h.entries = sizeof(h);
+
+    memcpy(b->d, &h, sizeof(h));
+    memcpy(b->d + h.entries, tab, n * sizeof(*tab));
+
+    flexop_free(tab);
+}
+
+/* whether [off, off + len) is inside the image */
+static int flexop_image_range(uint64_t size, uint64_t off, uint64_t len)
+{
+    return off <= size && len <= size - off;
+}
+
+/* the string at 'off', NULL if off is 0 or if it is not NUL terminated
+ * inside the image (*ok is cleared then) */
+static const char * flexop_image_string(const char *base, uint64_t size, uint64_t off, int *ok)
+{
+    if (off == 0) return NULL;
+
+    if (off >= size || memchr(base + off, '\0', size - off) == NULL) {
+        *ok = 0;
+        return NULL;
+    }
+
+    return base + off;
+}
+
+/* checks entry 'e', returns the option it is for or NULL. The origin is not
+ * checked for an options file, see flexop_image_apply */
+static FLEXOP_KEY * flexop_image_check(const char *base, uint64_t size, const FLEXOP_IMAGE_ENTRY *e,
+        const char *file, char *msg, size_t n)
+{
+    FLEXOP_KEY *o;
+    const char *name, *p;
+    const uint64_t *offs;
+    size_t es;
+    uint64_t j, off;
+    int ok = 1;
+
+    name = flexop_image_string(base, size, e->name, &ok);
+    if (name == NULL) {
+        snprintf(msg, n, "invalid option name");
+        return NULL;
+    }
+
+    if ((o = flexop_lookup(name)) == NULL || o->type == VT_TITLE) {
+        snprintf(msg, n, "unknown option \"-%s\"", name);
+        return NULL;
+    }
+
+    /* numbers of the default width may have width 0 */
+    if (e->type != (uint32_t)o->type
+            || (e->width == 0 ? flexop_width_native(o->type) : (FLEXOP_WIDTH)e->width) != o->width) {
+        snprintf(msg, n, "wrong type for option \"-%s\"", name);
+        return NULL;
+    }
+
+    if (file == NULL) {
+        flexop_image_string(base, size, e->file, &ok);
+        if (!ok || e->src < FLEXOP_SRC_DEFAULT || e->src > FLEXOP_SRC_PROFILE) {
+            snprintf(msg, n, "invalid origin of option \"-%s\"", name);
+            return NULL;
+        }
+    }
+
+    switch (o->type) {
+        case VT_BOOL:
+        case VT_INT:
+        case VT_UINT:
+        case VT_FLOAT:
+        case VT_SIZE:
+        case VT_DURATION:
+            ok = flexop_image_range(size, e->value, flexop_image_ssize(o));
+            break;
+
+        case VT_STRING:
+        case VT_HANDLER:
+            flexop_image_string(base, size, e->value, &ok);
+            break;
+
+        case VT_KEYWORD:
+            p = flexop_image_string(base, size, e->value, &ok);
+            if (ok && p != NULL) {
+                ok = flexop_keyword_index(o, p) >= 0;
+            }
+
+            break;
+
+        case VT_VEC_INT:
+        case VT_VEC_UINT:
+        case VT_VEC_FLOAT:
+        case VT_VEC_STRING:
+        case VT_VEC_SIZE:
+        case VT_VEC_DURATION:
+            es = flexop_image_esize(o);
+            ok = e->count <= (uint64_t)FLEXOP_INT_MAX && e->count <= size / es
+                && flexop_image_range(size, e->value, e->count * es);
+
+            if (ok && o->type == VT_VEC_STRING) {
+                offs = (const uint64_t *)(base + e->value);
+
+                for (j = 0; ok && j < e->count; j++) {
+                    memcpy(&off, offs + j, sizeof(off));
+                    if (flexop_image_string(base, size, off, &ok) == NULL) ok = 0;
+                }
+            }
+
+            break;
+
+        default:
+            ok = 0;
+            break;
+    }
+
+    if (!ok) {
+        snprintf(msg, n, "invalid value of option \"-%s\"", name);
+        return NULL;
+    }
+
+    return o;
+}
+
+/* checks the constraints of 'o' on the value of entry 'e', which is valid */
+static int flexop_image_constrained(const char *base, FLEXOP_KEY *o, const FLEXOP_IMAGE_ENTRY *e,
+        char *msg, size_t n)
+{
+    const char *s, **ss;
+    char cmsg[256];
+    const void *x;
+    void *copy = NULL;
+    uint64_t j, off;
+    size_t es;
+    int ok;
+    union {
+        FLEXOP_INT i;
+        FLEXOP_UINT u;
+        FLEXOP_FLOAT f;
+        uint64_t z;
+    } tp;
+
+    switch (o->type) {
+        case VT_INT:
+        case VT_UINT:
+        case VT_FLOAT:
+        case VT_SIZE:
+        case VT_DURATION:
+            memcpy(&tp, base + e->value, flexop_image_ssize(o));
+            ok = flexop_constraint_check_stored(o, &tp, 1, cmsg, sizeof(cmsg));
+            break;
+
+        case VT_STRING:
+        case VT_KEYWORD:
+            s = e->value == 0 ? NULL : base + e->value;
+            ok = flexop_constraint_check(o, &s, 1, cmsg, sizeof(cmsg));
+            break;
+
+        case VT_VEC_STRING:
+            ss = flexop_malloc((e->count + 1) * sizeof(*ss));
+
+            for (j = 0; j < e->count; j++) {
+                memcpy(&off, base + e->value + j * sizeof(off), sizeof(off));
+                ss[j] = base + off;
+            }
+
+            ok = flexop_constraint_check(o, ss, e->count, cmsg, sizeof(cmsg));
+            flexop_free(ss);
+            break;
+
+        case VT_VEC_INT:
+        case VT_VEC_UINT:
+        case VT_VEC_FLOAT:
+        case VT_VEC_SIZE:
+        case VT_VEC_DURATION:
+            /* in place, unless the writer did not align the values */
+            es = flexop_image_esize(o);
+            x = base + e->value;
+
+            if ((uintptr_t)x % es != 0) {
+                copy = flexop_malloc(e->count * es + 1);
+                memcpy(copy, x, e->count * es);
+                x = copy;
+            }
+
+            ok = flexop_constraint_check_stored(o, x, e->count, cmsg, sizeof(cmsg));
+            flexop_free(copy);
+            break;
+
+        default:
+            return 1;
+    }
+
+    if (!ok) snprintf(msg, n, "invalid value of option \"-%s\": %s", o->name, cmsg);
+
+    return ok;
+}
+
+/* sets 'o' from entry 'e' which has been checked. If 'file' is not NULL,
+ * the entry is an option set by options file 'file', at position 'pos' */
+static void flexop_image_apply(const char *base, FLEXOP_KEY *o, const FLEXOP_IMAGE_ENTRY *e, int map,
+        const char *file, int pos)
+{
+    FLEXOP_VEC *v;
+    FLEXOP_VTYPE type;
+    const char *p;
+    uint64_t j, off;
+    size_t es;
+
+    switch (o->type) {
+        case VT_BOOL:
+        case VT_INT:
+        case VT_UINT:
+        case VT_FLOAT:
+        case VT_SIZE:
+        case VT_DURATION:
+            memcpy(o->var, base + e->value, flexop_image_ssize(o));
+            break;
+
+        case VT_STRING:
+            /* an unused string is the default of the writer, which is not
+             * owned by flexop, keep ours */
+            if (!e->used && file == NULL) return;
+
+            if (o->used) flexop_free(*(char **)o->var);
+
+            p = e->value == 0 ? NULL : base + e->value;
+            *(char **)o->var = p == NULL ? NULL : strdup(p);
+            break;
+
+        case VT_KEYWORD:
+            *(int *)o->var = -1;
+
+            if (e->value != 0) {
+                *(int *)o->var = flexop_keyword_index(o, base + e->value);
+            }
+
+            break;
+
+        case VT_HANDLER:
+            if (e->value == 0) break;
+
+            if (o->keys != NULL) flexop_free(o->keys[0]);
+
+            o->keys = flexop_realloc(o->keys, 2 * sizeof(*o->keys));
+            o->keys[0] = strdup(base + e->value);
+            o->keys[1] = NULL;
+
+            /* the handler has side effects in the process which parsed it */
+            if ((e->used || file != NULL) && o->var != NULL && !((FLEXOP_HANDLER)o->var)(o, o->keys[0])) {
+                flexop_warning("flexop: invalid argument for \"-%s\" option.\n", o->name);
+            }
+
+            break;
+
+        case VT_VEC_INT:
+        case VT_VEC_UINT:
+        case VT_VEC_FLOAT:
+        case VT_VEC_STRING:
+        case VT_VEC_SIZE:
+        case VT_VEC_DURATION:
+            v = o->var;
+            type = v->type;
+            es = flexop_image_esize(o);
+
+            flexop_vec_destroy(v);
+            flexop_vec_init(v, type, -1, o->name);
+            if (o->width != v->width) flexop_vec_set_width(v, o->width);
+
+            if (e->count == 0) break;
+
+            if (type == VT_STRING) {
+                for (j = 0; j < e->count; j++) {
+                    memcpy(&off, base + e->value + j * es, sizeof(off));
+                    flexop_vec_add_entry(v, (void *)(base + off));
+                }
+            }
+            else if (map && (uintptr_t)(base + e->value) % es == 0) {
+                v->d = (void *)(base + e->value);
+                v->size = v->alloc = e->count;
+                v->mapped = 1;
+            }
+            else {
+                v->d = flexop_malloc(e->count * es);
+                memcpy(v->d, base + e->value, e->count * es);
+                v->size = v->alloc = e->count;
+            }
+
+            break;
+
+        default:
+            break;
+    }
+
+    if (file != NULL) {
+        o->used = 1;
+        flexop_mark(o, FLEXOP_SRC_FILE, file, pos);
+        return;
+    }
+
+    o->used = e->used;
+    o->origin.src = e->src;
+    o->origin.file = e->file == 0 ? NULL : flexop_intern_file(base + e->file);
+    o->origin.pos = e->pos;
+    o->origin.count = e->nset;
+    o->origin.time = e->time;
+}
+
+int flexop_image_load(const void *image, size_t size, int map, const char *file, char *msg, size_t n)
+{
+    const char *base = image;
+    FLEXOP_IMAGE_HEADER h;
+    FLEXOP_IMAGE_ENTRY e;
+    FLEXOP_KEY **keys;
+    uint64_t i;
+
+    if (size < sizeof(h)) {
+        snprintf(msg, n, "image is too short");
+        return 0;
+    }
+
+    memcpy(&h, base, sizeof(h));
+
+    if (memcmp(h.magic, FLEXOP_IMAGE_MAGIC, sizeof(h.magic))) {
+        snprintf(msg, n, "not an image");
+        return 0;
+    }
+
+    if (h.version != FLEXOP_IMAGE_VERSION || h.endian != FLEXOP_IMAGE_ENDIAN
+            || h.int_size != sizeof(FLEXOP_INT) || h.float_size != sizeof(FLEXOP_FLOAT)) {
+        snprintf(msg, n, "image is of a different version or platform");
+        return 0;
+    }
+
+    if (h.size > size || h.nentries > h.size / sizeof(e)
+            || !flexop_image_range(h.size, h.entries, h.nentries * sizeof(e))) {
+        snprintf(msg, n, "image is truncated or corrupted");
+        return 0;
+    }
+
+    size = h.size;
+
+    /* check all, then apply all */
+    keys = flexop_malloc((h.nentries + 1) * sizeof(*keys));
+
+    for (i = 0; i < h.nentries; i++) {
+        memcpy(&e, base + h.entries + i * sizeof(e), sizeof(e));
+
+        if ((keys[i] = flexop_image_check(base, size, &e, file, msg, n)) == NULL) {
+            flexop_free(keys);
+            return 0;
+        }
+
+        /* values at their defaults are not checked */
+        if (keys[i]->check != NULL && (e.used || file != NULL)
+                && !flexop_image_constrained(base, keys[i], &e, msg, n)) {
+            flexop_free(keys);
+            return 0;
+        }
+    }
+
+    for (i = 0; i < h.nentries; i++) {
+        memcpy(&e, base + h.entries + i * sizeof(e), sizeof(e));
+        flexop_image_apply(base, keys[i], &e, map, file, (int)i + 1);
+    }
+
+    flexop_free(keys);
+    return 1;
+}
+
+void flexop_image_release(void)
+{
+    FLEXOP *r = flexop_registry();
+    int i;
+
+    for (i = 0; i < r->nmaps; i++) munmap(r->maps[i], r->map_size[i]);
+
+    flexop_free(r->maps);
+    flexop_free(r->map_size);
+
+    r->maps = NULL;
+    r->map_size = NULL;
+    r->nmaps = 0;
+}
+
+/* keeps a mapping until flexop_image_release */
+static void flexop_image_keep(void *p, size_t size)
+{
+    FLEXOP *r = flexop_registry();
+
+    r->maps = flexop_realloc(r->maps, (r->nmaps + 1) * sizeof(*r->maps));
+    r->map_size = flexop_realloc(r->map_size, (r->nmaps + 1) * sizeof(*r->map_size));
+    r->maps[r->nmaps] = p;
+    r->map_size[r->nmaps++] = size;
+}
+
+/* writes 'hdr' and 'b' to a temporary file which is renamed to 'path', so
+ * readers never see a partial file */
+static int flexop_image_write(const char *path, const void *hdr, size_t hn, FLEXOP_BUF *b)
+{
+    const char *d;
+    char *tmp;
+    size_t n, size, part;
+    ssize_t w;
+    int fd, ret = 1;
+
+    tmp = flexop_malloc(strlen(path) + 32);
+    sprintf(tmp, "%s.%ld.tmp", path, (long)getpid());
+
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        flexop_free(tmp);
+        return 0;
+    }
+
+    for (part = 0; ret && part < 2; part++) {
+        d = part == 0 ? hdr : b->d;
+        size = part == 0 ? hn : b->size;
+
+        for (n = 0; n < size; n += w) {
+            w = write(fd, d + n, size - n);
+
+            if (w < 0 && errno == EINTR) {
+                w = 0;
+                continue;
+            }
+
+            if (w <= 0) {
+                ret = 0;
+                break;
+            }
+        }
+    }
+
+    if (close(fd) < 0) ret = 0;
+    if (ret && rename(tmp, path) < 0) ret = 0;
+    if (!ret) unlink(tmp);
+
+    flexop_free(tmp);
+    return ret;
+}
+
+/* maps file 'path' read-only, *size is set to its size */
+static void * flexop_image_map(const char *path, size_t *size)
+{
+    struct stat st;
+    void *p;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0) return NULL;
+
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (p == MAP_FAILED) return NULL;
+
+    *size = st.st_size;
+    return p;
+}
+
+int flexop_export(const char *path)
+{
+    FLEXOP_BUF b;
+    int ret;
+
+    if (!flexop_registry()->initialized) flexop_error(1, "%s must be called after flexop_init!\n", __func__);
+
+    flexop_buf_init(&b);
+    flexop_image_build(&b, NULL);
+
+    if (!(ret = flexop_image_write(path, NULL, 0, &b))) {
+        flexop_warning("flexop: cannot write \"%s\": %s.\n", path, strerror(errno));
+    }
+
+    flexop_buf_destroy(&b);
+    return ret;
+}
+
+int flexop_attach(const char *path)
+{
+    char msg[256];
+    size_t size;
+    void *p;
+
+    flexop_init_registry();
+
+    if ((p = flexop_image_map(path, &size)) == NULL) {
+        flexop_warning("flexop: cannot map \"%s\": %s.\n", path, strerror(errno));
+        return 0;
+    }
+
+    if (!flexop_image_load(p, size, 1, NULL, msg, sizeof(msg))) {
+        flexop_warning("flexop: \"%s\": %s.\n", path, msg);
+        munmap(p, size);
+        return 0;
+    }
+
+    /* keep the mapping, vectors point into it */
+    flexop_image_keep(p, size);
+
+    return 1;
+}
+
+int flexop_image_options_file(const char *fn)
+{
+    char magic[8], msg[256];
+    size_t size;
+    ssize_t r;
+    void *p;
+    int fd;
+
+    if ((fd = open(fn, O_RDONLY)) < 0) return 0;
+
+    r = read(fd, magic, sizeof(magic));
+    close(fd);
+
+    if (r != (ssize_t)sizeof(magic) || memcmp(magic, FLEXOP_IMAGE_MAGIC, sizeof(magic))) return 0;
+
+    if ((p = flexop_image_map(fn, &size)) == NULL) {
+        flexop_error(1, "flexop: cannot map options file \"%s\": %s.\n", fn, strerror(errno));
+    }
+
+    if (!flexop_image_load(p, size, 1, flexop_intern_file(fn), msg, sizeof(msg))) {
+        flexop_error(1, "flexop: options file \"%s\": %s.\n", fn, msg);
+    }
+
+    flexop_image_keep(p, size);
+
+    return 1;
+}
+
+int flexop_pack(void **buf, size_t *len)
+{
+    FLEXOP_BUF b;
+
+    assert(buf != NULL && len != NULL);
+
+    if (!flexop_registry()->initialized) flexop_error(1, "%s must be called after flexop_init!\n", __func__);
+
+    flexop_buf_init(&b);
+    flexop_image_build(&b, NULL);
+
+    *buf = b.d;
+    *len = b.size;
+
+    return 1;
+}
+
+int flexop_unpack(const void *buf, size_t len)
+{
+    char msg[256];
+
+    flexop_init_registry();
+
+    if (buf == NULL || !flexop_image_load(buf, len, 0, NULL, msg, sizeof(msg))) {
+        flexop_warning("flexop: cannot unpack options: %s.\n", buf == NULL ? "no data" : msg);
+        return 0;
+    }
+
+    return 1;
+}
+
+void flexop_enable_cache(const char *dir)
+{
+    flexop_free(flexop_cache_dir);
+
+    flexop_cache_dir = dir == NULL ? NULL : strdup(dir);
+    flexop_cache_on = 1;
+}
+
+void flexop_disable_cache(void)
+{
+    flexop_free(flexop_cache_dir);
+
+    flexop_cache_dir = NULL;
+    flexop_cache_on = 0;
+}
+
+/* "fn.cache" next to the file, or "dir/name.<hash of path>.cache" */
+static char * flexop_cache_path(const char *fn)
+{
+    const char *base;
+    char *p;
+
+    if (flexop_cache_dir == NULL) {
+        p = flexop_malloc(strlen(fn) + 8);
+        sprintf(p, "%s.cache", fn);
+    }
+    else {
+        base = strrchr(fn, '/');
+        base = base == NULL ? fn : base + 1;
+
+        p = flexop_malloc(strlen(flexop_cache_dir) + strlen(base) + 32);
+        sprintf(p, "%s/%s.%016llx.cache", flexop_cache_dir, base,
+                (unsigned long long)flexop_hash(fn, strlen(fn), FLEXOP_HASH_INIT));
+    }
+
+    return p;
+}
+
+int flexop_cache_load(const char *fn, const char *text, size_t size, FLEXOP_CACHE_KEY *key)
+{
+    FLEXOP_CACHE_KEY ck;
+    struct stat st;
+    char msg[256], *path;
+    size_t n;
+    void *p;
+
+    if (!flexop_cache_on) return 0;
+
+    memset(key, 0, sizeof(*key));
+    memcpy(key->magic, FLEXOP_CACHE_MAGIC, sizeof(key->magic));
+    key->size = size;
+    key->mtime = stat(fn, &st) == 0 ? (int64_t)st.st_mtime : 0;
+    key->hash = flexop_hash(text, size, FLEXOP_HASH_INIT);
+    key->schema = flexop_image_schema();
+
+    path = flexop_cache_path(fn);
+    p = flexop_image_map(path, &n);
+    flexop_free(path);
+
+    if (p == NULL) return 0;
+
+    if (n > sizeof(ck)) {
+        memcpy(&ck, p, sizeof(ck));
+
+        /* the image follows the key, still aligned for the vectors */
+        if (!memcmp(&ck, key, sizeof(ck))
+                && flexop_image_load((char *)p + sizeof(ck), n - sizeof(ck), 1, NULL, msg, sizeof(msg))) {
+            flexop_image_keep(p, n);
+            return 1;
+        }
+    }
+
+    munmap(p, n);
+    return 0;
+}
+
+void flexop_cache_save(const char *file, const FLEXOP_CACHE_KEY *key)
+{
+    FLEXOP_BUF b;
+    char *path;
+
+    if (!flexop_cache_on) return;
+
+    flexop_buf_init(&b);
+    flexop_image_build(&b, file);
+
+    /* a cache which cannot be written is not an error */
+    path = flexop_cache_path(file);
+    flexop_image_write(path, key, sizeof(*key), &b);
+
+    flexop_free(path);
+    flexop_buf_destroy(&b);
+}
@@ -0,0 +1,344 @@
+
+#include "flexop-priv.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+/* output to a descriptor is written in chunks of this size */
+#define FLEXOP_JSON_CHUNK           65536
+
+/* the output, b is written to fd and emptied as it grows if fd >= 0 */
+typedef struct FLEXOP_JSON_
+{
+    FLEXOP_BUF *b;
+    int fd;
+    int err;
+
+} FLEXOP_JSON;
+
+/* writes b to fd, without flexop_lock */
+static void flexop_json_put(FLEXOP_JSON *j)
+{
+    FLEXOP_BUF *b = j->b;
+    size_t n = 0;
+    ssize_t r;
+
+    if (j->fd < 0 || j->err) return;
+
+    while (n < b->size) {
+        if ((r = write(j->fd, b->d + n, b->size - n)) < 0) {
+            if (errno == EINTR) continue;
+
+            j->err = 1;
+            break;
+        }
+
+        n += r;
+    }
+
+    flexop_buf_reset(b);
+}
+
+/* writes b to fd while holding flexop_lock, which is released during the
+ * write so that a slow reader does not stall the threads changing options */
+static void flexop_json_flush(FLEXOP_JSON *j)
+{
+    if (j->fd < 0 || j->err) return;
+
+    flexop_unlock();
+    flexop_json_put(j);
+    flexop_lock();
+}
+
+static const char * flexop_json_type(FLEXOP_VTYPE type)
+{
+    switch (type) {
+        case VT_BOOL:
+            return "bool";
+
+        case VT_KEYWORD:
+            return "keyword";
+
+        case VT_HANDLER:
+            return "handler";
+
+        case VT_INT:
+            return "int";
+
+        case VT_UINT:
+            return "uint";
+
+        case VT_FLOAT:
+            return "float";
+
+        case VT_STRING:
+            return "string";
+
+        case VT_SIZE:
+            return "size";
+
+        case VT_DURATION:
+            return "duration";
+
+        case VT_VEC_INT:
+            return "vec_int";
+
+        case VT_VEC_UINT:
+            return "vec_uint";
+
+        case VT_VEC_FLOAT:
+            return "vec_float";
+
+        case VT_VEC_STRING:
+            return "vec_string";
+
+        case VT_VEC_SIZE:
+            return "vec_size";
+
+        case VT_VEC_DURATION:
+            return "vec_duration";
+
+        default:
+            return "none";
+    }
+}
+
+/* appends s as a JSON string, null if s is NULL */
+static void flexop_json_string(FLEXOP_BUF *b, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *p;
+
+    if (s == NULL) {
+        flexop_buf_puts(b, "null");
+        return;
+    }
+
+    flexop_buf_putc(b, '"');
+
+    for (; *s != '\0'; s = p) {
+        /* runs which need no escape */
+        for (p = s; *p != '\0' && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20; p++);
+
+        flexop_buf_append(b, s, p - s);
+        if (*p == '\0') break;
+
+        flexop_buf_putc(b, '\\');
+
+        switch (*p) {
+            case '"':
+            case '\\':
+                flexop_buf_putc(b, *p);
+                break;
+
+            case '\n':
+                flexop_buf_putc(b, 'n');
+                break;
+
+            case '\r':
+                flexop_buf_putc(b, 'r');
+                break;
+
+            case '\t':
+                flexop_buf_putc(b, 't');
+                break;
+
+            default:
+                flexop_buf_puts(b, "u00");
+                flexop_buf_putc(b, hex[(unsigned char)*p >> 4]);
+                flexop_buf_putc(b, hex[*p & 15]);
+                break;
+        }
+
+        p++;
+    }
+
+    flexop_buf_putc(b, '"');
+}
+
+/* appends the number of width w at p, infinities and NaN as strings */
+static void flexop_json_number(FLEXOP_BUF *b, FLEXOP_WIDTH w, const void *p)
+{
+    size_t mark = b->size;
+    char s[FLEXOP_NUM_BUFSIZE];
+
+    flexop_buf_put_number(b, w, p);
+
+    if (strpbrk(b->d + mark, "in") != NULL) {
+        strcpy(s, b->d + mark);
+        b->size = mark;
+
+        flexop_json_string(b, s);
+    }
+}
+
+static void flexop_json_vec(FLEXOP_JSON *j, FLEXOP_VEC *v)
+{
+    FLEXOP_BUF *b = j->b;
+    FLEXOP_INT i;
+
+    flexop_buf_putc(b, '[');
+
+    for (i = 0; i < v->size; i++) {
+        if (i > 0) flexop_buf_putc(b, ',');
+
+        switch (v->type) {
+            case VT_INT:
+            case VT_UINT:
+            case VT_FLOAT:
+                flexop_json_number(b, v->width, (char *)v->d + i * v->tsize);
+                break;
+
+            case VT_STRING:
+                flexop_json_string(b, ((char **)v->d)[i]);
+                break;
+
+            case VT_SIZE:
+            case VT_DURATION:
+                flexop_buf_printf(b, "%llu", (unsigned long long)((uint64_t *)v->d)[i]);
+                break;
+
+            default:
+                break;
+        }
+
+        if (b->size >= FLEXOP_JSON_CHUNK) flexop_json_flush(j);
+    }
+
+    flexop_buf_putc(b, ']');
+}
+
+static void flexop_json_value(FLEXOP_JSON *j, FLEXOP_KEY *o)
+{
+    FLEXOP_BUF *b = j->b;
+
+    switch (o->type) {
+        case VT_BOOL:
+            flexop_buf_puts(b, *(int *)o->var ? "true" : "false");
+            break;
+
+        case VT_INT:
+        case VT_UINT:
+        case VT_FLOAT:
+            flexop_json_number(b, o->width, o->var);
+            break;
+
+        case VT_SIZE:
+            flexop_buf_printf(b, "%llu", (unsigned long long)*(FLEXOP_SIZE *)o->var);
+            break;
+
+        case VT_DURATION:
+            flexop_buf_printf(b, "%llu", (unsigned long long)*(FLEXOP_DURATION *)o->var);
+            break;
+
+        case VT_STRING:
+            flexop_json_string(b, *(char **)o->var);
+            break;
+
+        case VT_KEYWORD:
+            flexop_json_string(b, *(int *)o->var < 0 ? NULL : o->keys[*(int *)o->var]);
+            break;
+
+        case VT_HANDLER:
+            /* the last argument */
+            flexop_json_string(b, o->keys == NULL ? NULL : o->keys[0]);
+            break;
+
+        case VT_VEC_INT:
+        case VT_VEC_UINT:
+        case VT_VEC_FLOAT:
+        case VT_VEC_STRING:
+        case VT_VEC_SIZE:
+        case VT_VEC_DURATION:
+            flexop_json_vec(j, o->var);
+            break;
+
+        default:
+            flexop_buf_puts(b, "null");
+            break;
+    }
+}
+
+/* one pass over the options in registration order, for their categories.
+ * Options are taken by index, the lock is released at each flush. */
+static void flexop_json_write(FLEXOP_JSON *j, int flags)
+{
+    FLEXOP *r = flexop_registry();
+    FLEXOP_BUF *b = j->b;
+    FLEXOP_KEY *o;
+    const char *cat = NULL;
+    size_t i;
+    int n = 0;
+
+    flexop_lock();
+
+    if (!(flags & FLEXOP_JSON_LINES)) flexop_buf_putc(b, '[');
+
+    for (i = 0; i < r->size && !j->err; i++) {
+        o = r->options + i;
+
+        if (o->type == VT_TITLE) {
+            cat = o->var;
+            continue;
+        }
+
+        if (!o->used && !(flags & FLEXOP_JSON_ALL)) continue;
+
+        if (!(flags & FLEXOP_JSON_LINES)) flexop_buf_puts(b, n == 0 ? "\n" : ",\n");
+
+        flexop_buf_puts(b, "{\"name\":");
+        flexop_json_string(b, o->name);
+        flexop_buf_printf(b, ",\"type\":\"%s\",\"value\":", flexop_json_type(o->type));
+        flexop_json_value(j, o);
+        flexop_buf_printf(b, ",\"source\":\"%s\",\"category\":", flexop_source_name(o->origin.src));
+        flexop_json_string(b, cat);
+        flexop_buf_putc(b, '}');
+
+        if (flags & FLEXOP_JSON_LINES) flexop_buf_putc(b, '\n');
+
+        if (b->size >= FLEXOP_JSON_CHUNK) flexop_json_flush(j);
+        n++;
+    }
+
+    if (!(flags & FLEXOP_JSON_LINES)) flexop_buf_puts(b, n == 0 ? "]\n" : "\n]\n");
+
+    flexop_unlock();
+
+    flexop_json_put(j);
+}
+
+void flexop_json(FLEXOP_BUF *b, int flags)
+{
+    FLEXOP_JSON j;
+
+    if (!flexop_registry()->initialized) flexop_error(1, "%s must be called after flexop_init!\n", __func__);
+
+    assert(b != NULL);
+
+    j.b = b;
+    j.fd = -1;
+    j.err = 0;
+
+    flexop_json_write(&j, flags);
+}
+
+int flexop_json_fd(int fd, int flags)
+{
+    FLEXOP_JSON j;
+    FLEXOP_BUF b;
+
+    if (!flexop_registry()->initialized) flexop_error(1, "%s must be called after flexop_init!\n", __func__);
+
+    assert(fd >= 0);
+
+    flexop_buf_init(&b);
+
+    j.b = &b;
+    j.fd = fd;
+    j.err = 0;
+
+    flexop_json_write(&j, flags);
+    flexop_buf_destroy(&b);
+
+    return !j.err;
+}
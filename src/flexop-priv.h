@@ -0,0 +1,151 @@
+
+#ifndef FLEX_OPTION_PRIV_H
+#define FLEX_OPTION_PRIV_H
+
+#include "flexop.h"
+
+/* internal functions shared by the modules of the library, not installed */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the registry */
+FLEXOP * flexop_registry(void);
+void flexop_sort(FLEXOP *opt);
+
+/* sets up the registry without a command line, as flexop_init does */
+void flexop_init_registry(void);
+
+/* keeps a copy of the name of an options file for FLEXOP_ORIGIN.file */
+const char * flexop_intern_file(const char *fn);
+
+/* finds option 'name' (with or without the leading '-'), NULL if unknown */
+FLEXOP_KEY * flexop_lookup(const char *name);
+
+/* finds option 'name' as given by users: the option itself, or the only
+ * one it abbreviates, by a prefix of its name or prefixes of the
+ * components of its name separated by '_' or '.' ("solv_tol" for
+ * "solver_tolerance", "s.g.res" for "solver.gmres.restart"). Returns NULL
+ * if there is none or if it is ambiguous, *count is then 0 or more than 1. */
+FLEXOP_KEY * flexop_match(const char *name, int *count);
+
+/* the index of categories, built by flexop_sort. flexop_category_find
+ * returns the first entry of category 'name' in FLEXOP.cats, *end is set
+ * after its last one. */
+void flexop_category_build(FLEXOP *opt);
+int flexop_category_find(const char *name, int *end);
+
+/* position of keyword s of option 'o' (VT_KEYWORD), -1 if it is not one */
+int flexop_keyword_index(FLEXOP_KEY *o, const char *s);
+
+/* flexop_parse_options which returns 0 instead of exiting on unbalanced
+ * quotes, *argv is NULL terminated in both cases */
+int flexop_split_options(int *argc, char ***argv, int *alloc, const char *optstr);
+
+/* parses argv as options set from 'src', see FLEXOP_ORIGIN: positions
+ * are lines[i] if 'lines' is given, base + i otherwise */
+void flexop_parse_cmdline_from(int argc, char ***argv, FLEXOP_SOURCE src, const char *file,
+        const int *lines, int base);
+
+/* streamed options files, see flexop_stream_open. flexop_stream_line parses
+ * one line (modified, NULL for none) and applies the options which are
+ * complete, all of them if 'last'; *first is the index in the arguments of
+ * options files of the first one not applied. flexop_stream_options_file
+ * reads options file 'fn' as a stream if it is stdin ("-") or not a regular
+ * file, returns 0 otherwise. */
+void flexop_stream_line(char *p, const char *file, int line, int *first, int last);
+int flexop_is_stream(const char *fn);
+int flexop_stream_options_file(const char *fn);
+
+/* profiles, see flexop_register_profile. flexop_profile_resolve_all
+ * parses the profiles registered before flexop_init, exits if one is
+ * invalid. flexop_profile_handler handles -profile, flexop_profile_check
+ * whether its argument names valid profiles. */
+void flexop_profile_resolve_all(void);
+int flexop_profile_check(const char *arg);
+int flexop_profile_handler(FLEXOP_KEY *o, const char *arg);
+void flexop_profile_free(void);
+
+/* the options set by the profiles in 'arg' (freed by the caller), n of
+ * them, unknown or invalid profiles are skipped */
+FLEXOP_KEY ** flexop_profile_keys(const char *arg, int *n);
+
+/* applies argv, which has been checked, as flexop_parse_cmdline_from
+ * without exiting: if a handler rejects its argument, the options of argv
+ * get their previous values back and 0 is returned with the reason in
+ * msg. What handlers did themselves is not undone. */
+int flexop_apply_options(int argc, char **argv, FLEXOP_SOURCE src, const char *file, const int *lines,
+        char *msg, size_t n);
+
+/* reads file 'fn' into a NUL terminated buffer, NULL if it cannot be read */
+char * flexop_read_file(const char *fn, size_t *size);
+
+/* whether 'arg' is a valid argument of option 'o' */
+int flexop_check_arg(FLEXOP_KEY *o, const char *arg);
+
+/* constraints, see flexop_constrain. flexop_constraint_check checks n
+ * values (char ** for strings and keywords), flexop_constraint_check_stored
+ * n values stored with the width of 'o', flexop_constraint_check_key the
+ * current value of 'o' and flexop_constraint_check_arg argument 'arg',
+ * which must be valid otherwise. Return 1 if they are satisfied, otherwise
+ * 0 with the reason in msg. */
+int flexop_constraint_check(FLEXOP_KEY *o, const void *x, FLEXOP_INT n, char *msg, size_t len);
+int flexop_constraint_check_stored(FLEXOP_KEY *o, const void *x, FLEXOP_INT n, char *msg, size_t len);
+int flexop_constraint_check_key(FLEXOP_KEY *o, char *msg, size_t len);
+int flexop_constraint_check_arg(FLEXOP_KEY *o, const char *arg, char *msg, size_t len);
+void flexop_constraint_free(FLEXOP_CHECK *c);
+
+/* checks an option string without applying it. Returns 1 if it can be
+ * passed to flexop_set_options, otherwise 0 with the reason in msg. */
+int flexop_check_options(const char *str, char *msg, size_t n);
+
+/* appends the current value of 'o' to b */
+void flexop_format_value(FLEXOP_BUF *b, FLEXOP_KEY *o);
+
+/* appends 's' as one argument of an options file, quoted if needed. Returns
+ * 0 if it cannot be read back, nothing is appended then. */
+int flexop_dump_quote(FLEXOP_BUF *b, const char *s);
+
+/* records that 'o' has been set, see FLEXOP_ORIGIN */
+void flexop_mark(FLEXOP_KEY *o, FLEXOP_SOURCE src, const char *file, int pos);
+
+/* images, see FLEXOP_IMAGE_HEADER. flexop_image_build writes the image of
+ * all options, or of those set by options file 'file', to b.
+ * flexop_image_load checks an image and applies it, if 'map' is set,
+ * vectors point into the image which must stay valid until
+ * flexop_image_release. With 'file', the entries are options set by that
+ * file instead of keeping the origins in the image. Returns 1 on success,
+ * otherwise 0 with the reason in msg, nothing is changed then. */
+uint64_t flexop_hash(const void *p, size_t n, uint64_t h);
+uint64_t flexop_image_schema(void);
+void flexop_image_build(FLEXOP_BUF *b, const char *file);
+int flexop_image_load(const void *base, size_t size, int map, const char *file, char *msg, size_t n);
+void flexop_image_release(void);
+
+/* loads binary options file 'fn' mapped, exits if it is invalid. Returns 0
+ * if 'fn' is not a binary options file. */
+int flexop_image_options_file(const char *fn);
+
+/* cache of options files: flexop_cache_load applies the cached result of
+ * parsing file 'fn' with content 'text' if it is valid, and sets key for
+ * flexop_cache_save, which stores the options set by 'file' after parsing */
+typedef struct FLEXOP_CACHE_KEY_
+{
+    char magic[8];          /* "FLEXOPCC" */
+    uint64_t size;          /* size of the options file */
+    int64_t mtime;          /* modification time of the options file */
+    uint64_t hash;          /* content of the options file */
+    uint64_t schema;        /* flexop_image_schema */
+    uint64_t reserved[3];
+
+} FLEXOP_CACHE_KEY;
+
+int flexop_cache_load(const char *fn, const char *text, size_t size, FLEXOP_CACHE_KEY *key);
+void flexop_cache_save(const char *file, const FLEXOP_CACHE_KEY *key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
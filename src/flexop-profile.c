@@ -0,0 +1,428 @@
+
+#include "flexop-priv.h"
+
+/* an option set by a profile, its value is parsed once when the profile is
+ * resolved */
+typedef struct FLEXOP_PROFILE_SET_
+{
+    int key;            /* position of the option in the registry */
+    int pos;            /* index of the option in the profile */
+
+    union {
+        int b;          /* booleans and keywords */
+        FLEXOP_WIDE n;  /* room for a number of any width */
+        FLEXOP_SIZE s;
+        FLEXOP_DURATION d;
+    } v;                /* scalars, numbers with the width of the option */
+    size_t size;        /* bytes of v */
+
+    char *str;          /* strings and arguments of handlers */
+    FLEXOP_VEC vec;     /* vectors */
+
+} FLEXOP_PROFILE_SET;
+
+typedef struct FLEXOP_PROFILE_
+{
+    char *name;
+    char *text;         /* as registered, for help */
+    const char *file;   /* interned name, FLEXOP_ORIGIN.file */
+
+    char **argv;        /* tokens */
+    int argc;
+    int alloc;
+
+    FLEXOP_PROFILE_SET *sets;
+    int nsets;
+    int resolved;       /* 1: sets are valid, -1: invalid profile */
+
+} FLEXOP_PROFILE;
+
+static FLEXOP_PROFILE *flexop_profiles = NULL;
+static int flexop_nprofiles = 0;
+
+static FLEXOP_PROFILE * flexop_profile_find(const char *name, size_t len)
+{
+    int i;
+
+    for (i = 0; i < flexop_nprofiles; i++) {
+        if (strlen(flexop_profiles[i].name) == len && !strncmp(flexop_profiles[i].name, name, len)) {
+            return flexop_profiles + i;
+        }
+    }
+
+    return NULL;
+}
+
+/* parses the value 'arg' of 'o', which has been checked */
+static void flexop_profile_value(FLEXOP_KEY *o, FLEXOP_PROFILE_SET *set, const char *arg)
+{
+    FLEXOP_VEC *v;
+    char *ta, *ip;
+    union {
+        FLEXOP_WIDE x;
+        FLEXOP_SIZE s;
+        FLEXOP_DURATION d;
+    } tp;
+
+    switch (o->type) {
+        case VT_INT:
+        case VT_UINT:
+        case VT_FLOAT:
+            flexop_atowide(arg, o->width, &tp.x);
+            flexop_store_wide(&set->v, o->width, &tp.x);
+            set->size = flexop_width_size(o->width);
+            break;
+
+        case VT_SIZE:
+            set->v.s = flexop_atosize(arg);
+            set->size = sizeof(set->v.s);
+            break;
+
+        case VT_DURATION:
+            set->v.d = flexop_atoduration(arg);
+            set->size = sizeof(set->v.d);
+            break;
+
+        case VT_KEYWORD:
+            set->v.b = flexop_keyword_index(o, arg);
+            set->size = sizeof(set->v.b);
+            break;
+
+        case VT_VEC_INT:
+        case VT_VEC_UINT:
+        case VT_VEC_FLOAT:
+        case VT_VEC_STRING:
+        case VT_VEC_SIZE:
+        case VT_VEC_DURATION:
+            v = &set->vec;
+            flexop_vec_init(v, ((FLEXOP_VEC *)o->var)->type, -1, o->name);
+            if (o->width != v->width) flexop_vec_set_width(v, o->width);
+
+            ta = strdup(arg);
+            for (ip = strtok(ta, " \t"); ip != NULL; ip = strtok(NULL, " \t")) {
+                switch (v->type) {
+                    case VT_INT:
+                    case VT_UINT:
+                    case VT_FLOAT:
+                        flexop_atowide(ip, v->width, &tp.x);
+                        flexop_vec_add_wide(v, &tp.x);
+                        continue;
+
+                    case VT_SIZE:
+                        tp.s = flexop_atosize(ip);
+                        break;
+
+                    case VT_DURATION:
+                        tp.d = flexop_atoduration(ip);
+                        break;
+
+                    default:
+                        break;
+                }
+
+                flexop_vec_add_entry(v, v->type == VT_STRING ? (void *)ip : (void *)&tp);
+            }
+
+            free(ta);
+            break;
+
+        default:
+            /* strings and handlers */
+            set->str = strdup(arg);
+            break;
+    }
+}
+
+/* the sets of profile p from its tokens, returns 0 with the reason in msg
+ * if they are not valid options */
+static int flexop_profile_resolve(FLEXOP_PROFILE *p, char *msg, size_t n)
+{
+    FLEXOP_PROFILE_SET *set;
+    FLEXOP_KEY *o;
+    char *t, *q, *arg, cmsg[256];
+    int i, m, ok = 1;
+
+    if (p->resolved) return p->resolved > 0;
+
+    p->sets = flexop_malloc((p->argc + 1) * sizeof(*p->sets));
+    memset(p->sets, 0, (p->argc + 1) * sizeof(*p->sets));
+    p->file = flexop_intern_file(p->name);
+
+    for (i = 0; ok && i < p->argc; i++) {
+        t = p->argv[i];
+
+        if (t[0] != '-' && t[0] != '+') {
+            snprintf(msg, n, "unexpected argument \"%s\"", t);
+            ok = 0;
+            break;
+        }
+
+        q = strdup(t[0] == '-' && t[1] == '-' ? t + 2 : t + 1);
+        if ((arg = strchr(q, '=')) != NULL) *(arg++) = '\0';
+
+        o = flexop_match(q, &m);
+        set = p->sets + p->nsets;
+        set->pos = i;
+
+        if (o == NULL) {
+            snprintf(msg, n, "%s option \"%s\"", m > 1 ? "ambiguous" : "unknown", t);
+            ok = 0;
+        }
+        else if (o->type == VT_HANDLER && o->var == (void *)flexop_profile_handler) {
+            snprintf(msg, n, "profiles cannot contain \"-%s\"", o->name);
+            ok = 0;
+        }
+        else if (o->type == VT_BOOL) {
+            set->v.b = t[0] == '-';
+            set->size = sizeof(set->v.b);
+        }
+        else if (arg == NULL && (arg = p->argv[++i]) == NULL) {
+            snprintf(msg, n, "missing argument for option \"-%s\"", o->name);
+            ok = 0;
+        }
+        else if (!flexop_check_arg(o, arg)) {
+            snprintf(msg, n, "invalid argument \"%s\" for option \"-%s\"", arg, o->name);
+            ok = 0;
+        }
+        else if (!flexop_constraint_check_arg(o, arg, cmsg, sizeof(cmsg))) {
+            snprintf(msg, n, "invalid value for option \"-%s\": %s", o->name, cmsg);
+            ok = 0;
+        }
+        else {
+            flexop_profile_value(o, set, arg);
+        }
+
+        if (ok) {
+            set->key = o - flexop_registry()->options;
+            p->nsets++;
+        }
+
+        flexop_free(q);
+    }
+
+    p->resolved = ok ? 1 : -1;
+
+    return ok;
+}
+
+static void flexop_profile_apply(FLEXOP_PROFILE *p)
+{
+    FLEXOP_PROFILE_SET *set;
+    FLEXOP_KEY *o;
+    FLEXOP_VEC *v;
+    char **argv;
+    int i, j;
+
+    for (i = 0; i < p->nsets; i++) {
+        set = p->sets + i;
+        o = flexop_registry()->options + set->key;
+
+        switch (o->type) {
+            case VT_STRING:
+                if (o->used) flexop_free(*(char **)o->var);
+
+                *(char **)o->var = strdup(set->str);
+                break;
+
+            case VT_HANDLER:
+                /* the handler parses its argument itself */
+                argv = p->argv + set->pos;
+                flexop_parse_cmdline_from(strchr(argv[0], '=') != NULL ? 1 : 2, &argv, FLEXOP_SRC_PROFILE,
+                        p->file, NULL, set->pos);
+                continue;
+
+            case VT_VEC_INT:
+            case VT_VEC_UINT:
+            case VT_VEC_FLOAT:
+            case VT_VEC_STRING:
+            case VT_VEC_SIZE:
+            case VT_VEC_DURATION:
+                v = o->var;
+
+                flexop_vec_destroy(v);
+                flexop_vec_init(v, set->vec.type, -1, o->name);
+                if (o->width != v->width) flexop_vec_set_width(v, o->width);
+
+                if (set->vec.size == 0) break;
+
+                if (v->type == VT_STRING) {
+                    for (j = 0; j < set->vec.size; j++) {
+                        flexop_vec_add_entry(v, ((char **)set->vec.d)[j]);
+                    }
+                }
+                else {
+                    v->d = flexop_malloc(set->vec.size * v->tsize);
+                    memcpy(v->d, set->vec.d, set->vec.size * v->tsize);
+                    v->size = v->alloc = set->vec.size;
+                }
+
+                break;
+
+            default:
+                memcpy(o->var, &set->v, set->size);
+                break;
+        }
+
+        o->used = 1;
+        flexop_mark(o, FLEXOP_SRC_PROFILE, p->file, set->pos);
+    }
+}
+
+static void flexop_profile_destroy(FLEXOP_PROFILE *p)
+{
+    FLEXOP_PROFILE_SET *set;
+    int i;
+
+    for (i = 0; i < p->nsets; i++) {
+        set = p->sets + i;
+
+        flexop_free(set->str);
+        if (flexop_vec_initialized(&set->vec)) flexop_vec_destroy(&set->vec);
+    }
+
+    for (i = 0; i < p->argc; i++) free(p->argv[i]);
+
+    flexop_free(p->argv);
+    flexop_free(p->sets);
+    flexop_free(p->name);
+    flexop_free(p->text);
+}
+
+void flexop_profile_free(void)
+{
+    int i;
+
+    for (i = 0; i < flexop_nprofiles; i++) flexop_profile_destroy(flexop_profiles + i);
+
+    flexop_free(flexop_profiles);
+    flexop_profiles = NULL;
+    flexop_nprofiles = 0;
+}
+
+void flexop_register_profile(const char *name, const char *optstr)
+{
+    FLEXOP_PROFILE p, *old;
+    char msg[512];
+
+    assert(name != NULL && optstr != NULL);
+
+    if (name[0] == '\0' || strchr(name, ',') != NULL) {
+        flexop_warning("flexop: invalid profile name \"%s\", profile not registered.\n", name);
+        return;
+    }
+
+    /* built aside, a profile being replaced stays valid if this one is not */
+    memset(&p, 0, sizeof(p));
+    p.name = strdup(name);
+    p.text = strdup(optstr);
+
+    if (!flexop_split_options(&p.argc, &p.argv, &p.alloc, optstr)) {
+        snprintf(msg, sizeof(msg), "unbalanced quotes");
+    }
+    /* all options are registered already */
+    else if (!flexop_registry()->initialized || flexop_profile_resolve(&p, msg, sizeof(msg))) {
+        if ((old = flexop_profile_find(name, strlen(name))) != NULL) {
+            flexop_warning("flexop: duplicate profile \"%s\", the previous one is replaced.\n", name);
+            flexop_profile_destroy(old);
+            *old = p;
+        }
+        else {
+            flexop_profiles = flexop_realloc(flexop_profiles, (flexop_nprofiles + 1) * sizeof(*flexop_profiles));
+            flexop_profiles[flexop_nprofiles++] = p;
+        }
+
+        return;
+    }
+
+    flexop_warning("flexop: invalid profile \"%s\": %s, profile not registered.\n", name, msg);
+    flexop_profile_destroy(&p);
+}
+
+void flexop_profile_resolve_all(void)
+{
+    char msg[512];
+    int i;
+
+    for (i = 0; i < flexop_nprofiles; i++) {
+        if (!flexop_profile_resolve(flexop_profiles + i, msg, sizeof(msg))) {
+            flexop_error(1, "flexop: invalid profile \"%s\": %s.\n", flexop_profiles[i].name, msg);
+        }
+    }
+}
+
+int flexop_profile_check(const char *arg)
+{
+    FLEXOP_PROFILE *p;
+    const char *e;
+    char msg[512];
+
+    for (; ; arg = e + 1) {
+        if ((e = strchr(arg, ',')) == NULL) e = arg + strlen(arg);
+
+        if ((p = flexop_profile_find(arg, e - arg)) == NULL) {
+            flexop_warning("flexop: unknown profile \"%.*s\".\n", (int)(e - arg), arg);
+            return 0;
+        }
+
+        /* profiles are resolved by flexop_init, or here if flexop_attach
+         * or flexop_unpack replaced it */
+        if (!flexop_profile_resolve(p, msg, sizeof(msg))) {
+            flexop_warning("flexop: invalid profile \"%s\": %s.\n", p->name, msg);
+            return 0;
+        }
+
+        if (*e == '\0') return 1;
+    }
+}
+
+FLEXOP_KEY ** flexop_profile_keys(const char *arg, int *n)
+{
+    FLEXOP_PROFILE *p;
+    FLEXOP_KEY **keys = NULL;
+    const char *e;
+    char msg[512];
+    int i;
+
+    *n = 0;
+
+    for (; ; arg = e + 1) {
+        if ((e = strchr(arg, ',')) == NULL) e = arg + strlen(arg);
+
+        p = flexop_profile_find(arg, e - arg);
+
+        if (p != NULL && flexop_profile_resolve(p, msg, sizeof(msg)) && p->nsets > 0) {
+            keys = flexop_realloc(keys, (*n + p->nsets) * sizeof(*keys));
+            for (i = 0; i < p->nsets; i++) keys[(*n)++] = flexop_registry()->options + p->sets[i].key;
+        }
+
+        if (*e == '\0') return keys;
+    }
+}
+
+int flexop_profile_handler(FLEXOP_KEY *o, const char *arg)
+{
+    const char *e;
+    int i;
+
+    (void)o;
+
+    if (arg == NULL) {
+        flexop_printf("Profiles:\n");
+        for (i = 0; i < flexop_nprofiles; i++) {
+            flexop_printf("  %s: %s\n", flexop_profiles[i].name, flexop_profiles[i].text);
+        }
+
+        return 0;
+    }
+
+    /* nothing is applied if a profile is invalid */
+    if (!flexop_profile_check(arg)) return 0;
+
+    for (; ; arg = e + 1) {
+        if ((e = strchr(arg, ',')) == NULL) e = arg + strlen(arg);
+
+        flexop_profile_apply(flexop_profile_find(arg, e - arg));
+
+        if (*e == '\0') return 1;
+    }
+}
@@ -0,0 +1,310 @@
+
+#include "flexop-buf.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+#if FLEXOP_USE_CONTROL
+#include <pthread.h>
+#endif
+
+/* pending output of a thread longer than this is passed on without a newline */
+#define FLEXOP_SINK_MAX_LINE        65536
+
+typedef enum
+{
+    FLEXOP_SINK_STDOUT,
+    FLEXOP_SINK_FUNC,
+    FLEXOP_SINK_FD,
+    FLEXOP_SINK_BUFFER,
+
+} FLEXOP_SINK_TYPE;
+
+static struct
+{
+    FLEXOP_SINK_TYPE type;
+    FLEXOP_SINK func;
+    void *data;
+    int fd;
+    FLEXOP_BUF *buf;
+    FLEXOP_LEVEL level;     /* lowest level passed on */
+
+} flexop_sink = {FLEXOP_SINK_STDOUT, NULL, NULL, -1, NULL, FLEXOP_LEVEL_INFO};
+
+static void flexop_sink_exit(void);
+
+#if FLEXOP_USE_CONTROL
+
+/* the sink is called by one thread at a time */
+static pthread_mutex_t flexop_sink_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t flexop_sink_once = PTHREAD_ONCE_INIT;
+static pthread_key_t flexop_sink_key;
+static pthread_key_t flexop_sink_busy_key;  /* set while the thread calls the sink */
+
+static void flexop_sink_thread_exit(void *p);
+
+static void flexop_sink_key_create(void)
+{
+    pthread_key_create(&flexop_sink_key, flexop_sink_thread_exit);
+    pthread_key_create(&flexop_sink_busy_key, NULL);
+    atexit(flexop_sink_exit);
+}
+
+/* the calling thread is in the sink, which prints through the library */
+static int flexop_sink_busy(void)
+{
+    pthread_once(&flexop_sink_once, flexop_sink_key_create);
+
+    return pthread_getspecific(flexop_sink_busy_key) != NULL;
+}
+
+static void flexop_sink_set_busy(int busy)
+{
+    pthread_setspecific(flexop_sink_busy_key, busy ? &flexop_sink : NULL);
+}
+
+/* the pending output of the calling thread */
+static FLEXOP_BUF * flexop_sink_pending(void)
+{
+    FLEXOP_BUF *b;
+
+    pthread_once(&flexop_sink_once, flexop_sink_key_create);
+
+    if ((b = pthread_getspecific(flexop_sink_key)) == NULL) {
+        b = flexop_malloc(sizeof(*b));
+        flexop_buf_init(b);
+
+        pthread_setspecific(flexop_sink_key, b);
+    }
+
+    return b;
+}
+
+#define flexop_sink_acquire()   pthread_mutex_lock(&flexop_sink_lock)
+#define flexop_sink_release()   pthread_mutex_unlock(&flexop_sink_lock)
+
+#else
+
+static FLEXOP_BUF flexop_sink_buf;
+static int flexop_sink_busy_flag = 0;
+
+static int flexop_sink_busy(void)
+{
+    return flexop_sink_busy_flag;
+}
+
+static void flexop_sink_set_busy(int busy)
+{
+    flexop_sink_busy_flag = busy;
+}
+
+static FLEXOP_BUF * flexop_sink_pending(void)
+{
+    static int registered = 0;
+
+    if (!registered) {
+        registered = 1;
+        atexit(flexop_sink_exit);
+    }
+
+    return &flexop_sink_buf;
+}
+
+#define flexop_sink_acquire()
+#define flexop_sink_release()
+
+#endif
+
+/* passes n bytes on to the sink */
+static void flexop_sink_deliver(FLEXOP_LEVEL level, const char *s, size_t n)
+{
+    ssize_t r;
+
+    if (n == 0) return;
+
+    flexop_sink_acquire();
+
+    switch (flexop_sink.type) {
+        case FLEXOP_SINK_STDOUT:
+            fwrite(s, 1, n, stdout);
+            break;
+
+        case FLEXOP_SINK_FUNC:
+            flexop_sink_set_busy(1);
+            flexop_sink.func(level, s, n, flexop_sink.data);
+            flexop_sink_set_busy(0);
+            break;
+
+        case FLEXOP_SINK_FD:
+            while (n > 0) {
+                if ((r = write(flexop_sink.fd, s, n)) < 0) {
+                    if (errno == EINTR) continue;
+                    break;
+                }
+
+                s += r;
+                n -= r;
+            }
+
+            break;
+
+        case FLEXOP_SINK_BUFFER:
+            flexop_buf_append(flexop_sink.buf, s, n);
+            break;
+    }
+
+    flexop_sink_release();
+}
+
+/* passes on the complete lines of b, everything if 'all' */
+static void flexop_sink_lines(FLEXOP_BUF *b, int all)
+{
+    size_t n = b->size;
+
+    if (!all && n < FLEXOP_SINK_MAX_LINE) {
+        while (n > 0 && b->d[n - 1] != '\n') n--;
+    }
+
+    if (n == 0) return;
+
+    flexop_sink_deliver(FLEXOP_LEVEL_INFO, b->d, n);
+
+    b->size -= n;
+    memmove(b->d, b->d + n, b->size);
+    b->d[b->size] = '\0';
+}
+
+static void flexop_sink_exit(void)
+{
+    flexop_sink_flush();
+}
+
+#if FLEXOP_USE_CONTROL
+static void flexop_sink_thread_exit(void *p)
+{
+    flexop_sink_lines(p, 1);
+    flexop_buf_destroy(p);
+    flexop_free(p);
+}
+#endif
+
+/* the sink is changed once the output of the calling thread is passed on */
+static void flexop_sink_set(FLEXOP_SINK_TYPE type, FLEXOP_SINK func, void *data, int fd, FLEXOP_BUF *b)
+{
+    flexop_sink_flush();
+
+    flexop_sink_acquire();
+
+    flexop_sink.type = type;
+    flexop_sink.func = func;
+    flexop_sink.data = data;
+    flexop_sink.fd = fd;
+    flexop_sink.buf = b;
+
+    flexop_sink_release();
+}
+
+void flexop_set_sink(FLEXOP_SINK func, void *data)
+{
+    flexop_sink_set(func == NULL ? FLEXOP_SINK_STDOUT : FLEXOP_SINK_FUNC, func, data, -1, NULL);
+}
+
+void flexop_set_sink_fd(int fd)
+{
+    assert(fd >= 0);
+
+    flexop_sink_set(FLEXOP_SINK_FD, NULL, NULL, fd, NULL);
+}
+
+void flexop_set_sink_buffer(FLEXOP_BUF *b)
+{
+    assert(b != NULL);
+
+    flexop_sink_set(FLEXOP_SINK_BUFFER, NULL, NULL, -1, b);
+}
+
+void flexop_set_sink_level(FLEXOP_LEVEL level)
+{
+    flexop_sink.level = level;
+}
+
+void flexop_sink_flush(void)
+{
+    /* the pending output is being passed on */
+    if (flexop_sink_busy()) return;
+
+    flexop_sink_lines(flexop_sink_pending(), 1);
+}
+
+void flexop_sink_write(FLEXOP_LEVEL level, const char *s, size_t n)
+{
+    FLEXOP_BUF *b;
+
+    if (level < flexop_sink.level || n == 0) return;
+
+    /* from the sink itself, which holds the lock: not passed on again */
+    if (flexop_sink_busy()) {
+        fwrite(s, 1, n, stdout);
+        return;
+    }
+
+    b = flexop_sink_pending();
+
+    /* after the pending output of the thread */
+    if (level != FLEXOP_LEVEL_INFO) {
+        flexop_sink_lines(b, 1);
+        flexop_sink_deliver(level, s, n);
+        return;
+    }
+
+    /* complete lines, e.g. the help, without a copy */
+    if (b->size == 0 && s[n - 1] == '\n') {
+        flexop_sink_deliver(level, s, n);
+        return;
+    }
+
+    flexop_buf_append(b, s, n);
+    flexop_sink_lines(b, 0);
+}
+
+int flexop_sink_vprintf(FLEXOP_LEVEL level, const char *fmt, va_list ap)
+{
+    FLEXOP_BUF *b;
+    va_list aq;
+    char s[4096], *p;
+    size_t size;
+    int n;
+
+    if (level < flexop_sink.level) return 0;
+
+    if (flexop_sink_busy()) return vfprintf(stdout, fmt, ap);
+
+    if (level == FLEXOP_LEVEL_INFO) {
+        b = flexop_sink_pending();
+        size = b->size;
+
+        flexop_buf_vprintf(b, fmt, ap);
+        n = b->size - size;
+        flexop_sink_lines(b, 0);
+
+        return n;
+    }
+
+    /* messages are formatted on the stack, errors may be about memory */
+    va_copy(aq, ap);
+    n = vsnprintf(s, sizeof(s), fmt, aq);
+    va_end(aq);
+
+    if (n < 0) return n;
+
+    if (n < (int)sizeof(s) || (p = malloc(n + 1)) == NULL) {
+        flexop_sink_write(level, s, n < (int)sizeof(s) ? (size_t)n : sizeof(s) - 1);
+        return n;
+    }
+
+    vsnprintf(p, n + 1, fmt, ap);
+    flexop_sink_write(level, p, n);
+    free(p);
+
+    return n;
+}
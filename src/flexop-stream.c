@@ -0,0 +1,160 @@
+
+#include "flexop-priv.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* bytes read at once */
+#define FLEXOP_STREAM_CHUNK         65536
+
+/* the stream being read, arguments of options files are shared */
+static FLEXOP_STREAM *flexop_stream_cur = NULL;
+
+static FLEXOP_STREAM * flexop_stream_new(int fd, const char *name)
+{
+    FLEXOP_STREAM *s;
+
+    if (flexop_stream_cur != NULL) {
+        flexop_warning("flexop: options stream \"%s\" is open already.\n", flexop_stream_cur->file);
+        return NULL;
+    }
+
+    s = flexop_malloc(sizeof(*s));
+    memset(s, 0, sizeof(*s));
+
+    s->fd = fd;
+    s->file = flexop_intern_file(name == NULL ? "stdin" : name);
+    s->first = flexop_registry()->argcf;
+
+    flexop_stream_cur = s;
+
+    return s;
+}
+
+FLEXOP_STREAM * flexop_stream_open(int fd, const char *name)
+{
+    if (!flexop_registry()->initialized) flexop_error(1, "flexop_stream_open must be called after flexop_init!\n");
+
+    return flexop_stream_new(fd, name);
+}
+
+/* applies the complete lines in the buffer, returns their number */
+static int flexop_stream_lines(FLEXOP_STREAM *s)
+{
+    char *p, *e;
+    int n = 0;
+
+    for (p = s->buf; (e = memchr(p, '\n', s->buf + s->size - p)) != NULL; p = e + 1) {
+        *e = '\0';
+        flexop_stream_line(p, s->file, ++s->line, &s->first, 0);
+        n++;
+    }
+
+    s->size -= p - s->buf;
+    memmove(s->buf, p, s->size);
+
+    return n;
+}
+
+int flexop_stream_read(FLEXOP_STREAM *s, int wait)
+{
+    struct pollfd pfd;
+    ssize_t r;
+    int n = 0;
+
+    assert(s != NULL);
+
+    if (s->eof) return 0;
+
+    pfd.fd = s->fd;
+    pfd.events = POLLIN;
+
+    while (1) {
+        /* only what has arrived, once a line has been applied */
+        if ((!wait || n > 0) && poll(&pfd, 1, 0) <= 0) return 1;
+
+        if (s->alloc - s->size < FLEXOP_STREAM_CHUNK) {
+            s->alloc = s->size + FLEXOP_STREAM_CHUNK + 1;
+            s->buf = flexop_realloc(s->buf, s->alloc);
+        }
+
+        if ((r = read(s->fd, s->buf + s->size, s->alloc - s->size - 1)) < 0) {
+            if (errno == EINTR) continue;
+
+            /* non-blocking descriptor */
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!wait || n > 0) return 1;
+
+                poll(&pfd, 1, -1);
+                continue;
+            }
+
+            flexop_error(1, "flexop: cannot read options file \"%s\": %s.\n", s->file, strerror(errno));
+        }
+
+        flexop_lock();
+
+        if (r == 0) {
+            /* the last line may have no newline */
+            s->buf[s->size] = '\0';
+            flexop_stream_line(s->size > 0 ? s->buf : NULL, s->file, ++s->line, &s->first, 1);
+            flexop_unlock();
+
+            s->size = 0;
+            s->eof = 1;
+            return 0;
+        }
+
+        s->size += r;
+        n += flexop_stream_lines(s);
+
+        flexop_unlock();
+    }
+}
+
+void flexop_stream_close(FLEXOP_STREAM *s)
+{
+    if (s == NULL) return;
+
+    if (flexop_stream_cur == s) flexop_stream_cur = NULL;
+
+    flexop_free(s->buf);
+    flexop_free(s);
+}
+
+int flexop_is_stream(const char *fn)
+{
+    struct stat st;
+
+    if (!strcmp(fn, "-")) return 1;
+
+    return stat(fn, &st) == 0 && !S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode);
+}
+
+int flexop_stream_options_file(const char *fn)
+{
+    FLEXOP_STREAM *s;
+    int fd, in;
+
+    if (!flexop_is_stream(fn)) return 0;
+
+    if ((in = !strcmp(fn, "-"))) {
+        fd = 0;
+    }
+    else if ((fd = open(fn, O_RDONLY)) < 0) {
+        flexop_printf("flexop: cannot open options file \"%s\".\n", fn);
+        exit(1);
+    }
+
+    if ((s = flexop_stream_new(fd, in ? NULL : fn)) == NULL) exit(1);
+
+    while (flexop_stream_read(s, 1));
+
+    flexop_stream_close(s);
+    if (!in) close(fd);
+
+    return 1;
+}
@@ -8,9 +8,9 @@ void flexop_warning(const char *fmt, ...)
     va_list ap;
     char s[1024];
 
-    sprintf(s, "*** WARNING: %s", fmt);
+    snprintf(s, sizeof(s), "*** WARNING: %s", fmt);
     va_start(ap, fmt);
-    vprintf(s, ap);
+    flexop_sink_vprintf(FLEXOP_LEVEL_WARNING, s, ap);
     va_end(ap);
 }
 
@@ -19,9 +19,9 @@ void flexop_error(int code, const char *fmt, ...)
     va_list ap;
     char s[4096];
 
-    sprintf(s, "*** Error: %s", fmt);
+    snprintf(s, sizeof(s), "*** Error: %s", fmt);
     va_start(ap, fmt);
-    vprintf(s, ap);
+    flexop_sink_vprintf(FLEXOP_LEVEL_ERROR, s, ap);
     va_end(ap);
 
     if (code == 0) return;
@@ -31,17 +31,26 @@ void flexop_error(int code, const char *fmt, ...)
 int flexop_printf(const char *fmt, ...)
 {
     va_list ap;
-    int ret = 0;
+    int ret;
 
     if (!flexop_print) return 0;
 
     va_start(ap, fmt);
-    ret = vprintf(fmt, ap);
+    ret = flexop_sink_vprintf(FLEXOP_LEVEL_INFO, fmt, ap);
     va_end(ap);
 
     return ret;
 }
 
+/* writes n bytes, the output counterpart of flexop_printf for text which
+ * has been formatted already */
+void flexop_write(const char *s, size_t n)
+{
+    if (!flexop_print || n == 0) return;
+
+    flexop_sink_write(FLEXOP_LEVEL_INFO, s, n);
+}
+
 void * flexop_malloc(size_t size)
 {
     void *ptr = (size != 0) ? malloc(size) : NULL;
@@ -83,16 +92,10 @@ void flexop_free(void *ptr)
 
 FLEXOP_FLOAT flexop_atof(const char *ptr)
 {
-    double t;
-    char *end;
-
-#if FLEXOP_USE_LONG_DOUBLE
-    t = strtold(ptr, &end);
-#else
-    t = strtod(ptr, &end);
-#endif
+    FLEXOP_FLOAT t;
+    const char *end;
 
-    if (end == ptr || (*end != '\0' && isspace(*end) == 0)) {
+    if (!flexop_parse_float(ptr, &end, &t) || (*end != '\0' && isspace(*end) == 0)) {
         flexop_error(1, "flexop: ptr: \"%s\" is not a float number.\n", ptr);
     }
 
@@ -101,24 +104,16 @@ FLEXOP_FLOAT flexop_atof(const char *ptr)
 
 FLEXOP_INT flexop_atoi(const char *ptr)
 {
-#if FLEXOP_USE_LONG_LONG
-    long long t;
-#elif FLEXOP_USE_LONG
-    long t;
-#else
-    int t;
-#endif
-    char *end;
-
-#if FLEXOP_USE_LONG_LONG
-    t = strtoll(ptr, &end, 10);
-#elif FLEXOP_USE_LONG
-    t = strtol(ptr, &end, 10);
-#else
-    t = strtol(ptr, &end, 10);
-#endif
-
-    if (end == ptr || (*end != '\0' && isspace(*end) == 0)) {
+    FLEXOP_INT t = 0;
+    const char *end;
+    int ret;
+
+    ret = flexop_parse_int(ptr, &end, &t);
+
+    if (ret < 0) {
+        flexop_error(1, "flexop: ptr: \"%s\" is out of the range of integer.\n", ptr);
+    }
+    else if (ret == 0 || (*end != '\0' && isspace(*end) == 0)) {
         flexop_error(1, "flexop: ptr: \"%s\" is not an integer.\n", ptr);
     }
 
@@ -127,30 +122,75 @@ FLEXOP_INT flexop_atoi(const char *ptr)
 
 FLEXOP_UINT flexop_atou(const char *ptr)
 {
-#if FLEXOP_USE_LONG_LONG
-    unsigned long long t;
-#elif FLEXOP_USE_LONG
-    unsigned long t;
-#else
-    unsigned int t;
-#endif
-    char *end;
-
-#if FLEXOP_USE_LONG_LONG
-    t = strtoull(ptr, &end, 10);
-#elif FLEXOP_USE_LONG
-    t = strtoul(ptr, &end, 10);
-#else
-    t = strtoul(ptr, &end, 10);
-#endif
-
-    if (end == ptr || (*end != '\0' && isspace(*end) == 0)) {
+    FLEXOP_UINT t = 0;
+    const char *end;
+    int ret;
+
+    ret = flexop_parse_uint(ptr, &end, &t);
+
+    if (ret < 0) {
+        flexop_error(1, "flexop: ptr: \"%s\" is out of the range of unsigned integer.\n", ptr);
+    }
+    else if (ret == 0 || (*end != '\0' && isspace(*end) == 0)) {
         flexop_error(1, "flexop: ptr: \"%s\" is not an unsigned integer.\n", ptr);
     }
 
     return t;
 }
 
+FLEXOP_SIZE flexop_atosize(const char *ptr)
+{
+    FLEXOP_SIZE t = 0;
+    const char *end;
+    int ret;
+
+    ret = flexop_parse_size(ptr, &end, &t);
+
+    if (ret < 0) {
+        flexop_error(1, "flexop: ptr: \"%s\" is out of the range of size.\n", ptr);
+    }
+    else if (ret == 0 || (*end != '\0' && isspace(*end) == 0)) {
+        flexop_error(1, "flexop: ptr: \"%s\" is not a size.\n", ptr);
+    }
+
+    return t;
+}
+
+FLEXOP_DURATION flexop_atoduration(const char *ptr)
+{
+    FLEXOP_DURATION t = 0;
+    const char *end;
+    int ret;
+
+    ret = flexop_parse_duration(ptr, &end, &t);
+
+    if (ret < 0) {
+        flexop_error(1, "flexop: ptr: \"%s\" is out of the range of duration.\n", ptr);
+    }
+    else if (ret == 0 || (*end != '\0' && isspace(*end) == 0)) {
+        flexop_error(1, "flexop: ptr: \"%s\" is not a duration.\n", ptr);
+    }
+
+    return t;
+}
+
+void flexop_atowide(const char *ptr, FLEXOP_WIDTH w, FLEXOP_WIDE *x)
+{
+    static const char *what[] = {"an integer", "an unsigned integer", "a float number"};
+    const char *end;
+    int ret, k;
+
+    k = flexop_width_type(w) == VT_INT ? 0 : flexop_width_type(w) == VT_UINT ? 1 : 2;
+    ret = flexop_parse_wide(ptr, &end, w, x);
+
+    if (ret < 0) {
+        flexop_error(1, "flexop: ptr: \"%s\" is out of the range of %s.\n", ptr, flexop_width_name(w));
+    }
+    else if (ret == 0 || (*end != '\0' && isspace(*end) == 0)) {
+        flexop_error(1, "flexop: ptr: \"%s\" is not %s.\n", ptr, what[k]);
+    }
+}
+
 void flexop_set_print_mark(int m)
 {
     if (m) {
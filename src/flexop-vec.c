@@ -1,6 +1,12 @@
 
 #include "flexop-vec.h"
 
+/* vectors longer than this are summarized when printed */
+static FLEXOP_INT flexop_vec_print_limit = 256;
+
+/* number of leading and trailing entries in a summary */
+#define FLEXOP_VEC_SUMMARY_ITEMS    5
+
 int flexop_vec_initialized(FLEXOP_VEC *vec)
 {
     if (vec == NULL) return 0;
@@ -37,14 +43,38 @@ void flexop_vec_init(FLEXOP_VEC *vec, FLEXOP_VTYPE type, FLEXOP_INT tsize, const
     else if (type == VT_STRING) {
         vec->tsize = sizeof(char *);
     }
+    else if (type == VT_SIZE) {
+        vec->tsize = sizeof(FLEXOP_SIZE);
+    }
+    else if (type == VT_DURATION) {
+        vec->tsize = sizeof(FLEXOP_DURATION);
+    }
     else {
         vec->tsize = tsize;
         flexop_error(1, "flexop: data type is not supported yet.\n");
     }
 
+    vec->width = flexop_width_native(type);
     vec->magic = FLEXOP_VEC_MAGIC_NUMBER;
 }
 
+void flexop_vec_set_width(FLEXOP_VEC *vec, FLEXOP_WIDTH w)
+{
+    assert(vec != NULL);
+    assert(vec->size == 0 && !vec->mapped);
+
+    if (flexop_width_type(w) != vec->type) {
+        flexop_error(1, "flexop: vector \"%s\" cannot store %s.\n", vec->key, flexop_width_name(w));
+    }
+
+    flexop_free(vec->d);
+    vec->d = NULL;
+    vec->alloc = 0;
+
+    vec->width = w;
+    vec->tsize = flexop_width_size(w);
+}
+
 void flexop_vec_destroy(FLEXOP_VEC *vec)
 {
     FLEXOP_INT i;
@@ -57,41 +87,103 @@ void flexop_vec_destroy(FLEXOP_VEC *vec)
         }
     }
 
-    flexop_free(vec->d);
+    if (!vec->mapped) flexop_free(vec->d);
     free(vec->key);
     bzero(vec, sizeof(FLEXOP_VEC));
 }
 
-/* add entry */
-void flexop_vec_add_entry(FLEXOP_VEC *v, void *e)
+void flexop_vec_copy(FLEXOP_VEC *dst, FLEXOP_VEC *src)
 {
-    assert(v != NULL);
-    assert(e != NULL);
+    FLEXOP_INT i;
+
+    assert(dst != NULL && src != NULL);
+
+    *dst = *src;
+    dst->key = strdup(src->key);
+    dst->d = NULL;
+    dst->alloc = 0;
+    dst->mapped = 0;
+
+    if (src->size == 0) return;
+
+    dst->d = flexop_malloc(src->size * src->tsize);
+    dst->alloc = src->size;
+
+    if (src->type == VT_STRING) {
+        for (i = 0; i < src->size; i++) ((char **)dst->d)[i] = strdup(((char **)src->d)[i]);
+    }
+    else {
+        memcpy(dst->d, src->d, src->size * src->tsize);
+    }
+}
+
+/* room for one more element */
+static void flexop_vec_grow(FLEXOP_VEC *v)
+{
+    void *d;
+
+    /* the data of a mapped vector is read-only, copy it */
+    if (v->mapped) {
+        d = flexop_malloc((v->size + 16) * v->tsize);
+        memcpy(d, v->d, v->size * v->tsize);
+
+        v->d = d;
+        v->alloc = v->size + 16;
+        v->mapped = 0;
+    }
 
     if (v->size >= v->alloc) {
-        v->alloc += 16;
+        v->alloc = v->alloc < 16 ? 16 : v->alloc * 2;
 
         assert(v->tsize > 0);
         v->d = flexop_realloc(v->d, v->alloc * v->tsize);
     }
+}
 
-    if (v->type == VT_INT) {
-        ((FLEXOP_INT *)v->d)[v->size++] = *(FLEXOP_INT *)e;
-    }
-    else if (v->type == VT_UINT) {
-        ((FLEXOP_UINT *)v->d)[v->size++] = *(FLEXOP_UINT *)e;
-    }
-    else if (v->type == VT_FLOAT) {
-        ((FLEXOP_FLOAT *)v->d)[v->size++] = *(FLEXOP_FLOAT *)e;
+/* add entry */
+void flexop_vec_add_entry(FLEXOP_VEC *v, void *e)
+{
+    assert(v != NULL);
+    assert(e != NULL);
+
+    flexop_vec_grow(v);
+
+    if (v->type == VT_INT || v->type == VT_UINT || v->type == VT_FLOAT) {
+        if (!flexop_store((char *)v->d + v->size * v->tsize, v->width, e)) {
+            flexop_error(1, "flexop: value out of the range of %s for \"%s\".\n", flexop_width_name(v->width),
+                    v->key);
+        }
+
+        v->size++;
     }
     else if (v->type == VT_STRING) {
         ((char **)v->d)[v->size++] = strdup(e);
     }
+    else if (v->type == VT_SIZE) {
+        ((FLEXOP_SIZE *)v->d)[v->size++] = *(FLEXOP_SIZE *)e;
+    }
+    else if (v->type == VT_DURATION) {
+        ((FLEXOP_DURATION *)v->d)[v->size++] = *(FLEXOP_DURATION *)e;
+    }
     else {
         flexop_error(1, "flexop: data type is not supported yet.\n");
     }
 }
 
+void flexop_vec_add_wide(FLEXOP_VEC *v, const FLEXOP_WIDE *x)
+{
+    assert(v != NULL && x != NULL);
+    assert(flexop_width_type(v->width) == v->type);
+
+    flexop_vec_grow(v);
+
+    if (!flexop_store_wide((char *)v->d + v->size * v->tsize, v->width, x)) {
+        flexop_error(1, "flexop: value out of the range of %s for \"%s\".\n", flexop_width_name(v->width), v->key);
+    }
+
+    v->size++;
+}
+
 /* get value */
 FLEXOP_INT flexop_vec_get_size(FLEXOP_VEC *v)
 {
@@ -102,32 +194,64 @@ FLEXOP_INT flexop_vec_get_size(FLEXOP_VEC *v)
 
 FLEXOP_INT flexop_vec_int_get_value(FLEXOP_VEC *v, FLEXOP_INT n)
 {
+    FLEXOP_INT t;
+
     assert(v != NULL);
     assert(n >= 0);
     assert(n < v->size);
 
     assert(v->type == VT_INT);
-    return ((FLEXOP_INT *)v->d)[n];
+    flexop_load(&t, v->width, (char *)v->d + n * v->tsize);
+
+    return t;
 }
 
 FLEXOP_UINT flexop_vec_uint_get_value(FLEXOP_VEC *v, FLEXOP_INT n)
 {
+    FLEXOP_UINT t;
+
     assert(v != NULL);
     assert(n >= 0);
     assert(n < v->size);
 
     assert(v->type == VT_UINT);
-    return ((FLEXOP_UINT *)v->d)[n];
+    flexop_load(&t, v->width, (char *)v->d + n * v->tsize);
+
+    return t;
 }
 
 FLEXOP_FLOAT flexop_vec_float_get_value(FLEXOP_VEC *v, FLEXOP_INT n)
 {
+    FLEXOP_FLOAT t;
+
     assert(v != NULL);
     assert(n >= 0);
     assert(n < v->size);
 
     assert(v->type == VT_FLOAT);
-    return ((FLEXOP_FLOAT *)v->d)[n];
+    flexop_load(&t, v->width, (char *)v->d + n * v->tsize);
+
+    return t;
+}
+
+FLEXOP_SIZE flexop_vec_size_get_value(FLEXOP_VEC *v, FLEXOP_INT n)
+{
+    assert(v != NULL);
+    assert(n >= 0);
+    assert(n < v->size);
+
+    assert(v->type == VT_SIZE);
+    return ((FLEXOP_SIZE *)v->d)[n];
+}
+
+FLEXOP_DURATION flexop_vec_duration_get_value(FLEXOP_VEC *v, FLEXOP_INT n)
+{
+    assert(v != NULL);
+    assert(n >= 0);
+    assert(n < v->size);
+
+    assert(v->type == VT_DURATION);
+    return ((FLEXOP_DURATION *)v->d)[n];
 }
 
 char * flexop_vec_string_get_value(FLEXOP_VEC *v, FLEXOP_INT n)
@@ -140,59 +264,239 @@ char * flexop_vec_string_get_value(FLEXOP_VEC *v, FLEXOP_INT n)
     return ((char **)v->d)[n];
 }
 
-void flexop_vec_print(FLEXOP_VEC *v)
+/* elements of a given width, see flexop_vec_set_width */
+#define FLEXOP_VEC_GET_WIDTH(S, T, W)                                                   \
+T flexop_vec_##S##_get_value(FLEXOP_VEC *v, FLEXOP_INT n)                               \
+{                                                                                       \
+    T t;                                                                                \
+                                                                                        \
+    assert(v != NULL);                                                                  \
+    assert(n >= 0);                                                                     \
+    assert(n < v->size);                                                                \
+                                                                                        \
+    assert(v->width == W);                                                              \
+    memcpy(&t, (char *)v->d + n * v->tsize, sizeof(t));                                 \
+                                                                                        \
+    return t;                                                                           \
+}
+
+FLEXOP_VEC_GET_WIDTH(int8, int8_t, FLEXOP_INT8)
+FLEXOP_VEC_GET_WIDTH(int16, int16_t, FLEXOP_INT16)
+FLEXOP_VEC_GET_WIDTH(int32, int32_t, FLEXOP_INT32)
+FLEXOP_VEC_GET_WIDTH(int64, int64_t, FLEXOP_INT64)
+FLEXOP_VEC_GET_WIDTH(uint8, uint8_t, FLEXOP_UINT8)
+FLEXOP_VEC_GET_WIDTH(uint16, uint16_t, FLEXOP_UINT16)
+FLEXOP_VEC_GET_WIDTH(uint32, uint32_t, FLEXOP_UINT32)
+FLEXOP_VEC_GET_WIDTH(uint64, uint64_t, FLEXOP_UINT64)
+FLEXOP_VEC_GET_WIDTH(float32, float, FLEXOP_FLOAT32)
+FLEXOP_VEC_GET_WIDTH(float64, double, FLEXOP_FLOAT64)
+FLEXOP_VEC_GET_WIDTH(long_double, long double, FLEXOP_LONG_DOUBLE)
+
+void flexop_vec_set_print_limit(FLEXOP_INT n)
 {
-    FLEXOP_INT i;
+    flexop_vec_print_limit = n < 0 ? 0 : n;
+}
+
+FLEXOP_INT flexop_vec_get_print_limit(void)
+{
+    return flexop_vec_print_limit;
+}
+
+static void flexop_vec_format_entry(FLEXOP_BUF *b, FLEXOP_VEC *v, FLEXOP_INT i, int quote)
+{
+    if (v->type == VT_INT || v->type == VT_UINT || v->type == VT_FLOAT) {
+        flexop_buf_put_number(b, v->width, (char *)v->d + i * v->tsize);
+    }
+    else if (v->type == VT_SIZE) {
+        flexop_buf_put_size(b, ((FLEXOP_SIZE *)v->d)[i]);
+    }
+    else if (v->type == VT_DURATION) {
+        flexop_buf_put_duration(b, ((FLEXOP_DURATION *)v->d)[i]);
+    }
+    else if (v->type == VT_STRING) {
+        if (quote) flexop_buf_putc(b, '"');
+        flexop_buf_puts(b, ((char **)v->d)[i]);
+        if (quote) flexop_buf_putc(b, '"');
+    }
+    else {
+        flexop_error(1, "flexop: data type is not supported yet.\n");
+    }
+}
+
+/* imin and imax of the elements of type T */
+#define FLEXOP_VEC_MINMAX(T)                                \
+    do {                                                    \
+        const T *p = v->d;                                  \
+                                                            \
+        for (i = 1; i < v->size; i++) {                     \
+            if (p[i] < p[imin]) imin = i;                   \
+            if (p[i] > p[imax]) imax = i;                   \
+        }                                                   \
+    } while (0)
+
+/* appends " (size: n, min: x, max: y)" */
+static void flexop_vec_format_summary(FLEXOP_BUF *b, FLEXOP_VEC *v)
+{
+    FLEXOP_INT i, imin = 0, imax = 0;
+
+    if (v->width != flexop_width_native(v->type)) {
+        switch (v->width) {
+            case FLEXOP_INT8:
+                FLEXOP_VEC_MINMAX(int8_t);
+                break;
+
+            case FLEXOP_INT16:
+                FLEXOP_VEC_MINMAX(int16_t);
+                break;
+
+            case FLEXOP_INT32:
+                FLEXOP_VEC_MINMAX(int32_t);
+                break;
+
+            case FLEXOP_INT64:
+                FLEXOP_VEC_MINMAX(int64_t);
+                break;
+
+            case FLEXOP_UINT8:
+                FLEXOP_VEC_MINMAX(uint8_t);
+                break;
+
+            case FLEXOP_UINT16:
+                FLEXOP_VEC_MINMAX(uint16_t);
+                break;
+
+            case FLEXOP_UINT32:
+                FLEXOP_VEC_MINMAX(uint32_t);
+                break;
+
+            case FLEXOP_UINT64:
+                FLEXOP_VEC_MINMAX(uint64_t);
+                break;
 
-    if (v->type == VT_INT) {
-        FLEXOP_INT *p;
+            case FLEXOP_FLOAT32:
+                FLEXOP_VEC_MINMAX(float);
+                break;
 
-        p = v->d;
-        flexop_printf("flexop: key: \"%s\", vector of int, size: %d, values:", v->key, v->size);
+            case FLEXOP_FLOAT64:
+                FLEXOP_VEC_MINMAX(double);
+                break;
 
-        for (i = 0; i < v->size; i++) {
-            flexop_printf(" %"IFMT, p[i]);
+            case FLEXOP_LONG_DOUBLE:
+                FLEXOP_VEC_MINMAX(long double);
+                break;
+
+            default:
+                break;
         }
+    }
+    else if (v->type == VT_INT) {
+        FLEXOP_INT *p = v->d;
 
-        flexop_printf("\n");
+        for (i = 1; i < v->size; i++) {
+            if (p[i] < p[imin]) imin = i;
+            if (p[i] > p[imax]) imax = i;
+        }
     }
     else if (v->type == VT_UINT) {
-        FLEXOP_UINT *p;
+        FLEXOP_UINT *p = v->d;
 
-        p = v->d;
-        flexop_printf("flexop: key: \"%s\", vector of int, size: %d, values:", v->key, v->size);
-
-        for (i = 0; i < v->size; i++) {
-            flexop_printf(" %"UFMT, p[i]);
+        for (i = 1; i < v->size; i++) {
+            if (p[i] < p[imin]) imin = i;
+            if (p[i] > p[imax]) imax = i;
         }
-
-        flexop_printf("\n");
     }
     else if (v->type == VT_FLOAT) {
-        FLEXOP_FLOAT *p;
+        FLEXOP_FLOAT *p = v->d;
 
-        p = v->d;
-        flexop_printf("flexop: key: \"%s\", vector of float, size: %d, values:", v->key, v->size);
+        for (i = 1; i < v->size; i++) {
+            if (p[i] < p[imin]) imin = i;
+            if (p[i] > p[imax]) imax = i;
+        }
+    }
+    else if (v->type == VT_SIZE || v->type == VT_DURATION) {
+        uint64_t *p = v->d;
 
-        for (i = 0; i < v->size; i++) {
-            flexop_printf(" %"FFMT, p[i]);
+        for (i = 1; i < v->size; i++) {
+            if (p[i] < p[imin]) imin = i;
+            if (p[i] > p[imax]) imax = i;
         }
+    }
+
+    flexop_buf_puts(b, " (size: ");
+    flexop_buf_put_int(b, v->size);
 
-        flexop_printf("\n");
+    if (v->type != VT_STRING) {
+        flexop_buf_puts(b, ", min: ");
+        flexop_vec_format_entry(b, v, imin, 0);
+        flexop_buf_puts(b, ", max: ");
+        flexop_vec_format_entry(b, v, imax, 0);
     }
-    else if (v->type == VT_STRING) {
-        char **p;
 
-        p = v->d;
-        flexop_printf("flexop: key: \"%s\", vector of string, size: %d, values:", v->key, v->size);
+    flexop_buf_putc(b, ')');
+}
+
+void flexop_vec_format(FLEXOP_BUF *b, FLEXOP_VEC *v, int flags)
+{
+    FLEXOP_INT i, head;
+    int summary;
+
+    assert(b != NULL && v != NULL);
+
+    summary = (flags & FLEXOP_VFMT_SUMMARY) && flexop_vec_print_limit > 0
+        && v->size > flexop_vec_print_limit;
+    head = summary ? FLEXOP_VEC_SUMMARY_ITEMS : v->size;
 
-        for (i = 0; i < v->size; i++) {
-            flexop_printf(" \"%s\"", p[i]);
+    for (i = 0; i < v->size; i++) {
+        if (i == head) {
+            flexop_buf_puts(b, " ...");
+            i = v->size - FLEXOP_VEC_SUMMARY_ITEMS;
         }
 
-        flexop_printf("\n");
+        if (i > 0) flexop_buf_putc(b, ' ');
+        flexop_vec_format_entry(b, v, i, flags & FLEXOP_VFMT_QUOTE);
+    }
+
+    if (summary) flexop_vec_format_summary(b, v);
+}
+
+void flexop_vec_print(FLEXOP_VEC *v)
+{
+    FLEXOP_BUF b;
+    const char *t;
+
+    if (v->width != flexop_width_native(v->type)) {
+        t = flexop_width_name(v->width);
+    }
+    else if (v->type == VT_INT) {
+        t = "int";
+    }
+    else if (v->type == VT_UINT) {
+        t = "unsigned int";
+    }
+    else if (v->type == VT_FLOAT) {
+        t = "float";
+    }
+    else if (v->type == VT_STRING) {
+        t = "string";
+    }
+    else if (v->type == VT_SIZE) {
+        t = "size";
+    }
+    else if (v->type == VT_DURATION) {
+        t = "duration";
     }
     else {
         flexop_error(1, "flexop: parsing module not implemented yet.\n");
+        return;
     }
+
+    flexop_buf_init(&b);
+    flexop_buf_printf(&b, "flexop: key: \"%s\", vector of %s, size: %"IFMT", values:", v->key, t, v->size);
+
+    if (v->size > 0) flexop_buf_putc(&b, ' ');
+    flexop_vec_format(&b, v, FLEXOP_VFMT_SUMMARY | FLEXOP_VFMT_QUOTE);
+
+    flexop_buf_putc(&b, '\n');
+    flexop_buf_flush(&b);
+    flexop_buf_destroy(&b);
 }
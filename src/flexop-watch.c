@@ -0,0 +1,700 @@
+
+#include "flexop-priv.h"
+
+#if FLEXOP_USE_CONTROL
+
+#include <pthread.h>
+#include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+/* bytes written to the wake pipe */
+#define FLEXOP_WATCH_STOP       'q'
+#define FLEXOP_WATCH_RELOAD     'r'
+
+/* a line of the options file, its tokens and the options they set are kept
+ * while it does not change */
+typedef struct FLEXOP_WATCH_LINE_
+{
+    uint64_t hash;
+    char *text;
+    char **argv;
+    int argc;
+    int alloc;
+    int line;           /* line number */
+    int taken;          /* reused by the next version of the file */
+    int borrowed;       /* tokens taken from the previous version */
+    int prev;           /* the line in the previous version if borrowed */
+
+    /* the options set from token 'from' on, by position in the registry,
+     * and their checked values (in argv); 'open' waits for its argument
+     * on the next line, -1 if none. Valid if 'resolved' and the registry
+     * still has nopts options. */
+    int *keys;
+    const char **args;
+    int nset;
+    int open;
+    const char *open_tok;
+    int from;
+    int resolved;
+    size_t nopts;
+
+} FLEXOP_WATCH_LINE;
+
+/* the options file as applied */
+typedef struct FLEXOP_WATCH_STATE_
+{
+    size_t size;
+    uint64_t hash;
+    FLEXOP_WATCH_LINE *lines;
+    int nlines;
+
+    /* value of each option (by position in the registry) as set by the
+     * file, NULL if not set, booleans are "-" or "+". Points into lines. */
+    const char **vals;
+    int *vline;
+
+} FLEXOP_WATCH_STATE;
+
+static struct
+{
+    int running;
+    int stop;           /* set before the last byte written to wake */
+    int wake[2];        /* stop or reload the thread, written by SIGHUP,
+                         * non-blocking */
+    int ino;            /* inotify, -1 if not available */
+    char *path;
+    const char *file;   /* interned path */
+    char *name;         /* basename of path, to filter inotify events */
+    pthread_t thread;
+    struct sigaction old_hup;
+
+    FLEXOP_WATCH_STATE cur;
+
+} flexop_wt;
+
+/* odd while a reload applies options */
+static volatile unsigned long flexop_gen = 0;
+
+unsigned long flexop_generation(void)
+{
+    return flexop_gen;
+}
+
+static void flexop_watch_free_line(FLEXOP_WATCH_LINE *l)
+{
+    int i;
+
+    for (i = 0; i < l->argc; i++) flexop_free(l->argv[i]);
+
+    flexop_free(l->argv);
+    flexop_free(l->text);
+    flexop_free(l->keys);
+    flexop_free(l->args);
+}
+
+static void flexop_watch_free_state(FLEXOP_WATCH_STATE *s, int all)
+{
+    int i;
+
+    for (i = 0; i < s->nlines; i++) {
+        if (all || (!s->lines[i].taken && !s->lines[i].borrowed)) flexop_watch_free_line(s->lines + i);
+    }
+
+    flexop_free(s->lines);
+    flexop_free(s->vals);
+    flexop_free(s->vline);
+
+    memset(s, 0, sizeof(*s));
+}
+
+/* first slot of a hash: the low bits of flexop_hash only mix the last
+ * bytes, fold the high ones in */
+#define FLEXOP_WATCH_SLOT(h, mask)  ((int)(((h) ^ ((h) >> 32) ^ ((h) >> 47)) & (uint64_t)(mask)))
+
+/* open addressing index of the lines of s by hash, *mask + 1 slots */
+static int * flexop_watch_index(FLEXOP_WATCH_STATE *s, int *mask)
+{
+    int *idx, i, j, n = 16;
+
+    while (n < 2 * s->nlines) n *= 2;
+
+    idx = flexop_malloc(n * sizeof(*idx));
+    for (i = 0; i < n; i++) idx[i] = -1;
+
+    for (i = 0; i < s->nlines; i++) {
+        for (j = FLEXOP_WATCH_SLOT(s->lines[i].hash, n - 1); idx[j] >= 0; j = (j + 1) & (n - 1));
+        idx[j] = i;
+    }
+
+    *mask = n - 1;
+    return idx;
+}
+
+/* the line of 'old' with the same text, not taken yet, or NULL */
+static FLEXOP_WATCH_LINE * flexop_watch_find(FLEXOP_WATCH_STATE *old, int *idx, int mask,
+        uint64_t hash, const char *text)
+{
+    FLEXOP_WATCH_LINE *l;
+    int j;
+
+    for (j = FLEXOP_WATCH_SLOT(hash, mask); idx[j] >= 0; j = (j + 1) & mask) {
+        l = old->lines + idx[j];
+        if (l->hash == hash && !l->taken && !strcmp(l->text, text)) return l;
+    }
+
+    return NULL;
+}
+
+/* splits 'text' (modified) into lines, the tokens of those which did not
+ * change are taken from 'old'. Returns 0 with the reason in msg on error. */
+static int flexop_watch_lines(FLEXOP_WATCH_STATE *s, FLEXOP_WATCH_STATE *old, char *text, size_t size,
+        char *msg, size_t n)
+{
+    FLEXOP_WATCH_LINE *l, *o;
+    char *p, *e;
+    int *idx = NULL, mask = 0, alloc = 0, line = 0, next = 0, ok = 1;
+
+    for (p = text; ok && p < text + size; p = e + 1) {
+        if ((e = memchr(p, '\n', text + size - p)) == NULL) e = text + size;
+        *e = '\0';
+        line++;
+
+        while (isspace(*p)) p++;
+        if (*p == '#' || *p == '\0') continue;
+
+        if (s->nlines == alloc) {
+            alloc = alloc < 16 ? 16 : alloc * 2;
+            s->lines = flexop_realloc(s->lines, alloc * sizeof(*s->lines));
+        }
+
+        l = s->lines + s->nlines++;
+        memset(l, 0, sizeof(*l));
+        l->hash = flexop_hash(p, e - p, 0);
+        l->line = line;
+
+        /* lines usually keep their order, look them up only if the one
+         * after the previous match differs */
+        o = next < old->nlines ? old->lines + next : NULL;
+
+        if (o == NULL || o->hash != l->hash || o->taken || strcmp(o->text, p)) {
+            if (idx == NULL) idx = flexop_watch_index(old, &mask);
+            o = flexop_watch_find(old, idx, mask, l->hash, p);
+        }
+
+        if (o != NULL) {
+            next = o - old->lines + 1;
+            *l = *o;
+            l->line = line;
+            l->taken = 0;
+            l->borrowed = 1;
+            l->prev = o - old->lines;
+            o->taken = 1;
+            continue;
+        }
+
+        l->text = strdup(p);
+
+        if (!flexop_split_options(&l->argc, &l->argv, &l->alloc, p)) {
+            snprintf(msg, n, "line %d: unbalanced quotes", line);
+            ok = 0;
+        }
+    }
+
+    flexop_free(idx);
+    return ok;
+}
+
+/* checks the argument 'arg' of option 'o', given as 'p' */
+static int flexop_watch_check(FLEXOP_KEY *o, const char *p, const char *arg, int line, char *msg, size_t n)
+{
+    char cmsg[128];
+
+    if (!flexop_check_arg(o, arg)) {
+        snprintf(msg, n, "line %d: invalid argument \"%s\" for option \"%s\"", line, arg, p);
+        return 0;
+    }
+
+    if (!flexop_constraint_check_arg(o, arg, cmsg, sizeof(cmsg))) {
+        snprintf(msg, n, "line %d: invalid value for option \"%s\": %s", line, p, cmsg);
+        return 0;
+    }
+
+    return 1;
+}
+
+/* the options set by the tokens of l from token 'from' on, the last one
+ * may take its argument from the next line. Returns 0 with the reason in
+ * msg if an option or its value is invalid. */
+static int flexop_watch_resolve(FLEXOP_WATCH_LINE *l, int from, char *msg, size_t n)
+{
+    FLEXOP *r = flexop_registry();
+    FLEXOP_KEY *o;
+    const char *arg;
+    char *p, *q;
+    int j, m;
+
+    /* those of a borrowed line belong to the previous version until the
+     * reload succeeds */
+    if (!l->borrowed) {
+        flexop_free(l->keys);
+        flexop_free(l->args);
+    }
+
+    l->keys = flexop_malloc((l->argc + 1) * sizeof(*l->keys));
+    l->args = flexop_malloc((l->argc + 1) * sizeof(*l->args));
+    l->nset = 0;
+    l->open = -1;
+    l->resolved = 0;
+
+    for (j = from; j < l->argc; j++) {
+        p = l->argv[j];
+
+        if (p[0] != '-' && p[0] != '+') {
+            snprintf(msg, n, "line %d: unexpected argument \"%s\"", l->line, p);
+            return 0;
+        }
+
+        q = strdup(p[0] == '-' && p[1] == '-' ? p + 2 : p + 1);
+        if ((arg = strchr(p + 1, '=')) != NULL) {
+            q[arg - p - 1] = '\0';
+            arg++;
+        }
+
+        o = flexop_match(q, &m);
+        flexop_free(q);
+
+        if (o == NULL) {
+            snprintf(msg, n, "line %d: %s option \"%s\"", l->line, m > 1 ? "ambiguous" : "unknown", p);
+            return 0;
+        }
+
+        if (o->type == VT_BOOL) {
+            arg = p[0] == '-' ? "-" : "+";
+        }
+        else if (arg == NULL && j + 1 == l->argc) {
+            l->open = o - r->options;
+            l->open_tok = p;
+            break;
+        }
+        else if (arg == NULL) {
+            arg = l->argv[++j];
+        }
+
+        if (!flexop_watch_check(o, p, arg, l->line, msg, n)) return 0;
+
+        l->keys[l->nset] = o - r->options;
+        l->args[l->nset++] = arg;
+    }
+
+    l->from = from;
+    l->nopts = r->size;
+    l->resolved = 1;
+
+    return 1;
+}
+
+/* the value of every option from the tokens of all lines, as the options
+ * file is parsed: the argument of an option may be on a following line,
+ * the last value wins. Lines which did not change keep their options, only
+ * the others are checked. Returns 0 with the reason in msg if an option or
+ * its value is invalid. */
+static int flexop_watch_values(FLEXOP_WATCH_STATE *s, char *msg, size_t n)
+{
+    FLEXOP *r = flexop_registry();
+    FLEXOP_WATCH_LINE *l;
+    const char *ptok = NULL;
+    int i, j, from, pending = -1, pline = 0;
+
+    s->vals = flexop_malloc((r->size + 1) * sizeof(*s->vals));
+    s->vline = flexop_malloc((r->size + 1) * sizeof(*s->vline));
+    for (i = 0; i < (int)r->size; i++) s->vals[i] = NULL;
+
+    for (i = 0; i < s->nlines; i++) {
+        l = s->lines + i;
+        from = 0;
+
+        if (l->argc == 0) continue;
+
+        /* the argument of the last option of a previous line */
+        if (pending >= 0) {
+            if (!flexop_watch_check(r->options + pending, ptok, l->argv[0], l->line, msg, n)) return 0;
+
+            s->vals[pending] = l->argv[0];
+            s->vline[pending] = pline;
+            pending = -1;
+            from = 1;
+        }
+
+        if (!l->resolved || l->from != from || l->nopts != r->size) {
+            if (!flexop_watch_resolve(l, from, msg, n)) return 0;
+        }
+
+        for (j = 0; j < l->nset; j++) {
+            s->vals[l->keys[j]] = l->args[j];
+            s->vline[l->keys[j]] = l->line;
+        }
+
+        if (l->open >= 0) {
+            pending = l->open;
+            ptok = l->open_tok;
+            pline = l->line;
+        }
+    }
+
+    if (pending >= 0) {
+        snprintf(msg, n, "line %d: missing argument for option \"%s\"", pline, ptok);
+        return 0;
+    }
+
+    return 1;
+}
+
+/* reads the options file and applies the options whose values changed,
+ * nothing is applied if 'apply' is not set. Returns -1 on error, otherwise
+ * whether options were applied. */
+static int flexop_watch_reload(int apply)
+{
+    FLEXOP *r = flexop_registry();
+    FLEXOP_WATCH_STATE s;
+    FLEXOP_WATCH_LINE *l, *o;
+    const char *v, *w;
+    char **argv, *text, msg[256];
+    int *lines, i, ok, argc = 0;
+    size_t size;
+    uint64_t h;
+
+    if ((text = flexop_read_file(flexop_wt.path, &size)) == NULL) {
+        flexop_warning("flexop: cannot read options file \"%s\".\n", flexop_wt.path);
+        return -1;
+    }
+
+    h = flexop_hash(text, size, 0);
+
+    if (apply && size == flexop_wt.cur.size && h == flexop_wt.cur.hash) {
+        flexop_free(text);
+        return 0;
+    }
+
+    memset(&s, 0, sizeof(s));
+    s.size = size;
+    s.hash = h;
+
+    flexop_lock();
+
+    ok = flexop_watch_lines(&s, &flexop_wt.cur, text, size, msg, sizeof(msg))
+        && flexop_watch_values(&s, msg, sizeof(msg));
+
+    flexop_free(text);
+
+    /* options set by the file whose values changed; an option which is not
+     * in the file any more keeps its value */
+    argv = flexop_malloc((2 * r->size + 1) * sizeof(*argv));
+    lines = flexop_malloc((2 * r->size + 1) * sizeof(*lines));
+
+    for (i = 0; ok && apply && i < (int)r->size; i++) {
+        if ((v = s.vals[i]) == NULL) continue;
+        if ((w = flexop_wt.cur.vals[i]) != NULL && !strcmp(v, w)) continue;
+
+        argv[argc] = flexop_malloc(strlen(r->options[i].name) + 2);
+        sprintf(argv[argc], "%c%s", r->options[i].type == VT_BOOL ? *v : '-', r->options[i].name);
+        lines[argc++] = s.vline[i];
+
+        if (r->options[i].type != VT_BOOL) {
+            argv[argc] = strdup(v);
+            lines[argc++] = s.vline[i];
+        }
+    }
+
+    argv[argc] = NULL;
+
+    /* a handler may still reject its argument, all options of the reload
+     * are restored then */
+    if (argc > 0) {
+        flexop_gen++;
+        __sync_synchronize();
+
+        ok = flexop_apply_options(argc, argv, FLEXOP_SRC_FILE, flexop_wt.file, lines, msg, sizeof(msg));
+
+        __sync_synchronize();
+        flexop_gen++;
+    }
+
+    /* borrowed lines which were resolved again have their own options,
+     * free those of the version which is dropped */
+    for (i = 0; i < s.nlines; i++) {
+        l = s.lines + i;
+        if (!l->borrowed) continue;
+
+        o = flexop_wt.cur.lines + l->prev;
+        if (l->keys == o->keys) continue;
+
+        if (ok) l = o;
+
+        flexop_free(l->keys);
+        flexop_free(l->args);
+        l->keys = NULL;
+        l->args = NULL;
+    }
+
+    if (ok) {
+        flexop_watch_free_state(&flexop_wt.cur, 0);
+        flexop_wt.cur = s;
+        for (i = 0; i < s.nlines; i++) flexop_wt.cur.lines[i].borrowed = 0;
+    }
+    else {
+        /* give the lines back */
+        for (i = 0; i < flexop_wt.cur.nlines; i++) flexop_wt.cur.lines[i].taken = 0;
+        flexop_watch_free_state(&s, 0);
+    }
+
+    flexop_unlock();
+
+    if (!ok) flexop_warning("flexop: options file \"%s\" not reloaded: %s.\n", flexop_wt.path, msg);
+
+    for (i = 0; i < argc; i++) flexop_free(argv[i]);
+    flexop_free(argv);
+    flexop_free(lines);
+
+    if (!ok) return -1;
+
+    return argc > 0;
+}
+
+static void flexop_watch_hup(int sig)
+{
+    char c = FLEXOP_WATCH_RELOAD;
+    int e = errno;
+
+    (void)sig;
+
+    if (write(flexop_wt.wake[1], &c, 1) < 0) {
+        /* the pipe is full (EAGAIN), a reload is pending anyway */
+    }
+
+    errno = e;
+}
+
+/* whether an inotify event is for the options file */
+static int flexop_watch_changed(void)
+{
+#ifdef __linux__
+    char buf[4096];
+    const struct inotify_event *ev;
+    ssize_t n, i;
+    int hit = 0;
+
+    while ((n = read(flexop_wt.ino, buf, sizeof(buf))) > 0) {
+        for (i = 0; i < n; i += sizeof(*ev) + ev->len) {
+            ev = (const struct inotify_event *)(buf + i);
+            if (ev->len > 0 && !strcmp(ev->name, flexop_wt.name)) hit = 1;
+        }
+    }
+
+    return hit;
+#else
+    return 0;
+#endif
+}
+
+static void * flexop_watch_main(void *arg)
+{
+    struct pollfd pfd[2];
+    char buf[64];
+    ssize_t n;
+    int np;
+
+    (void)arg;
+
+    pfd[0].fd = flexop_wt.wake[0];
+    pfd[0].events = POLLIN;
+    pfd[1].fd = flexop_wt.ino;
+    pfd[1].events = POLLIN;
+    np = flexop_wt.ino >= 0 ? 2 : 1;
+
+    while (1) {
+        if (poll(pfd, np, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        /* pending requests are served by one reload */
+        if (pfd[0].revents) {
+            n = read(flexop_wt.wake[0], buf, sizeof(buf));
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) break;
+
+            if (__sync_fetch_and_or(&flexop_wt.stop, 0)) break;
+
+            if (n > 0) flexop_watch_reload(1);
+        }
+
+        if (np > 1 && pfd[1].revents && flexop_watch_changed()) flexop_watch_reload(1);
+    }
+
+    return NULL;
+}
+
+int flexop_watch_start(const char *path)
+{
+    struct sigaction sa;
+    char *p;
+
+    if (flexop_wt.running) {
+        flexop_warning("flexop: options file is watched already.\n");
+        return 0;
+    }
+
+    if (path == NULL) path = flexop_registry()->opt_file;
+
+    if (path == NULL) {
+        flexop_warning("flexop: no options file to watch.\n");
+        return 0;
+    }
+
+    if (flexop_is_stream(path)) {
+        flexop_warning("flexop: cannot watch options stream \"%s\".\n", path);
+        return 0;
+    }
+
+    if (pipe(flexop_wt.wake) < 0) {
+        flexop_warning("flexop: cannot create pipe: %s.\n", strerror(errno));
+        return 0;
+    }
+
+    /* the signal handler must not block on a full pipe */
+    fcntl(flexop_wt.wake[0], F_SETFL, fcntl(flexop_wt.wake[0], F_GETFL) | O_NONBLOCK);
+    fcntl(flexop_wt.wake[1], F_SETFL, fcntl(flexop_wt.wake[1], F_GETFL) | O_NONBLOCK);
+
+    flexop_wt.stop = 0;
+
+    flexop_wt.path = strdup(path);
+    flexop_wt.file = flexop_intern_file(path);
+    flexop_wt.name = strdup((p = strrchr(path, '/')) == NULL ? path : p + 1);
+    flexop_wt.ino = -1;
+
+    /* the values of the file as parsed by flexop_init */
+    if (flexop_watch_reload(0) < 0) {
+        close(flexop_wt.wake[0]);
+        close(flexop_wt.wake[1]);
+        flexop_watch_free_state(&flexop_wt.cur, 1);
+        flexop_free(flexop_wt.path);
+        flexop_free(flexop_wt.name);
+        return 0;
+    }
+
+#ifdef __linux__
+    /* the directory, editors replace the file */
+    if ((flexop_wt.ino = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) >= 0) {
+        p = strdup(path);
+        if (strrchr(p, '/') == NULL) {
+            strcpy(p, ".");
+        }
+        else if (strrchr(p, '/') == p) {
+            p[1] = '\0';
+        }
+        else {
+            *strrchr(p, '/') = '\0';
+        }
+
+        /* written in place or renamed over, a created file may still be
+         * empty */
+        if (inotify_add_watch(flexop_wt.ino, p, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            flexop_warning("flexop: cannot watch \"%s\": %s, use SIGHUP.\n", p, strerror(errno));
+            close(flexop_wt.ino);
+            flexop_wt.ino = -1;
+        }
+
+        flexop_free(p);
+    }
+#endif
+
+    if (pthread_create(&flexop_wt.thread, NULL, flexop_watch_main, NULL) != 0) {
+        flexop_warning("flexop: cannot create watch thread.\n");
+        if (flexop_wt.ino >= 0) close(flexop_wt.ino);
+        close(flexop_wt.wake[0]);
+        close(flexop_wt.wake[1]);
+        flexop_watch_free_state(&flexop_wt.cur, 1);
+        flexop_free(flexop_wt.path);
+        flexop_free(flexop_wt.name);
+        return 0;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = flexop_watch_hup;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGHUP, &sa, &flexop_wt.old_hup);
+
+    flexop_wt.running = 1;
+    return 1;
+}
+
+void flexop_watch_stop(void)
+{
+    char c = FLEXOP_WATCH_STOP;
+
+    if (!flexop_wt.running) return;
+
+    sigaction(SIGHUP, &flexop_wt.old_hup, NULL);
+
+    __sync_fetch_and_or(&flexop_wt.stop, 1);
+
+    /* a full pipe wakes the thread as well */
+    if (write(flexop_wt.wake[1], &c, 1) < 0 && errno != EAGAIN) {
+        flexop_warning("flexop: cannot stop watch thread: %s.\n", strerror(errno));
+    }
+
+    pthread_join(flexop_wt.thread, NULL);
+
+    if (flexop_wt.ino >= 0) close(flexop_wt.ino);
+    close(flexop_wt.wake[0]);
+    close(flexop_wt.wake[1]);
+
+    flexop_watch_free_state(&flexop_wt.cur, 1);
+    flexop_free(flexop_wt.path);
+    flexop_free(flexop_wt.name);
+
+    flexop_wt.path = flexop_wt.name = NULL;
+    flexop_wt.running = 0;
+}
+
+int flexop_reload(void)
+{
+    char c = FLEXOP_WATCH_RELOAD;
+
+    if (!flexop_wt.running) return 0;
+
+    return write(flexop_wt.wake[1], &c, 1) == 1 || errno == EAGAIN;
+}
+
+#else
+
+unsigned long flexop_generation(void)
+{
+    return 0;
+}
+
+int flexop_watch_start(const char *path)
+{
+    (void)path;
+
+    flexop_warning("flexop: watching options files is not available, see ./configure --enable-control.\n");
+    return 0;
+}
+
+void flexop_watch_stop(void)
+{
+}
+
+int flexop_reload(void)
+{
+    return 0;
+}
+
+#endif
@@ -1,13 +1,83 @@
 
-#include "flexop.h"
+#include "flexop-priv.h"
+
+#include <errno.h>
+#include <unistd.h>
 
 static FLEXOP flexop_iopt;
 
+/* provenance of the arguments being parsed by flexop_parse_cmdline */
+static FLEXOP_SOURCE flexop_src = FLEXOP_SRC_CMDLINE;
+static const char *flexop_src_file = NULL;
+static const int *flexop_src_lines = NULL;
+static int flexop_src_base = 0;
+
+/* errors of the last flexop_set_options or flexop_set_xxx, see FLEXOP_DIAG */
+typedef struct FLEXOP_DIAGS_
+{
+    FLEXOP_DIAG *d;
+    int n;
+    int alloc;
+
+} FLEXOP_DIAGS;
+
+static FLEXOP_DIAGS flexop_diags;
+
+/* if set, a handler which rejects its argument in flexop_parse_cmdline adds
+ * the error here instead of exiting, see flexop_apply */
+static FLEXOP_DIAGS *flexop_src_diags = NULL;
+
+static int flexop_error_mode = FLEXOP_ERRORS_EXIT;
+static int flexop_help_mode = FLEXOP_HELP_COPY;
+
+static void flexop_diags_clear(FLEXOP_DIAGS *d)
+{
+    int i;
+
+    for (i = 0; i < d->n; i++) {
+        flexop_free(d->d[i].option);
+        flexop_free(d->d[i].reason);
+    }
+
+    d->n = 0;
+}
+
+static void flexop_diags_destroy(FLEXOP_DIAGS *d)
+{
+    flexop_diags_clear(d);
+    flexop_free(d->d);
+
+    d->d = NULL;
+    d->alloc = 0;
+}
+
+static void flexop_diag_add(FLEXOP_DIAGS *d, const char *option, FLEXOP_SOURCE src, int pos,
+        const char *fmt, ...)
+{
+    FLEXOP_DIAG *e;
+    va_list ap;
+    char reason[1024];
+
+    va_start(ap, fmt);
+    vsnprintf(reason, sizeof(reason), fmt, ap);
+    va_end(ap);
+
+    if (d->n >= d->alloc) {
+        d->alloc = d->alloc == 0 ? 4 : 2 * d->alloc;
+        d->d = flexop_realloc(d->d, d->alloc * sizeof(*d->d));
+    }
+
+    e = d->d + (d->n++);
+    e->option = option == NULL ? NULL : strdup(option);
+    e->src = src;
+    e->pos = pos;
+    e->reason = strdup(reason);
+}
+
 void flexop_sort(FLEXOP *opt);
 void flexop_parse_options(int *argc, char ***argv, int *alloc, const char *optstr);
 void flexop_parse_options_file(const char *fn);
 void flexop_reset(FLEXOP *opt);
-void flexop_print_help(FLEXOP_KEY *o, const char *help);
 void flexop_parse(int *argc, char ***argv);
 void flexop_parse_cmdline(int argc, char ***argv);
 
@@ -16,7 +86,7 @@ static void flexop_key_destroy(FLEXOP_KEY *o)
     char **p;
 
     flexop_free(o->name);
-    flexop_free(o->help);
+    if (!o->borrowed) flexop_free(o->help);
     o->name = o->help = NULL;
 
     if (o->type == VT_STRING && o->used) {
@@ -29,6 +99,9 @@ static void flexop_key_destroy(FLEXOP_KEY *o)
     else if (o->type == VT_VEC_FLOAT || o->type == VT_VEC_STRING) {
         flexop_vec_destroy(o->var);
     }
+    else if (o->type == VT_VEC_SIZE || o->type == VT_VEC_DURATION) {
+        flexop_vec_destroy(o->var);
+    }
 
     if (o->keys != NULL) {
         for (p = o->keys; *p != NULL; p++) flexop_free(*p);
@@ -36,6 +109,66 @@ static void flexop_key_destroy(FLEXOP_KEY *o)
         flexop_free(o->keys);
         o->keys = NULL;
     }
+
+    flexop_free(o->khash);
+    o->khash = NULL;
+
+    flexop_constraint_free(o->check);
+    o->check = NULL;
+}
+
+/* first slot of keyword s in the hash of keywords */
+static int flexop_keyword_slot(FLEXOP_KEY *o, const char *s)
+{
+    uint64_t h = flexop_hash(s, strlen(s), 0);
+
+    return (int)((h ^ (h >> 32)) & (uint64_t)o->kmask);
+}
+
+int flexop_keyword_index(FLEXOP_KEY *o, const char *s)
+{
+    int j, k;
+
+    for (j = flexop_keyword_slot(o, s); (k = o->khash[j]) != 0; j = (j + 1) & o->kmask) {
+        if (!strcmp(o->keys[k - 1], s)) return k - 1;
+    }
+
+    return -1;
+}
+
+/* builds the hash of the keywords of 'o', at most half full */
+static void flexop_keyword_hash(FLEXOP_KEY *o)
+{
+    int i, j, n, size;
+
+    for (n = 0; o->keys[n] != NULL; n++);
+    for (size = 8; size < 2 * n; size *= 2);
+
+    o->khash = flexop_malloc(size * sizeof(*o->khash));
+    memset(o->khash, 0, size * sizeof(*o->khash));
+    o->kmask = size - 1;
+
+    for (i = 0; i < n; i++) {
+        /* the first of duplicate keywords matches */
+        if (flexop_keyword_index(o, o->keys[i]) >= 0) continue;
+
+        for (j = flexop_keyword_slot(o, o->keys[i]); o->khash[j] != 0; j = (j + 1) & o->kmask);
+        o->khash[j] = i + 1;
+    }
+}
+
+/* records that 'o' has just been set, called on every set, no allocation */
+void flexop_mark(FLEXOP_KEY *o, FLEXOP_SOURCE src, const char *file, int pos)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    o->origin.src = src;
+    o->origin.file = file;
+    o->origin.pos = pos;
+    o->origin.count++;
+    o->origin.time = tv.tv_sec + tv.tv_usec * 1e-6;
 }
 
 void flexop_preset_cmdline(const char *str)
@@ -72,6 +205,8 @@ static void flexop_register(const char *name, const char *help, const char **key
 
         flexop_register("-help", "Print options help then exit", NULL, &flexop_iopt.help_category, NULL, VT_STRING);
         flexop_register("-option_file", "Options file", NULL, &flexop_iopt.opt_file, NULL, VT_STRING);
+        flexop_register("-profile", "Apply profiles (comma separated list)", NULL, flexop_profile_handler, NULL,
+                VT_HANDLER);
 
         flexop_iopt.sorted = 0;
 
@@ -88,7 +223,11 @@ static void flexop_register(const char *name, const char *help, const char **key
     /* invalidate index */
     if (flexop_iopt.index != NULL) {
         flexop_free(flexop_iopt.index);
+        flexop_free(flexop_iopt.trie);
+        flexop_free(flexop_iopt.cats);
         flexop_iopt.index = NULL;
+        flexop_iopt.trie = NULL;
+        flexop_iopt.cats = NULL;
     }
 
     /* memory */
@@ -102,12 +241,21 @@ static void flexop_register(const char *name, const char *help, const char **key
     o = flexop_iopt.options + (flexop_iopt.size++);
 
     o->name = strdup(name);
-    o->help = help == NULL ? NULL : strdup(help);
+    o->borrowed = help != NULL && flexop_help_mode == FLEXOP_HELP_STATIC;
+    o->help = help == NULL || o->borrowed ? (char *)help : strdup(help);
     o->keys = NULL;
+    o->khash = NULL;
+    o->kmask = 0;
     o->var = var;
     o->hvar = hvar;
     o->type = type;
+    o->width = flexop_width_native(type);
     o->used = 0;
+    o->check = NULL;
+
+    memset(&o->origin, 0, sizeof(o->origin));
+    o->origin.src = FLEXOP_SRC_DEFAULT;
+    o->origin.pos = -1;
 
     if (type == VT_KEYWORD) {
         /* make a copy of the keywords list */
@@ -141,6 +289,8 @@ static void flexop_register(const char *name, const char *help, const char **key
         }
 
         *q = NULL;
+
+        flexop_keyword_hash(o);
     }
     else if (type == VT_VEC_INT) {
         flexop_vec_init((FLEXOP_VEC *)o->var, VT_INT, -1, name);
@@ -154,6 +304,12 @@ static void flexop_register(const char *name, const char *help, const char **key
     else if (type == VT_VEC_STRING) {
         flexop_vec_init((FLEXOP_VEC *)o->var, VT_STRING, -1, name);
     }
+    else if (type == VT_VEC_SIZE) {
+        flexop_vec_init((FLEXOP_VEC *)o->var, VT_SIZE, -1, name);
+    }
+    else if (type == VT_VEC_DURATION) {
+        flexop_vec_init((FLEXOP_VEC *)o->var, VT_DURATION, -1, name);
+    }
 }
 
 /* Wrapper functions for enforcing prototype checking */
@@ -177,11 +333,56 @@ void flexop_register_float(const char *name, const char *help, FLEXOP_FLOAT *var
     flexop_register(name, help, NULL, var, NULL, VT_FLOAT);
 }
 
+/* option 'name' stored with width w, see FLEXOP_WIDTH */
+static void flexop_register_width(const char *name, const char *help, void *var, FLEXOP_VTYPE type,
+        FLEXOP_WIDTH w, const char *func)
+{
+    size_t n = flexop_iopt.size;
+    FLEXOP_KEY *o;
+
+    if (flexop_width_type(w) == VT_INIT) {
+        flexop_error(1, "%s: %s is not supported for option \"-%s\".\n", func, flexop_width_name(w), name);
+    }
+
+    flexop_register(name, help, NULL, var, NULL, type);
+
+    /* not registered */
+    if (flexop_iopt.size == n) return;
+
+    o = flexop_iopt.options + flexop_iopt.size - 1;
+    o->width = w;
+
+    if (type >= VT_VEC_INT) flexop_vec_set_width(o->var, w);
+}
+
+void flexop_register_number(const char *name, const char *help, void *var, FLEXOP_WIDTH w)
+{
+    flexop_register_width(name, help, var, flexop_width_type(w), w, __func__);
+}
+
+void flexop_register_vec_number(const char *name, const char *help, FLEXOP_VEC *var, FLEXOP_WIDTH w)
+{
+    FLEXOP_VTYPE type = flexop_width_type(w);
+
+    type = type == VT_INT ? VT_VEC_INT : (type == VT_UINT ? VT_VEC_UINT : VT_VEC_FLOAT);
+    flexop_register_width(name, help, var, type, w, __func__);
+}
+
 void flexop_register_string(const char *name, const char *help, char **var)
 {
     flexop_register(name, help, NULL, var, NULL, VT_STRING);
 }
 
+void flexop_register_size(const char *name, const char *help, FLEXOP_SIZE *var)
+{
+    flexop_register(name, help, NULL, var, NULL, VT_SIZE);
+}
+
+void flexop_register_duration(const char *name, const char *help, FLEXOP_DURATION *var)
+{
+    flexop_register(name, help, NULL, var, NULL, VT_DURATION);
+}
+
 void flexop_register_keyword(const char *name, const char *help, const char **keys, int *var)
 {
     flexop_register(name, help, keys, var, NULL, VT_KEYWORD);
@@ -218,6 +419,26 @@ void flexop_register_vec_string(const char *name, const char *help, FLEXOP_VEC *
     flexop_register(name, help, NULL, var, NULL, VT_VEC_STRING);
 }
 
+void flexop_register_vec_size(const char *name, const char *help, FLEXOP_VEC *var)
+{
+    flexop_register(name, help, NULL, var, NULL, VT_VEC_SIZE);
+}
+
+void flexop_register_vec_duration(const char *name, const char *help, FLEXOP_VEC *var)
+{
+    flexop_register(name, help, NULL, var, NULL, VT_VEC_DURATION);
+}
+
+void flexop_set_help_mode(int mode)
+{
+    flexop_help_mode = mode == FLEXOP_HELP_STATIC ? FLEXOP_HELP_STATIC : FLEXOP_HELP_COPY;
+}
+
+int flexop_get_help_mode(void)
+{
+    return flexop_help_mode;
+}
+
 static int flexop_comp(const void *i0, const void *i1)
 {
     FLEXOP_KEY *o0 = flexop_iopt.options + *(int *)i0, *o1 = flexop_iopt.options + *(int *)i1;
@@ -234,165 +455,324 @@ static int flexop_comp(const void *i0, const void *i1)
     return strcmp(o0->name, o1->name);
 }
 
-void flexop_sort(FLEXOP *opt)
+/* name of the first option of trie node t */
+#define flexop_trie_name(opt, t)    ((opt)->options[(opt)->index[(t)->lo]].name)
+
+/* builds the radix trie over the sorted index, breadth first so that the
+ * children of a node are contiguous */
+static void flexop_trie_build(FLEXOP *opt)
 {
-    int i;
+    FLEXOP_TRIE *t, *c;
+    const char *first, *last;
+    int i, n, lo;
 
-    if (opt->index != NULL) return;
+    for (n = 0; n < (int)opt->size && opt->options[opt->index[n]].type != VT_TITLE; n++);
 
-    if (opt->sorted) return;
+    /* a node has two children or more, or a name ends at it */
+    opt->trie = flexop_malloc((2 * n + 1) * sizeof(*opt->trie));
+    t = opt->trie;
+    t->lo = 0;
+    t->hi = n;
+    t->depth = 0;
 
-    /* append a dummy entry at the end of the list as the key for bsearch */
-    flexop_register("dummy", NULL, NULL, NULL, NULL, VT_BOOL);
-    opt->index = flexop_malloc(opt->size * sizeof(*opt->index));
+    for (i = 0, n = 1; i < n; i++) {
+        t = opt->trie + i;
+        t->child = n;
+        t->nchild = 0;
 
-    for (i = 0; i < (int)opt->size; i++) opt->index[i] = i;
+        if (t->lo == t->hi) continue;
 
-    /* restore real size */
-    opt->size--;
+        /* the longest common prefix, the names being sorted */
+        first = flexop_trie_name(opt, t);
+        last = opt->options[opt->index[t->hi - 1]].name;
+        while (first[t->depth] != '\0' && first[t->depth] == last[t->depth]) t->depth++;
 
-    qsort(opt->index, opt->size, sizeof(*opt->index), flexop_comp);
+        /* names ending here come first, then one child per character */
+        for (lo = t->lo; lo < t->hi && opt->options[opt->index[lo]].name[t->depth] == '\0'; lo++);
 
-    /* clean up */
-    flexop_free(opt->options[opt->size].name);
-    opt->options[opt->size].name = NULL;
+        while (lo < t->hi) {
+            c = opt->trie + n++;
+            c->lo = lo;
+            c->depth = t->depth + 1;
 
-    /* mark */
-    opt->sorted = 1;
+            first = opt->options[opt->index[lo]].name;
+            while (lo < t->hi && opt->options[opt->index[lo]].name[t->depth] == first[t->depth]) lo++;
+
+            c->hi = lo;
+            t->nchild++;
+        }
+    }
 }
 
-void flexop_reset(FLEXOP *opt)
+/* from node t, the names of which have been matched up to i, the node of
+ * those continuing with the first n characters of s, NULL if none */
+static FLEXOP_TRIE * flexop_trie_walk(FLEXOP_TRIE *t, int i, const char *s, int n)
 {
-    FLEXOP_KEY *o;
+    FLEXOP_TRIE *c;
+    const char *name;
+    int j, k = 0;
 
-    if (opt->options != NULL) {
-        for (o = opt->options; o < opt->options + opt->size; o++) flexop_key_destroy(o);
+    while (1) {
+        name = flexop_trie_name(&flexop_iopt, t);
 
-        flexop_free(opt->options);
-        flexop_free(opt->index);
+        for (; i < t->depth; i++, k++) {
+            if (k == n) return t;
+            if (s[k] != name[i]) return NULL;
+        }
 
-        opt->options = NULL;
-        opt->index = NULL;
-        opt->size = opt->alloc = 0;
+        if (k == n) return t;
+
+        for (j = 0, c = flexop_iopt.trie + t->child; j < t->nchild; j++, c++) {
+            if (flexop_trie_name(&flexop_iopt, c)[i] == s[k]) break;
+        }
+
+        if (j == t->nchild) return NULL;
+        t = c;
     }
 }
 
-/* format and print the help text of option 'o' */
-void flexop_print_help(FLEXOP_KEY *o, const char *help)
+/* the trie node of the options whose names start with the first n
+ * characters of s, NULL if there are none */
+static FLEXOP_TRIE * flexop_trie_find(const char *s, int n)
 {
-    static char *indent = "     ";
-    char buffer[4096];
-    char c, *p;
-    const char *p0;
-    size_t len;
+    flexop_sort(&flexop_iopt);
 
-    if (help == NULL) return;
+    if (flexop_iopt.trie == NULL || flexop_iopt.trie->lo == flexop_iopt.trie->hi) return NULL;
 
-    /* copy help text, expanding tabs */
-    len = 0;
-    p = buffer;
-    p0 = help;
-    while (*p0 != '\0' && p - buffer < (int)sizeof(buffer) - 1) {
-        c = *(p0++);
+    return flexop_trie_walk(flexop_iopt.trie, 0, s, n);
+}
 
-        if (c == '\t') {
-            *(p++) = ' ';
-            len++;
+/* the trie node of namespace 'prefix', the options named "prefix.xxx",
+ * NULL if there are none. *depth is set to the length of "prefix.". */
+static FLEXOP_TRIE * flexop_ns_node(const char *prefix, int *depth)
+{
+    FLEXOP_TRIE *t;
+    int n;
 
-            while (len % 8 != 0 && p - buffer < (int)sizeof(buffer) - 1) {
-                *(p++) = ' ';
-                len++;
-            }
+    if (*prefix == '-') prefix++;
 
-            continue;
-        }
+    n = strlen(prefix);
+    *depth = n == 0 ? 0 : n + 1;
 
-        *(p++) = c;
-        len++;
+    /* the empty namespace is the root */
+    if ((t = flexop_trie_find(prefix, n)) == NULL || n == 0) return t;
 
-        if (c == '\n') len = 0;
-    }
+    return flexop_trie_walk(t, n, ".", 1);
+}
 
-    if (o->type == VT_KEYWORD) {
-        char **pp;
+int flexop_foreach_prefix(const char *prefix, FLEXOP_VISITOR func, void *data)
+{
+    FLEXOP_TRIE *t;
+    int i, depth;
 
-        /* +1 for '>' */
-        assert(p + 3 < buffer + sizeof(buffer));
+    if ((t = flexop_ns_node(prefix, &depth)) == NULL) return 0;
 
-        memcpy(p, " <\"", 3);
-        p += 3;
+    for (i = t->lo; i < t->hi; i++) func(flexop_iopt.options + flexop_iopt.index[i], data);
 
-        for (pp = o->keys; *pp != NULL; pp++) {
-            if (pp > o->keys) {
-                assert(p + 5 < buffer + sizeof(buffer));
-                memcpy(p, "\", \"", 4);
-                p += 4;
-            }
+    return t->hi - t->lo;
+}
 
-            len = strlen(*pp);
+int flexop_namespace(FLEXOP_NS *ns, const char *prefix)
+{
+    FLEXOP_TRIE *t;
 
-            assert(p + len + 1 < buffer + sizeof(buffer));
+    /* the trie does not change any more */
+    if (!flexop_iopt.initialized) flexop_error(1, "%s must be called after flexop_init!\n", __func__);
 
-            memcpy(p, *pp, len);
+    t = flexop_ns_node(prefix, &ns->depth);
+    ns->node = t == NULL ? -1 : t - flexop_iopt.trie;
 
-            p += len;
-        }
+    return t != NULL;
+}
 
-        *(p++) = '"';
-        *(p++) = '>';
+FLEXOP_KEY * flexop_ns_lookup(const FLEXOP_NS *ns, const char *name)
+{
+    FLEXOP_TRIE *t;
+    int n = strlen(name);
+
+    if (ns->node < 0) return NULL;
+
+    t = flexop_trie_walk(flexop_iopt.trie + ns->node, ns->depth, name, n);
+    if (t == NULL || flexop_trie_name(&flexop_iopt, t)[ns->depth + n] != '\0') return NULL;
+
+    return flexop_iopt.options + flexop_iopt.index[t->lo];
+}
+
+/* separators of the components of names */
+#define flexop_is_sep(c)            ((c) == '_' || (c) == '.')
+
+/* counts the options below node t whose components separated by '_' or
+ * '.' start with those of s, up to 2, the characters of the names before i
+ * have been matched. *k is set to the position of one in the index. */
+static int flexop_trie_abbrev(FLEXOP_TRIE *t, int i, const char *s, int *k)
+{
+    const char *name = flexop_trie_name(&flexop_iopt, t);
+    int j, n = 0;
+
+    for (; i < t->depth; i++) {
+        if (*s == '\0') break;
+
+        /* skips the rest of the component */
+        if (flexop_is_sep(*s) && !flexop_is_sep(name[i])) continue;
+
+        if (*s != name[i]) return 0;
+        s++;
+    }
+
+    if (*s == '\0') {
+        *k = t->lo;
+        return t->hi - t->lo;
+    }
+
+    for (j = 0; j < t->nchild && n < 2; j++) {
+        n += flexop_trie_abbrev(flexop_iopt.trie + t->child + j, i, s, k);
     }
-    else if (o->type == VT_BOOL) {
-        p0 = " (the opposite option is \"+%s\")";
-        len = strlen(p0) - 2 + strlen(o->name);;
 
-        assert(p + len + 1 < buffer + sizeof(buffer));
+    return n;
+}
+
+FLEXOP_KEY * flexop_match(const char *name, int *count)
+{
+    FLEXOP_TRIE *t;
+    int n, k = 0;
+
+    if (*name == '-' || *name == '+') name++;
+
+    n = strlen(name);
+    *count = 0;
+
+    if ((t = flexop_trie_find(name, n)) != NULL) {
+        /* the option itself, the shortest name comes first */
+        if (flexop_trie_name(&flexop_iopt, t)[n] == '\0') {
+            *count = 1;
+            return flexop_iopt.options + flexop_iopt.index[t->lo];
+        }
 
-        sprintf(p, p0, o->name);
-        p += len;
+        k = t->lo;
+        *count = t->hi - t->lo;
+    }
+    else if (strpbrk(name, "_.") != NULL && flexop_iopt.trie != NULL) {
+        *count = flexop_trie_abbrev(flexop_iopt.trie, 0, name, &k);
     }
 
-    *p = '\0';
+    return *count == 1 ? flexop_iopt.options + flexop_iopt.index[k] : NULL;
+}
 
-    len = sizeof(indent) - 1;
-    flexop_printf(indent);
-    p0 = p = buffer;
+int flexop_prefix_next(const char *prefix, int *it, const char **name)
+{
+    FLEXOP_TRIE *t;
 
-    while (*p != '\0') {
-        while (*p != '\0' && *p != '\n' && isspace(*(char *)p)) p++;
+    assert(it != NULL);
 
-        while (*p != '\0' && *p != '\n' && !isspace(*(char *)p)) p++;
+    if (*prefix == '-' || *prefix == '+') prefix++;
 
-        c = *p;
-        if (*p != '\0') *p = '\0';
+    if ((t = flexop_trie_find(prefix, strlen(prefix))) == NULL || *it < 0 || t->lo + *it >= t->hi) return 0;
 
-        if (p == p0) break;
+    if (name != NULL) *name = flexop_iopt.options[flexop_iopt.index[t->lo + *it]].name;
+    (*it)++;
 
-        if (p - p0 + len + 1 >= 78 && len >= sizeof(indent)) {
-            flexop_printf("\n%s", indent);
-            len = sizeof(indent) - 1;
+    return 1;
+}
 
-            while (isspace(*(const char *)p0)) p0++;
-        }
+void flexop_sort(FLEXOP *opt)
+{
+    int i;
 
-        flexop_printf("%s", p0);
+    if (opt->index != NULL) return;
 
-        if (c != '\0') {
-            flexop_printf("%c", c);
-            *(p++) = c;
-        }
+    if (opt->sorted) return;
+
+    /* append a dummy entry at the end of the list as the key for bsearch */
+    flexop_register("dummy", NULL, NULL, NULL, NULL, VT_BOOL);
+    opt->index = flexop_malloc(opt->size * sizeof(*opt->index));
+
+    for (i = 0; i < (int)opt->size; i++) opt->index[i] = i;
+
+    /* restore real size */
+    opt->size--;
+
+    qsort(opt->index, opt->size, sizeof(*opt->index), flexop_comp);
+    flexop_trie_build(opt);
+    flexop_category_build(opt);
+
+    /* clean up */
+    flexop_free(opt->options[opt->size].name);
+    opt->options[opt->size].name = NULL;
+
+    /* mark */
+    opt->sorted = 1;
+}
+
+FLEXOP_KEY * flexop_lookup(const char *name)
+{
+    FLEXOP_KEY *key;
+    int *k;
+
+    if (flexop_iopt.options == NULL) return NULL;
+
+    if (*name == '-' || *name == '+') name++;
+
+    flexop_sort(&flexop_iopt);
+    key = flexop_iopt.options + flexop_iopt.size;
+
+    key->name = (void *)name;
+    k = bsearch(flexop_iopt.index + flexop_iopt.size, flexop_iopt.index, flexop_iopt.size,
+            sizeof(*flexop_iopt.index), flexop_comp);
+    key->name = NULL;
+
+    return k == NULL ? NULL : flexop_iopt.options + *k;
+}
+
+void flexop_reset(FLEXOP *opt)
+{
+    FLEXOP_KEY *o;
+
+    if (opt->options != NULL) {
+        for (o = opt->options; o < opt->options + opt->size; o++) flexop_key_destroy(o);
+
+        flexop_free(opt->options);
+        flexop_free(opt->index);
+        flexop_free(opt->trie);
+        flexop_free(opt->cats);
 
-        len += p - p0;
-        if (c == '\n') {
-            flexop_printf("%s", indent);
-            len = sizeof(indent) - 1;
+        opt->options = NULL;
+        opt->index = NULL;
+        opt->trie = NULL;
+        opt->cats = NULL;
+        opt->ncats = 0;
+        opt->size = opt->alloc = 0;
+    }
+}
+
+/* width of the help text, as with the fixed buffer it replaces */
+#define FLEXOP_HELP_WIDTH   74
+
+/* appends the help text of option 'o', wrapped */
+static void flexop_help_text(FLEXOP_BUF *b, FLEXOP_KEY *o)
+{
+    FLEXOP_WRAP w;
+    char **pp;
+
+    flexop_wrap_init(&w, b, "     ", FLEXOP_HELP_WIDTH);
+    flexop_wrap_puts(&w, o->help);
+
+    if (o->type == VT_KEYWORD) {
+        flexop_wrap_puts(&w, " <\"");
 
-            while (isspace(*(char *)p)) p++;
+        for (pp = o->keys; *pp != NULL; pp++) {
+            if (pp > o->keys) flexop_wrap_puts(&w, "\", \"");
+            flexop_wrap_puts(&w, *pp);
         }
 
-        p0 = p;
+        flexop_wrap_puts(&w, "\">");
+    }
+    else if (o->type == VT_BOOL) {
+        flexop_wrap_puts(&w, " (the opposite option is \"+");
+        flexop_wrap_puts(&w, o->name);
+        flexop_wrap_puts(&w, "\")");
     }
 
-    flexop_printf("%s\n", p0);
+    flexop_wrap_end(&w);
 }
 
 void flexop_show_cmdline(void)
@@ -424,369 +804,838 @@ void flexop_show_cmdline(void)
     }
 }
 
-/* prints all options which have been called by the user */
-void flexop_show_used(void)
+/* the output of flexop_dump: a stream, or descriptor fd if fp is NULL */
+typedef struct FLEXOP_DUMP_
 {
-    int flag = 0, i;
-    FLEXOP_KEY *o;
-    char **pp;
+    FILE *fp;
+    int fd;
 
-    if (!flexop_iopt.initialized) flexop_error(1, "%s must be called after flexop_init!\n", __func__);
+} FLEXOP_DUMP;
 
-    for (o = flexop_iopt.options; o < flexop_iopt.options + flexop_iopt.size; o++) {
-        if (o->used == 0 || o->type == VT_TITLE) continue;
+/* writes and empties b */
+static int flexop_dump_flush(FLEXOP_BUF *b, FLEXOP_DUMP *out)
+{
+    size_t n = 0;
+    ssize_t r;
+    int ok = 1;
 
-        if (!flag) {
-            flexop_printf("*-------------------- "
-                    "Parameter(s) set through options "
-                    "--------------------\n");
-            flag = 1;
-        }
+    if (out->fp != NULL) {
+        ok = fwrite(b->d, 1, b->size, out->fp) == b->size;
+    }
+    else {
+        while (n < b->size) {
+            if ((r = write(out->fd, b->d + n, b->size - n)) < 0) {
+                if (errno == EINTR) continue;
 
-        switch (o->type) {
-            case VT_INIT:
-                flexop_error(1, "unexpected.\n");
+                ok = 0;
                 break;
+            }
 
-            case VT_BOOL:
-                flexop_printf("* %s: %s\n", o->help == NULL ? o->name : o->help,
-                        *(int *)o->var == 1 ? "True" : "False");
-                break;
+            n += r;
+        }
+    }
 
-            case VT_INT:
-                flexop_printf("* %s: %"IFMT"\n", o->help == NULL ? o->name : o->help,
-                        *(FLEXOP_INT *)o->var);
-                break;
+    flexop_buf_reset(b);
+    return ok;
+}
 
-            case VT_UINT:
-                flexop_printf("* %s: %"UFMT"\n", o->help == NULL ? o->name : o->help,
-                        *(FLEXOP_UINT *)o->var);
-                break;
+/* appends each line of 's' as a comment, empty lines are skipped */
+static void flexop_dump_comment(FLEXOP_BUF *b, const char *s)
+{
+    size_t n;
+
+    for (; *s != '\0'; s += n) {
+        n = strcspn(s, "\n\r");
+
+        if (n > 0) {
+            flexop_buf_puts(b, "# ");
+            flexop_buf_append(b, s, n);
+            flexop_buf_putc(b, '\n');
+        }
+
+        if (s[n] != '\0') n++;
+    }
+}
+
+int flexop_dump_quote(FLEXOP_BUF *b, const char *s)
+{
+    const char *p;
+
+    if (strpbrk(s, "\n\r") != NULL) return 0;
+
+    if (*s != '\0' && strpbrk(s, " \t\"'\\#") == NULL) {
+        flexop_buf_puts(b, s);
+        return 1;
+    }
+
+    flexop_buf_putc(b, '"');
+
+    for (p = s; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\') flexop_buf_putc(b, '\\');
+        flexop_buf_putc(b, *p);
+    }
+
+    flexop_buf_putc(b, '"');
+    return 1;
+}
+
+/* appends the value of vector 'v' as one argument, numbers are written to out
+ * as they are formatted */
+static int flexop_dump_vec(FLEXOP_BUF *b, FLEXOP_VEC *v, FLEXOP_DUMP *out)
+{
+    FLEXOP_BUF t;
+    FLEXOP_INT i;
+    const char *s;
+    int ok = 1;
+
+    /* elements are split at blanks when parsed, without quotes; an empty
+     * vector is "" */
+    if (v->type == VT_STRING) {
+        flexop_buf_init(&t);
+        flexop_buf_puts(&t, "");
+
+        for (i = 0; ok && i < v->size; i++) {
+            s = ((char **)v->d)[i];
+            ok = *s != '\0' && strpbrk(s, " \t") == NULL;
+
+            if (i > 0) flexop_buf_putc(&t, ' ');
+            flexop_buf_puts(&t, s);
+        }
 
+        if (ok) ok = flexop_dump_quote(b, t.d);
+
+        flexop_buf_destroy(&t);
+        return ok;
+    }
+
+    flexop_buf_putc(b, '"');
+
+    for (i = 0; i < v->size; i++) {
+        if (i > 0) flexop_buf_putc(b, ' ');
+
+        switch (v->type) {
+            case VT_INT:
+            case VT_UINT:
             case VT_FLOAT:
-                flexop_printf("* %s: %"FFMT"\n", o->help == NULL ? o->name : o->help,
-                        (FLEXOP_FLOAT)*(FLEXOP_FLOAT *)o->var);
+                flexop_buf_put_number(b, v->width, (char *)v->d + i * v->tsize);
                 break;
 
-            case VT_STRING:
-                flexop_printf("* %s: %s\n", o->help == NULL ? o->name : o->help,
-                        *(char **)o->var == NULL ?  "none" : *(char **)o->var);
+            case VT_SIZE:
+                flexop_buf_put_size(b, ((FLEXOP_SIZE *)v->d)[i]);
                 break;
 
-            case VT_KEYWORD:
-                flexop_printf("* %s: %s\n", o->help == NULL ? o->name : o->help,
-                        *(int *)o->var < 0 ?  "none" : (o->keys)[*(int *)o->var]);
+            case VT_DURATION:
+                flexop_buf_put_duration(b, ((FLEXOP_DURATION *)v->d)[i]);
                 break;
 
-            case VT_HANDLER:
-                flexop_printf("* %s", o->help == NULL ? o->name : o->help);
+            default:
+                break;
+        }
 
-                if ((pp = o->keys) != NULL && pp[0] != NULL && pp[1] != NULL) {
-                    flexop_printf(":\n");
+        if (b->size >= 65536 && !flexop_dump_flush(b, out)) return 0;
+    }
 
-                    for (; pp != NULL && *pp != NULL; pp++) flexop_printf("*   %s\n", *pp);
-                }
-                else if ((pp = o->keys) != NULL && pp[0] != NULL) {
-                    flexop_printf(": %s\n", *pp);
-                }
-                else {
-                    flexop_printf("\n");
-                }
+    flexop_buf_putc(b, '"');
+    return 1;
+}
 
-                break;
+static int flexop_dump_to(FLEXOP_DUMP *out, int flags, const char *func)
+{
+    FLEXOP_KEY *o;
+    FLEXOP_BUF b;
+    size_t mark;
+    const char *s;
+    int ok, err = 0, ret = 1;
 
-            case VT_TITLE:
-                break;
+    if (!flexop_iopt.initialized) flexop_error(1, "%s must be called after flexop_init!\n", func);
 
-            case VT_VEC_INT:
-                {
-                    FLEXOP_VEC *v;
+    flexop_buf_init(&b);
+    flexop_lock();
 
-                    flexop_printf("* %s:", o->help == NULL ? o->name : o->help);
+    for (o = flexop_iopt.options; o < flexop_iopt.options + flexop_iopt.size; o++) {
+        if (o->type == VT_TITLE) {
+            if (flags & FLEXOP_DUMP_COMMENTS) {
+                flexop_buf_putc(&b, '\n');
+                flexop_dump_comment(&b, o->name);
+            }
 
-                    v = o->var;
-                    for (i = 0; i < v->size; i++) {
-                        flexop_printf(" %"IFMT, flexop_vec_int_get_value(v, i));
-                    }
+            continue;
+        }
 
-                    flexop_printf("\n");
-                }
+        /* -help and -option_file are not options of the program */
+        if (o->var == &flexop_iopt.help_category || o->var == &flexop_iopt.opt_file) continue;
 
-                break;
+        if (!o->used && !(flags & FLEXOP_DUMP_ALL)) continue;
 
-            case VT_VEC_UINT:
-                {
-                    FLEXOP_VEC *v;
+        mark = b.size;
 
-                    flexop_printf("* %s:", o->help == NULL ? o->name : o->help);
+        if ((flags & FLEXOP_DUMP_COMMENTS) && o->help != NULL) flexop_dump_comment(&b, o->help);
 
-                    v = o->var;
-                    for (i = 0; i < v->size; i++) {
-                        flexop_printf(" %"UFMT, flexop_vec_uint_get_value(v, i));
-                    }
+        if (o->type == VT_BOOL) {
+            flexop_buf_printf(&b, "%c%s\n", *(int *)o->var ? '-' : '+', o->name);
+            continue;
+        }
 
-                    flexop_printf("\n");
-                }
+        flexop_buf_printf(&b, "-%s ", o->name);
 
+        switch (o->type) {
+            case VT_STRING:
+                s = *(char **)o->var;
+                ok = s != NULL && flexop_dump_quote(&b, s);
                 break;
 
-            case VT_VEC_FLOAT:
-                {
-                    FLEXOP_VEC *v;
-
-                    flexop_printf("* %s:", o->help == NULL ? o->name : o->help);
+            case VT_KEYWORD:
+                ok = *(int *)o->var >= 0 && flexop_dump_quote(&b, o->keys[*(int *)o->var]);
+                break;
 
-                    v = o->var;
-                    for (i = 0; i < v->size; i++) {
-                        flexop_printf(" %"FFMT, flexop_vec_float_get_value(v, i));
-                    }
+            case VT_HANDLER:
+                ok = o->keys != NULL && o->keys[0] != NULL && flexop_dump_quote(&b, o->keys[0]);
+                break;
 
-                    flexop_printf("\n");
-                }
+            case VT_VEC_INT:
+            case VT_VEC_UINT:
+            case VT_VEC_FLOAT:
+            case VT_VEC_STRING:
+            case VT_VEC_SIZE:
+            case VT_VEC_DURATION:
+                /* numbers can always be written, only a write fails */
+                ok = flexop_dump_vec(&b, o->var, out);
+                err = !ok && ((FLEXOP_VEC *)o->var)->type != VT_STRING;
+                break;
 
+            default:
+                flexop_format_value(&b, o);
+                ok = 1;
                 break;
+        }
 
-            case VT_VEC_STRING:
-                {
-                    FLEXOP_VEC *v;
+        if (err) break;
 
-                    flexop_printf("* %s:", o->help == NULL ? o->name : o->help);
+        if (!ok) {
+            /* NULL strings and unset keywords or handlers are defaults */
+            b.size = mark;
+            b.d[b.size] = '\0';
 
-                    v = o->var;
-                    for (i = 0; i < v->size; i++) {
-                        flexop_printf(" %s", flexop_vec_string_get_value(v, i));
-                    }
+            if (o->used) {
+                flexop_warning("flexop: option \"-%s\" cannot be written to an options file.\n", o->name);
+                ret = 0;
+            }
 
-                    flexop_printf("\n");
-                }
+            continue;
+        }
 
-                break;
+        flexop_buf_putc(&b, '\n');
+
+        if (b.size >= 65536 && !flexop_dump_flush(&b, out)) {
+            err = 1;
+            break;
         }
     }
 
-    if (flag) {
-        flexop_printf("*-----------------------------------------------------"
-                "-------------------------\n");
+    flexop_unlock();
+
+    if (err || !flexop_dump_flush(&b, out) || (out->fp != NULL && fflush(out->fp) != 0)) {
+        flexop_warning("flexop: cannot write options: %s.\n", strerror(errno));
+        ret = 0;
     }
+
+    flexop_buf_destroy(&b);
+
+    return ret;
+}
+
+int flexop_dump(FILE *fp, int flags)
+{
+    FLEXOP_DUMP out;
+
+    assert(fp != NULL);
+
+    out.fp = fp;
+    out.fd = -1;
+
+    return flexop_dump_to(&out, flags, __func__);
 }
 
-static int comp_string(const void *p1, const void *p2)
+int flexop_dump_fd(int fd, int flags)
 {
-    return strcmp(*(char **)p1, *(char **)p2);
+    FLEXOP_DUMP out;
+
+    assert(fd >= 0);
+
+    out.fp = NULL;
+    out.fd = fd;
+
+    return flexop_dump_to(&out, flags, __func__);
 }
 
-void flexop_help(void)
+/* prints all options which have been called by the user */
+void flexop_show_used(void)
 {
+    int flag = 0;
     FLEXOP_KEY *o;
+    FLEXOP_BUF b;
+    const char *label;
     char **pp;
-    int all_flag, flag, matched;
-    char **list = NULL;
-    int i, list_count = 0, list_allocated = 0;
 
-    if (flexop_iopt.help_category == NULL) return;
+    if (!flexop_iopt.initialized) flexop_error(1, "%s must be called after flexop_init!\n", __func__);
 
-    flag = 1;
-    matched = 0;
-    all_flag = !strcmp(flexop_iopt.help_category, "all");
+    flexop_buf_init(&b);
 
     for (o = flexop_iopt.options; o < flexop_iopt.options + flexop_iopt.size; o++) {
-        if (!all_flag && o->type == VT_TITLE) {
-            flag = (o->var == NULL || !strcmp(flexop_iopt.help_category, o->var));
-
-            if (o->var != NULL && (list_count == 0 || strcmp(list[list_count - 1], o->var))) {
-                if (list_count >= list_allocated) {
-                    list = flexop_realloc(list, (list_allocated + 128) * sizeof(*list));
-                    list_allocated += 128;
-                }
+        if (o->used == 0 || o->type == VT_TITLE) continue;
 
-                list[list_count++] = o->var;
-            }
+        if (!flag) {
+            flexop_buf_puts(&b, "*-------------------- "
+                    "Parameter(s) set through options "
+                    "--------------------\n");
+            flag = 1;
         }
 
-        if (!flag) continue;
-
-        /* skip option without help text */
-        if (o->help == NULL) continue;
+        label = o->help == NULL ? o->name : o->help;
 
-        matched = 1;
         switch (o->type) {
             case VT_INIT:
                 flexop_error(1, "unexpected.\n");
                 break;
 
             case VT_BOOL:
-                flexop_printf("  -%s (%s)", o->name, *(int *)o->var ? "True" : "False");
+                flexop_buf_printf(&b, "* %s: %s\n", label, *(int *)o->var == 1 ? "True" : "False");
                 break;
 
             case VT_INT:
-                flexop_printf("  -%s <integer> (%"IFMT")", o->name, *(FLEXOP_INT *)o->var);
+            case VT_UINT:
+            case VT_FLOAT:
+                flexop_buf_printf(&b, "* %s: ", label);
+                flexop_buf_put_number(&b, o->width, o->var);
+                flexop_buf_putc(&b, '\n');
                 break;
 
-            case VT_UINT:
-                flexop_printf("  -%s <unsigned integer> (%"UFMT")", o->name, *(FLEXOP_UINT *)o->var);
+            case VT_SIZE:
+                flexop_buf_printf(&b, "* %s: ", label);
+                flexop_buf_put_size(&b, *(FLEXOP_SIZE *)o->var);
+                flexop_buf_putc(&b, '\n');
                 break;
 
-            case VT_FLOAT:
-                flexop_printf("  -%s <real> (%"FFMT")", o->name, (FLEXOP_FLOAT)*(FLEXOP_FLOAT *)o->var);
+            case VT_DURATION:
+                flexop_buf_printf(&b, "* %s: ", label);
+                flexop_buf_put_duration(&b, *(FLEXOP_DURATION *)o->var);
+                flexop_buf_putc(&b, '\n');
                 break;
 
             case VT_STRING:
-                flexop_printf("  -%s <string> (\"%s\")", o->name, 
+                flexop_buf_printf(&b, "* %s: %s\n", label,
                         *(char **)o->var == NULL ?  "none" : *(char **)o->var);
                 break;
 
             case VT_KEYWORD:
-                flexop_printf("  -%s <keyword> (\"%s\")", o->name, 
-                        *(int *)o->var<0 ? "none" : (o->keys)[*(int *)o->var]);
+                flexop_buf_printf(&b, "* %s: %s\n", label,
+                        *(int *)o->var < 0 ?  "none" : (o->keys)[*(int *)o->var]);
                 break;
 
             case VT_HANDLER:
-                flexop_printf("  -%s <string>", o->name);
-                if ((pp = o->keys) != NULL && *pp != NULL && pp[1] == NULL)
-                    flexop_printf(" (%s)", *pp);
+                flexop_buf_printf(&b, "* %s", label);
+
+                if ((pp = o->keys) != NULL && pp[0] != NULL && pp[1] != NULL) {
+                    flexop_buf_puts(&b, ":\n");
+
+                    for (; pp != NULL && *pp != NULL; pp++) flexop_buf_printf(&b, "*   %s\n", *pp);
+                }
+                else if ((pp = o->keys) != NULL && pp[0] != NULL) {
+                    flexop_buf_printf(&b, ": %s\n", *pp);
+                }
+                else {
+                    flexop_buf_putc(&b, '\n');
+                }
+
                 break;
 
             case VT_TITLE:
-                flexop_printf("%s", o->name);
+                break;
+
+            case VT_VEC_INT:
+            case VT_VEC_UINT:
+            case VT_VEC_FLOAT:
+            case VT_VEC_STRING:
+            case VT_VEC_SIZE:
+            case VT_VEC_DURATION:
+                flexop_buf_printf(&b, "* %s:", label);
 
-                if (o->var != NULL) flexop_printf(" (category \"%s\")", (char *)o->var);
+                if (((FLEXOP_VEC *)o->var)->size > 0) flexop_buf_putc(&b, ' ');
+                flexop_vec_format(&b, o->var, FLEXOP_VFMT_SUMMARY);
 
+                flexop_buf_putc(&b, '\n');
                 break;
+        }
 
-            case VT_VEC_INT:
-                {
-                    FLEXOP_VEC *v;
+        /* don't let the buffer grow with long vectors */
+        if (b.size >= 65536) flexop_buf_flush(&b);
+    }
 
-                    flexop_printf("  -%s <integer> (", o->name);
+    if (flag) {
+        flexop_buf_puts(&b, "*-----------------------------------------------------"
+                "-------------------------\n");
+    }
 
-                    v = o->var;
-                    for (i = 0; i < v->size; i++) {
-                        flexop_printf("%"IFMT, flexop_vec_int_get_value(v, i));
+    flexop_buf_flush(&b);
+    flexop_buf_destroy(&b);
+}
 
-                        if (i < v->size - 1) flexop_printf(" ");
-                    }
+const char * flexop_source_name(FLEXOP_SOURCE src)
+{
+    switch (src) {
+        case FLEXOP_SRC_DEFAULT:
+            return "default";
 
-                    flexop_printf(")");
-                }
+        case FLEXOP_SRC_PRESET:
+            return "preset";
 
-                break;
+        case FLEXOP_SRC_CMDLINE:
+            return "cmdline";
 
-            case VT_VEC_UINT:
-                {
-                    FLEXOP_VEC *v;
+        case FLEXOP_SRC_FILE:
+            return "file";
 
-                    flexop_printf("  -%s <unsigned integer> (", o->name);
+        case FLEXOP_SRC_SET:
+            return "set_options";
 
-                    v = o->var;
-                    for (i = 0; i < v->size; i++) {
-                        flexop_printf("%"UFMT, flexop_vec_uint_get_value(v, i));
+        case FLEXOP_SRC_API:
+            return "api";
 
-                        if (i < v->size - 1) flexop_printf(" ");
-                    }
+        case FLEXOP_SRC_PROFILE:
+            return "profile";
+    }
 
-                    flexop_printf(")");
-                }
+    return "unknown";
+}
 
-                break;
+int flexop_origin_next(int *it, const char **name, FLEXOP_ORIGIN *origin)
+{
+    FLEXOP_KEY *o;
 
-            case VT_VEC_FLOAT:
-                {
-                    FLEXOP_VEC *v;
+    assert(it != NULL);
 
-                    flexop_printf("  -%s <float> (", o->name);
+    while (*it >= 0 && *it < (int)flexop_iopt.size) {
+        o = flexop_iopt.options + (*it)++;
+        if (o->type == VT_TITLE) continue;
 
-                    v = o->var;
-                    for (i = 0; i < v->size; i++) {
-                        flexop_printf("%"FFMT, flexop_vec_float_get_value(v, i));
+        if (name != NULL) *name = o->name;
+        if (origin != NULL) *origin = o->origin;
 
-                        if (i < v->size - 1) flexop_printf(" ");
-                    }
+        return 1;
+    }
 
-                    flexop_printf(")");
-                }
+    return 0;
+}
 
-                break;
+/* appends "argv[3]", "opts.txt:12" and so on */
+static void flexop_format_origin(FLEXOP_BUF *b, const FLEXOP_ORIGIN *r)
+{
+    switch (r->src) {
+        case FLEXOP_SRC_FILE:
+            flexop_buf_printf(b, "%s:%d", r->file, r->pos);
+            break;
 
-            case VT_VEC_STRING:
-                {
-                    FLEXOP_VEC *v;
+        case FLEXOP_SRC_CMDLINE:
+            flexop_buf_printf(b, "argv[%d]", r->pos);
+            break;
+
+        case FLEXOP_SRC_PROFILE:
+            flexop_buf_printf(b, "profile %s[%d]", r->file, r->pos);
+            break;
 
-                    flexop_printf("  -%s <string> (", o->name);
+        case FLEXOP_SRC_PRESET:
+        case FLEXOP_SRC_SET:
+            flexop_buf_printf(b, "%s[%d]", flexop_source_name(r->src), r->pos);
+            break;
 
-                    v = o->var;
-                    for (i = 0; i < v->size; i++) {
-                        flexop_printf("%s", flexop_vec_string_get_value(v, i));
+        default:
+            flexop_buf_puts(b, flexop_source_name(r->src));
+            break;
+    }
+}
 
-                        if (i < v->size - 1) flexop_printf(" ");
-                    }
+/* prints where the options which are not at their defaults were set */
+void flexop_show_origin(void)
+{
+    int flag = 0;
+    FLEXOP_KEY *o;
+    FLEXOP_BUF b;
+    time_t t;
+    struct tm tm;
+    char ts[16];
 
-                    flexop_printf(")");
-                }
+    flexop_buf_init(&b);
 
-                break;
+    for (o = flexop_iopt.options; o < flexop_iopt.options + flexop_iopt.size; o++) {
+        if (o->type == VT_TITLE || o->origin.src == FLEXOP_SRC_DEFAULT) continue;
+
+        if (!flag) {
+            flexop_buf_puts(&b, "*-------------------- "
+                    "Origin of parameter(s) "
+                    "------------------------------\n");
+            flag = 1;
         }
 
-        flexop_printf("\n");
-        if (o->help != NULL) flexop_print_help(o, o->help);
+        t = (time_t)o->origin.time;
+        localtime_r(&t, &tm);
+        strftime(ts, sizeof(ts), "%H:%M:%S", &tm);
 
-        if (o->type == VT_HANDLER && o->var != NULL) ((FLEXOP_HANDLER)o->var)(o, NULL);
+        flexop_buf_printf(&b, "* -%s: ", o->name);
+        flexop_format_origin(&b, &o->origin);
+        flexop_buf_printf(&b, ", %s", ts);
+        if (o->origin.count > 1) flexop_buf_printf(&b, ", set %d times", o->origin.count);
+        flexop_buf_putc(&b, '\n');
+
+        if (b.size >= 65536) flexop_buf_flush(&b);
     }
 
-    if (matched) {
-        flexop_printf("\n");
+    if (flag) {
+        flexop_buf_puts(&b, "*-----------------------------------------------------"
+                "-------------------------\n");
     }
-    else {
-        if (strcmp(flexop_iopt.help_category, "help")) {
-            flexop_printf("Unknown help category '%s'.\n", flexop_iopt.help_category);
-        }
 
-        qsort(list, list_count, sizeof(*list), comp_string);
-        flexop_printf("Usage:\n    %s -help <category>\n"
-                "where <category> should be one of:\n", flexop_iopt.argv[0]);
+    flexop_buf_flush(&b);
+    flexop_buf_destroy(&b);
+}
+
+void flexop_memory_usage(FLEXOP_MEMORY *m)
+{
+    FLEXOP_KEY *o;
+    char **pp;
+
+    assert(m != NULL);
+
+    memset(m, 0, sizeof(*m));
+    m->options = flexop_iopt.alloc * sizeof(*flexop_iopt.options);
 
-        flexop_printf("    all");
-        list_allocated = 7;
+    for (o = flexop_iopt.options; o < flexop_iopt.options + flexop_iopt.size; o++) {
+        m->names += strlen(o->name) + 1;
 
-        for (i = 0; i < list_count; i++) {
-            if ((list_allocated += strlen(list[i]) + 2) > 78) {
-                list_allocated = strlen(list[i]) + 4;
-                flexop_printf(",\n    %s", list[i]);
+        if (o->help != NULL) {
+            /* reading it would make its pages resident */
+            if (o->borrowed) {
+                m->nborrowed++;
             }
             else {
-                flexop_printf(", %s", list[i]);
+                m->help += strlen(o->help) + 1;
             }
         }
 
-        flexop_printf("\n");
-    }
+        if (o->type == VT_KEYWORD && o->keys != NULL) {
+            for (pp = o->keys; *pp != NULL; pp++) m->names += strlen(*pp) + 1;
 
-    flexop_free(list);
+            m->names += (pp - o->keys + 1) * sizeof(*o->keys);
+        }
 
-    flexop_reset(&flexop_iopt);
+        if (o->khash != NULL) m->names += (o->kmask + 1) * sizeof(*o->khash);
+    }
 
-    exit(0);
+    /* as allocated by flexop_sort, with the dummy entry */
+    if (flexop_iopt.index != NULL) {
+        m->index = (flexop_iopt.size + 1) * (sizeof(*flexop_iopt.index) + sizeof(*flexop_iopt.cats));
+        if (flexop_iopt.trie != NULL) m->index += (2 * flexop_iopt.trie->hi + 1) * sizeof(*flexop_iopt.trie);
+    }
+
+    m->total = m->options + m->names + m->help + m->index;
 }
 
-/*---------------------------------------------------------------------------*/
-void flexop_parse_options(int *argc, char ***argv, int *alloc, const char *optstr)
+/* prints flexop_memory_usage */
+void flexop_show_memory(void)
 {
-    char quote = '\0', c, *p, *q;
-    const char *optstr0 = optstr, *r;
-    int ac = *argc;
+    FLEXOP_MEMORY m;
+    FLEXOP_BUF b;
+
+    flexop_memory_usage(&m);
+    flexop_buf_init(&b);
+
+    flexop_buf_printf(&b, "*-------------------- "
+            "Memory of the options (bytes) "
+            "-----------------------\n");
+    flexop_buf_printf(&b, "* options: %lu (%lu registered)\n", (unsigned long)m.options,
+            (unsigned long)flexop_iopt.size);
+    flexop_buf_printf(&b, "* names and keywords: %lu\n", (unsigned long)m.names);
+    flexop_buf_printf(&b, "* help: %lu copied, borrowed by %lu options\n", (unsigned long)m.help,
+            (unsigned long)m.nborrowed);
+    flexop_buf_printf(&b, "* index: %lu\n", (unsigned long)m.index);
+    flexop_buf_printf(&b, "* total: %lu\n", (unsigned long)m.total);
+    flexop_buf_puts(&b, "*-----------------------------------------------------"
+            "-------------------------\n");
+
+    flexop_buf_flush(&b);
+    flexop_buf_destroy(&b);
+}
 
-    p = flexop_malloc(strlen(optstr) + 1);
+/* the type of numbers in the help, 'label' for the default width */
+static const char * flexop_width_label(FLEXOP_KEY *o, const char *label)
+{
+    return o->width == flexop_width_native(o->type) ? label : flexop_width_name(o->width);
+}
 
-    while (1) {
-        while (isspace(*(const char *)optstr)) optstr++;
+/* appends the help of option 'o'. The help callback of a handler prints
+ * by itself, it is called after b is flushed if 'print' */
+static void flexop_help_option(FLEXOP_BUF *b, FLEXOP_KEY *o, int print)
+{
+    char **pp;
 
-        if (*optstr == '#') {
-            /* skip to eol */
-            while (*(++optstr) != '\n' && *optstr != '\0');
+    switch (o->type) {
+        case VT_INIT:
+            flexop_error(1, "unexpected.\n");
+            break;
 
-            if (*optstr == '\n') continue;
-        }
+        case VT_BOOL:
+            flexop_buf_printf(b, "  -%s (%s)", o->name, *(int *)o->var ? "True" : "False");
+            break;
 
-        if (*optstr == '\0') break;
+        case VT_INT:
+            flexop_buf_printf(b, "  -%s <%s> (", o->name, flexop_width_label(o, "integer"));
+            flexop_buf_put_number(b, o->width, o->var);
+            flexop_buf_putc(b, ')');
+            break;
+
+        case VT_UINT:
+            flexop_buf_printf(b, "  -%s <%s> (", o->name, flexop_width_label(o, "unsigned integer"));
+            flexop_buf_put_number(b, o->width, o->var);
+            flexop_buf_putc(b, ')');
+            break;
+
+        case VT_FLOAT:
+            flexop_buf_printf(b, "  -%s <%s> (", o->name, flexop_width_label(o, "real"));
+            flexop_buf_put_number(b, o->width, o->var);
+            flexop_buf_putc(b, ')');
+            break;
+
+        case VT_SIZE:
+            flexop_buf_printf(b, "  -%s <size> (", o->name);
+            flexop_buf_put_size(b, *(FLEXOP_SIZE *)o->var);
+            flexop_buf_putc(b, ')');
+            break;
+
+        case VT_DURATION:
+            flexop_buf_printf(b, "  -%s <duration> (", o->name);
+            flexop_buf_put_duration(b, *(FLEXOP_DURATION *)o->var);
+            flexop_buf_putc(b, ')');
+            break;
+
+        case VT_STRING:
+            flexop_buf_printf(b, "  -%s <string> (\"%s\")", o->name, 
+                    *(char **)o->var == NULL ?  "none" : *(char **)o->var);
+            break;
+
+        case VT_KEYWORD:
+            flexop_buf_printf(b, "  -%s <keyword> (\"%s\")", o->name, 
+                    *(int *)o->var<0 ? "none" : (o->keys)[*(int *)o->var]);
+            break;
+
+        case VT_HANDLER:
+            flexop_buf_printf(b, "  -%s <string>", o->name);
+            if ((pp = o->keys) != NULL && *pp != NULL && pp[1] == NULL)
+                flexop_buf_printf(b, " (%s)", *pp);
+            break;
+
+        case VT_TITLE:
+            flexop_buf_puts(b, o->name);
+
+            if (o->var != NULL) flexop_buf_printf(b, " (category \"%s\")", (char *)o->var);
+
+            break;
+
+        case VT_VEC_INT:
+            flexop_buf_printf(b, "  -%s <%s> (", o->name, flexop_width_label(o, "integer"));
+            flexop_vec_format(b, o->var, FLEXOP_VFMT_SUMMARY);
+            flexop_buf_putc(b, ')');
+            break;
+
+        case VT_VEC_UINT:
+            flexop_buf_printf(b, "  -%s <%s> (", o->name, flexop_width_label(o, "unsigned integer"));
+            flexop_vec_format(b, o->var, FLEXOP_VFMT_SUMMARY);
+            flexop_buf_putc(b, ')');
+            break;
+
+        case VT_VEC_FLOAT:
+            flexop_buf_printf(b, "  -%s <%s> (", o->name, flexop_width_label(o, "float"));
+            flexop_vec_format(b, o->var, FLEXOP_VFMT_SUMMARY);
+            flexop_buf_putc(b, ')');
+            break;
+
+        case VT_VEC_STRING:
+            flexop_buf_printf(b, "  -%s <string> (", o->name);
+            flexop_vec_format(b, o->var, FLEXOP_VFMT_SUMMARY);
+            flexop_buf_putc(b, ')');
+            break;
+
+        case VT_VEC_SIZE:
+            flexop_buf_printf(b, "  -%s <size> (", o->name);
+            flexop_vec_format(b, o->var, FLEXOP_VFMT_SUMMARY);
+            flexop_buf_putc(b, ')');
+            break;
+
+        case VT_VEC_DURATION:
+            flexop_buf_printf(b, "  -%s <duration> (", o->name);
+            flexop_vec_format(b, o->var, FLEXOP_VFMT_SUMMARY);
+            flexop_buf_putc(b, ')');
+            break;
+    }
+
+    flexop_buf_putc(b, '\n');
+
+    if (o->help != NULL) flexop_help_text(b, o);
+
+    if (print && o->type == VT_HANDLER && o->var != NULL) {
+        flexop_buf_flush(b);
+        ((FLEXOP_HANDLER)o->var)(o, NULL);
+    }
+}
+
+/* appends the help of the options of namespace 'prefix', returns 0 if it
+ * has none */
+static int flexop_help_namespace(FLEXOP_BUF *b, const char *prefix, int print)
+{
+    FLEXOP_TRIE *t;
+    FLEXOP_KEY *o;
+    int i;
+
+    if (prefix[0] == '\0' || (t = flexop_ns_node(prefix, &i)) == NULL) return 0;
+
+    flexop_buf_printf(b, "\nOptions in namespace \"%s\":\n\n", prefix);
+
+    for (i = t->lo; i < t->hi; i++) {
+        o = flexop_iopt.options + flexop_iopt.index[i];
+        if (o->help != NULL) flexop_help_option(b, o, print);
+    }
+
+    flexop_buf_putc(b, '\n');
+
+    return 1;
+}
+
+/* appends the help of 'category', "all" or a namespace, returns 0 if
+ * nothing matches */
+static int flexop_help_render(FLEXOP_BUF *b, const char *category, int print)
+{
+    FLEXOP_KEY *o;
+    int all_flag, flag, matched;
+
+    /* options of a namespace, instead of a category */
+    if (flexop_help_namespace(b, category, print)) return 1;
+
+    flag = 1;
+    matched = 0;
+    all_flag = !strcmp(category, "all");
+
+    for (o = flexop_iopt.options; o < flexop_iopt.options + flexop_iopt.size; o++) {
+        if (!all_flag && o->type == VT_TITLE) {
+            flag = (o->var == NULL || !strcmp(category, o->var));
+        }
+
+        if (!flag) continue;
+
+        /* skip option without help text */
+        if (o->help == NULL) continue;
+
+        matched = 1;
+        flexop_help_option(b, o, print);
+    }
+
+    if (matched) flexop_buf_putc(b, '\n');
+
+    return matched;
+}
+
+void flexop_help(void)
+{
+    const char *cat;
+    int it, col;
+    FLEXOP_BUF b;
+
+    if (flexop_iopt.help_category == NULL) return;
+
+    /* rendered as a whole and written at once */
+    flexop_buf_init(&b);
+
+    if (!flexop_help_render(&b, flexop_iopt.help_category, 1)) {
+        if (strcmp(flexop_iopt.help_category, "help")) {
+            flexop_buf_printf(&b, "Unknown help category '%s'.\n", flexop_iopt.help_category);
+        }
+
+        flexop_buf_printf(&b, "Usage:\n    %s -help <category>\n"
+                "where <category> is a namespace, e.g. \"solver\" for options \"-solver.xxx\", or one of:\n",
+                flexop_iopt.argv[0]);
+
+        flexop_buf_puts(&b, "    all");
+        col = 7;
+
+        /* from the index of categories, sorted */
+        for (it = 0; flexop_category_next(&it, &cat); ) {
+            if ((col += strlen(cat) + 2) > 78) {
+                col = strlen(cat) + 4;
+                flexop_buf_printf(&b, ",\n    %s", cat);
+            }
+            else {
+                flexop_buf_printf(&b, ", %s", cat);
+            }
+        }
+
+        flexop_buf_putc(&b, '\n');
+    }
+
+    flexop_buf_flush(&b);
+    flexop_buf_destroy(&b);
+
+    flexop_reset(&flexop_iopt);
+
+    exit(0);
+}
+
+char * flexop_help_to_buffer(const char *category, size_t *len)
+{
+    FLEXOP_BUF b;
+    int matched;
+
+    if (flexop_iopt.options == NULL) {
+        if (len != NULL) *len = 0;
+        return NULL;
+    }
+
+    flexop_sort(&flexop_iopt);
+    flexop_buf_init(&b);
+
+    /* values may be changed by the control channel */
+    flexop_lock();
+    matched = flexop_help_render(&b, category == NULL ? "all" : category, 0);
+    flexop_unlock();
+
+    if (!matched) {
+        flexop_buf_destroy(&b);
+        if (len != NULL) *len = 0;
+
+        return NULL;
+    }
+
+    if (len != NULL) *len = b.size;
+
+    return b.d;
+}
+
+/*---------------------------------------------------------------------------*/
+int flexop_split_options(int *argc, char ***argv, int *alloc, const char *optstr)
+{
+    char quote = '\0', c, *p, *q;
+    const char *optstr0 = optstr, *r;
+    int ac = *argc, ret = 1;
+
+    p = flexop_malloc(strlen(optstr) + 1);
+
+    while (1) {
+        while (isspace(*(const char *)optstr)) optstr++;
+
+        if (*optstr == '#') {
+            /* skip to eol */
+            while (*(++optstr) != '\n' && *optstr != '\0');
+
+            if (*optstr == '\n') continue;
+        }
+
+        if (*optstr == '\0') break;
 
         q = p;
         while (1) {
@@ -823,15 +1672,18 @@ void flexop_parse_options(int *argc, char ***argv, int *alloc, const char *optst
         }
 
         if (quote != '\0') {
-            if (c == '\0') flexop_error(1, "invalid string: %s\n", optstr0);
+            if (c == '\0') {
+                ret = 0;
+                break;
+            }
 
             optstr++;
         }
 
         *q = '\0';
         if (ac >= *alloc - 1) {
-            *argv = flexop_realloc(*argv, (*alloc + 16) * sizeof(**argv));
-            *alloc += 16;
+            *argv = flexop_realloc(*argv, (*alloc * 2 + 16) * sizeof(**argv));
+            *alloc = *alloc * 2 + 16;
         }
 
         (*argv)[ac++] = strdup(p);
@@ -847,61 +1699,275 @@ void flexop_parse_options(int *argc, char ***argv, int *alloc, const char *optst
     (*argv)[ac] = NULL;
 
     if (*argc < ac) *argc = ac;
+
+    return ret;
+}
+
+void flexop_parse_options(int *argc, char ***argv, int *alloc, const char *optstr)
+{
+    if (!flexop_split_options(argc, argv, alloc, optstr)) {
+        flexop_error(1, "invalid string: %s\n", optstr);
+    }
+}
+
+/* reads file 'fn' into a NUL terminated buffer */
+char * flexop_read_file(const char *fn, size_t *size)
+{
+    FILE *f;
+    char *p = NULL;
+    size_t n = 0, alloc = 0, r;
+
+    if ((f = fopen(fn, "rb")) == NULL) return NULL;
+
+    while (1) {
+        if (alloc - n < 65536) {
+            alloc = alloc < 65536 ? 65536 + 1 : alloc * 2;
+            p = flexop_realloc(p, alloc);
+        }
+
+        if ((r = fread(p + n, 1, alloc - n - 1, f)) == 0) break;
+        n += r;
+    }
+
+    fclose(f);
+
+    p[n] = '\0';
+    *size = n;
+
+    return p;
+}
+
+FLEXOP * flexop_registry(void)
+{
+    return &flexop_iopt;
+}
+
+const char * flexop_intern_file(const char *fn)
+{
+    int i;
+
+    for (i = 0; i < flexop_iopt.nfiles; i++) {
+        if (!strcmp(flexop_iopt.files[i], fn)) return flexop_iopt.files[i];
+    }
+
+    flexop_iopt.files = flexop_realloc(flexop_iopt.files, (flexop_iopt.nfiles + 1) * sizeof(*flexop_iopt.files));
+    flexop_iopt.files[flexop_iopt.nfiles] = strdup(fn);
+
+    return flexop_iopt.files[flexop_iopt.nfiles++];
 }
 
 /* processes options from file 'fn' */
 void flexop_parse_options_file(const char *fn)
 {
-    FILE *f;
-    char *p, buffer[4096];
+    FLEXOP_CACHE_KEY key;
+    char *text, *p, *e, **argv;
+    const char *file;
+    size_t size;
+    int i, first, alloc, line = 0;
 
-    if ((f = fopen(fn, "r")) == NULL) {
+    /* stdin or a pipe, applied while it is read */
+    if (flexop_stream_options_file(fn)) return;
+
+    /* binary options file, mapped instead of read */
+    if (flexop_image_options_file(fn)) return;
+
+    if ((text = flexop_read_file(fn, &size)) == NULL) {
         flexop_printf("flexop: cannot open options file \"%s\".\n", fn);
         exit(1);
     }
 
-    while (1) {
-        if (fgets(buffer, sizeof(buffer), f) == NULL) break;
+    /* keep the name, origins of options point to it */
+    file = flexop_intern_file(fn);
+
+    if (flexop_cache_load(fn, text, size, &key)) {
+        flexop_free(text);
+        return;
+    }
+
+    first = flexop_iopt.argcf;
+    alloc = flexop_iopt.allocf;
+    flexop_iopt.linef = flexop_realloc(flexop_iopt.linef, (alloc + 1) * sizeof(*flexop_iopt.linef));
+
+    for (p = text; p < text + size; p = e + 1) {
+        if ((e = memchr(p, '\n', text + size - p)) == NULL) e = text + size;
+        *e = '\0';
+        line++;
 
-        p = buffer;
         while (isspace(*(char *)p)) p++;
 
         if (*p == '#' || *p == '\0') continue;
 
+        i = flexop_iopt.argcf;
         flexop_parse_options(&flexop_iopt.argcf, &flexop_iopt.argvf, &flexop_iopt.allocf, p);
+
+        if (flexop_iopt.allocf != alloc) {
+            alloc = flexop_iopt.allocf;
+            flexop_iopt.linef = flexop_realloc(flexop_iopt.linef, alloc * sizeof(*flexop_iopt.linef));
+        }
+
+        for (; i < flexop_iopt.argcf; i++) flexop_iopt.linef[i] = line;
     }
 
-    fclose(f);
+    flexop_free(text);
 
-    if (flexop_iopt.argcf == 0) return;
+    if (flexop_iopt.argcf == first) return;
 
     flexop_iopt.argvf[flexop_iopt.argcf] = NULL;
 
+    /* parse the arguments of this file */
+    argv = flexop_iopt.argvf + first;
+    flexop_parse_cmdline_from(flexop_iopt.argcf - first, &argv, FLEXOP_SRC_FILE, file,
+            flexop_iopt.linef + first, 0);
+
+    flexop_cache_save(file, &key);
+}
+
+/* number of leading arguments of argv which are complete: all but an
+ * option which needs an argument and is the last one */
+static int flexop_complete_args(int argc, char **argv)
+{
+    FLEXOP_KEY *o;
+    const char *p;
+    int i, m, n = 0;
+
+    for (i = 0; i < argc; i++) {
+        p = argv[i];
+        o = NULL;
+
+        if ((p[0] == '-' || p[0] == '+') && strchr(p, '=') == NULL) {
+            o = flexop_match(p[0] == '-' && p[1] == '-' ? p + 1 : p, &m);
+        }
+
+        /* unknown options are reported at once */
+        if (o != NULL && o->type != VT_BOOL) i++;
+        if (i < argc) n = i + 1;
+    }
+
+    return n;
+}
+
+void flexop_stream_line(char *p, const char *file, int line, int *first, int last)
+{
+    char **argv;
+    int i, n, alloc = flexop_iopt.allocf;
+
+    while (p != NULL && isspace(*(char *)p)) p++;
+
+    if (p != NULL && *p != '#' && *p != '\0') {
+        flexop_iopt.linef = flexop_realloc(flexop_iopt.linef, (alloc + 1) * sizeof(*flexop_iopt.linef));
+
+        i = flexop_iopt.argcf;
+        flexop_parse_options(&flexop_iopt.argcf, &flexop_iopt.argvf, &flexop_iopt.allocf, p);
+
+        if (flexop_iopt.allocf != alloc) {
+            alloc = flexop_iopt.allocf;
+            flexop_iopt.linef = flexop_realloc(flexop_iopt.linef, alloc * sizeof(*flexop_iopt.linef));
+        }
+
+        for (; i < flexop_iopt.argcf; i++) flexop_iopt.linef[i] = line;
+    }
+
+    if (flexop_iopt.argcf == *first) return;
+
+    n = flexop_iopt.argcf - *first;
+    if (!last) n = flexop_complete_args(n, flexop_iopt.argvf + *first);
+    if (n == 0) return;
+
+    /* parsing stops at NULL */
+    p = flexop_iopt.argvf[*first + n];
+    flexop_iopt.argvf[*first + n] = NULL;
+
+    argv = flexop_iopt.argvf + *first;
+    flexop_parse_cmdline_from(n, &argv, FLEXOP_SRC_FILE, file, flexop_iopt.linef + *first, 0);
+
+    flexop_iopt.argvf[*first + n] = p;
+    *first += n;
+}
+
+/* exits if value x, given as 'arg', is out of the range of the width of 'o' */
+static void flexop_check_width(FLEXOP_KEY *o, const char *arg, const FLEXOP_WIDE *x)
+{
+    if (!flexop_store_wide(NULL, o->width, x)) {
+        flexop_error(1, "value \"%s\" out of the range of %s for option \"-%s\".\n", arg,
+                flexop_width_name(o->width), o->name);
+    }
+}
+
+/* parses a list of values separated by spaces or tabs into the vector of 'o' */
+static void flexop_parse_vec(FLEXOP_KEY *o, const char *arg)
+{
+    FLEXOP_VEC *v = o->var;
+    FLEXOP_VTYPE type = v->type;
+    FLEXOP_WIDTH width = v->width;
+    char *ta, *ip;
+    union {
+        FLEXOP_WIDE x;
+        FLEXOP_SIZE s;
+        FLEXOP_DURATION d;
+    } tp;
+
+    /* init vec */
+    if (o->used && flexop_vec_initialized(v)) {
+        flexop_vec_destroy(v);
+        flexop_vec_init(v, type, -1, o->name);
+        if (width != v->width) flexop_vec_set_width(v, width);
+    }
+
     /* parse */
-    flexop_parse_cmdline(flexop_iopt.argcf, &flexop_iopt.argvf);
+    ta = strdup(arg);
+    ip = strtok(ta, " \t");
+
+    while (ip != NULL) {
+        switch (type) {
+            case VT_INT:
+            case VT_UINT:
+            case VT_FLOAT:
+                flexop_atowide(ip, width, &tp.x);
+                flexop_check_width(o, ip, &tp.x);
+                flexop_vec_add_wide(v, &tp.x);
+                break;
+
+            case VT_SIZE:
+                tp.s = flexop_atosize(ip);
+                flexop_vec_add_entry(v, &tp.s);
+                break;
+
+            case VT_DURATION:
+                tp.d = flexop_atoduration(ip);
+                flexop_vec_add_entry(v, &tp.d);
+                break;
+
+            default:
+                flexop_vec_add_entry(v, ip);
+                break;
+        }
+
+        ip = strtok(NULL, " \t");
+    }
+
+    o->used = 1;
+    free(ta);
 }
 
 /* parses cmdline parameters, processes and removes known options from
    the argument list */
 void flexop_parse_cmdline(int argc, char ***argv)
 {
-    FLEXOP_KEY *o, *key = NULL;
+    FLEXOP_KEY *o;
     char **pp;
-    char *p, *arg;
-    int i, j;
-    int *k = NULL;                /* points to sorted indices of options */
+    char *p, *arg, msg[256];
+    int i, j, n, pos;
+    FLEXOP_WIDE tp;
 
     if (argc <= 0) return;
 
-    flexop_sort(&flexop_iopt);
-    key = flexop_iopt.options + flexop_iopt.size;
-
     /* parse */
     for (i = 0; i < argc; i++) {
         char *q;
         o = NULL;
         arg = NULL;
-        k = NULL;
+        n = 0;
+        pos = i;
 
         if ((p = (*argv)[i])[0] == '-' || p[0] == '+') {
             q = strdup(p[0] == '-' && p[1] == '-' ? p + 2 : p + 1);
@@ -910,16 +1976,12 @@ void flexop_parse_cmdline(int argc, char ***argv)
                 arg++;
             }
 
-            key->name = q;
-            k = bsearch(flexop_iopt.index + flexop_iopt.size, flexop_iopt.index, flexop_iopt.size,
-                    sizeof(*flexop_iopt.index), flexop_comp);
+            /* abbreviations are accepted */
+            o = flexop_match(q, &n);
             flexop_free(q);
-            key->name = NULL;
         }
 
-        if (k == NULL) flexop_error(1, "unknown option \"%s\"!\n", p);
-
-        o = flexop_iopt.options + (*k);
+        if (o == NULL) flexop_error(1, "%s option \"%s\"!\n", n > 1 ? "ambiguous" : "unknown", p);
 
         /* process option */
         if (o->type != VT_BOOL) {
@@ -943,17 +2005,21 @@ void flexop_parse_cmdline(int argc, char ***argv)
                 break;
 
             case VT_INT:
-                *(FLEXOP_INT *)o->var = flexop_atoi(arg);
+            case VT_UINT:
+            case VT_FLOAT:
+                flexop_atowide(arg, o->width, &tp);
+                flexop_check_width(o, arg, &tp);
+                flexop_store_wide(o->var, o->width, &tp);
                 o->used = 1;
                 break;
 
-            case VT_UINT:
-                *(FLEXOP_UINT *)o->var = flexop_atou(arg);
+            case VT_SIZE:
+                *(FLEXOP_SIZE *)o->var = flexop_atosize(arg);
                 o->used = 1;
                 break;
 
-            case VT_FLOAT:
-                *(FLEXOP_FLOAT *)o->var = flexop_atof(arg);
+            case VT_DURATION:
+                *(FLEXOP_DURATION *)o->var = flexop_atoduration(arg);
                 o->used = 1;
                 break;
 
@@ -974,10 +2040,7 @@ void flexop_parse_cmdline(int argc, char ***argv)
                     break;
                 }
 
-                for (pp = o->keys; *pp != NULL; pp++)
-                    if (!strcmp(*pp, arg)) break;
-
-                if (*pp == NULL) {
+                if ((j = flexop_keyword_index(o, arg)) < 0) {
                     flexop_printf("Invalid argument \"%s\" "
                             "for the option \"-%s\".\n", arg, o->name);
                     flexop_printf("Valid keywords are: ");
@@ -988,26 +2051,24 @@ void flexop_parse_cmdline(int argc, char ***argv)
                     break;
                 }
 
-                *(int *)o->var = pp - o->keys;
+                *(int *)o->var = j;
                 o->used = 1;
 
                 break;
 
             case VT_HANDLER:
-                /* save option value in o->keys */
-                j = 0;
-                if (o->keys != NULL) {
-                    flexop_free(o->keys[0]);
-                    o->keys[0] = NULL;
-                }
+                /* call user supplied option handler, which cannot be
+                 * checked beforehand */
+                if (o->var != NULL) {
+                    if (!((FLEXOP_HANDLER)o->var)(o, arg)) {
+                        if (flexop_src_diags != NULL) {
+                            snprintf(msg, sizeof(msg), "-%s", o->name);
+                            flexop_diag_add(flexop_src_diags, msg, flexop_src, pos,
+                                    "invalid argument \"%s\" for option \"%s\"", arg, msg);
+                            flexop_warning("%s.\n", flexop_src_diags->d[flexop_src_diags->n - 1].reason);
+                            continue;
+                        }
 
-                o->keys = flexop_realloc(o->keys, (j + 2) * sizeof(*o->keys));
-                o->keys[j] = strdup(arg);
-                o->keys[j + 1] = NULL;
-
-                /* call user supplied option handler */
-                if (o->var != NULL) {
-                    if (!((FLEXOP_HANDLER)o->var)(o, arg)) {
                         flexop_printf("invalid argument for \"-%s\" option.\n", o->name);
 
                         ((FLEXOP_HANDLER)o->var)(o, NULL);
@@ -1015,6 +2076,17 @@ void flexop_parse_cmdline(int argc, char ***argv)
                     }
                 }
 
+                /* save option value in o->keys once it is accepted */
+                j = 0;
+                if (o->keys != NULL) {
+                    flexop_free(o->keys[0]);
+                    o->keys[0] = NULL;
+                }
+
+                o->keys = flexop_realloc(o->keys, (j + 2) * sizeof(*o->keys));
+                o->keys[j] = strdup(arg);
+                o->keys[j + 1] = NULL;
+
                 o->used = 1;
                 break;
 
@@ -1023,135 +2095,52 @@ void flexop_parse_cmdline(int argc, char ***argv)
                 break;
 
             case VT_VEC_INT:
-                {
-                    FLEXOP_VEC *v;
-                    FLEXOP_INT tp;
-                    char *ta = NULL;
-                    char *ip;
-
-                    /* init vec */
-                    v = o->var;
-                    if (o->used && flexop_vec_initialized(v)) {
-                        flexop_vec_destroy(v);
-                        flexop_vec_init(v, VT_INT, -1, o->name);
-                    }
-                    
-                    /* parse */
-                    ta = strdup(arg);
-
-                    ip = strtok(ta, " \t");
-
-                    while (ip != NULL) {
-                        tp = flexop_atoi(ip);
-
-                        flexop_vec_add_entry(v, &tp);
-                        ip = strtok(NULL, " \t");
-                    }
-
-                    o->used = 1;
-                    free(ta);
-                }
-
-                break;
-
             case VT_VEC_UINT:
-                {
-                    FLEXOP_VEC *v;
-                    FLEXOP_UINT tp;
-                    char *ta = NULL;
-                    char *ip;
-
-                    /* init vec */
-                    v = o->var;
-                    if (o->used && flexop_vec_initialized(v)) {
-                        flexop_vec_destroy(v);
-                        flexop_vec_init(v, VT_UINT, -1, o->name);
-                    }
-                    
-                    /* parse */
-                    ta = strdup(arg);
-
-                    ip = strtok(ta, " \t");
-
-                    while (ip != NULL) {
-                        tp = flexop_atou(ip);
-
-                        flexop_vec_add_entry(v, &tp);
-                        ip = strtok(NULL, " \t");
-                    }
-
-                    o->used = 1;
-                    free(ta);
-                }
-
-                break;
-
             case VT_VEC_FLOAT:
-                {
-                    FLEXOP_VEC *v;
-                    FLEXOP_FLOAT tp;
-                    char *ta = NULL;
-                    char *ip;
-
-                    /* init vec */
-                    v = o->var;
-                    if (o->used && flexop_vec_initialized(v)) {
-                        flexop_vec_destroy(v);
-                        flexop_vec_init(v, VT_FLOAT, -1, o->name);
-                    }
-                    
-                    /* parse */
-                    ta = strdup(arg);
-
-                    ip = strtok(ta, " \t");
-
-                    while (ip != NULL) {
-                        tp = flexop_atof(ip);
-
-                        flexop_vec_add_entry(v, &tp);
-                        ip = strtok(NULL, " \t");
-                    }
-
-                    o->used = 1;
-                    free(ta);
-                }
-
-                break;
-
             case VT_VEC_STRING:
-                {
-                    FLEXOP_VEC *v;
-                    char *ta = NULL;
-                    char *ip;
-
-                    /* init vec */
-                    v = o->var;
-                    if (o->used && flexop_vec_initialized(v)) {
-                        flexop_vec_destroy(v);
-                        flexop_vec_init(v, VT_STRING, -1, o->name);
-                    }
-                    
-                    /* parse */
-                    ta = strdup(arg);
-
-                    ip = strtok(ta, " \t");
-
-                    while (ip != NULL) {
-                        flexop_vec_add_entry(v, ip);
-                        ip = strtok(NULL, " \t");
-                    }
+            case VT_VEC_SIZE:
+            case VT_VEC_DURATION:
+                flexop_parse_vec(o, arg);
+                break;
+        }
 
-                    o->used = 1;
-                    free(ta);
-                }
+        if (o->check != NULL && !flexop_constraint_check_key(o, msg, sizeof(msg))) {
+            flexop_error(1, "invalid value for option \"-%s\": %s.\n", o->name, msg);
+        }
 
-                break;
+        if (o->type != VT_TITLE) {
+            flexop_mark(o, flexop_src, flexop_src_file,
+                    flexop_src_lines != NULL ? flexop_src_lines[pos] : flexop_src_base + pos);
         }
     }
 
     return;
 }
 
+/* flexop_parse_cmdline with the given provenance: arguments come from 'src'
+ * ('file'), the position of argv[i] is lines[i] if lines is not NULL, or
+ * base + i */
+void flexop_parse_cmdline_from(int argc, char ***argv, FLEXOP_SOURCE src, const char *file,
+        const int *lines, int base)
+{
+    FLEXOP_SOURCE src0 = flexop_src;
+    const char *file0 = flexop_src_file;
+    const int *lines0 = flexop_src_lines;
+    int base0 = flexop_src_base;
+
+    flexop_src = src;
+    flexop_src_file = file;
+    flexop_src_lines = lines;
+    flexop_src_base = base;
+
+    flexop_parse_cmdline(argc, argv);
+
+    flexop_src = src0;
+    flexop_src_file = file0;
+    flexop_src_lines = lines0;
+    flexop_src_base = base0;
+}
+
 void flexop_parse(int *argc, char ***argv)
 {
     static int firstcall = 1;     /* 1st time calling this function */
@@ -1184,8 +2173,11 @@ void flexop_parse(int *argc, char ***argv)
         j = i;
     }
 
+    /* all options are registered now */
+    flexop_profile_resolve_all();
+
     /* handle preset options */
-    flexop_parse_cmdline(flexop_iopt.argcp, &flexop_iopt.argvp);
+    flexop_parse_cmdline_from(flexop_iopt.argcp, &flexop_iopt.argvp, FLEXOP_SRC_PRESET, NULL, NULL, 0);
 
     /* handle command line */
     assert(*argc > 0);
@@ -1195,8 +2187,8 @@ void flexop_parse(int *argc, char ***argv)
     for (i = 0; i < flexop_iopt.argc; i++) flexop_iopt.argv[i] = strdup((*argv)[i + 1]);
     flexop_iopt.argv[i] = NULL;
 
-    /* parse */
-    flexop_parse_cmdline(flexop_iopt.argc, &flexop_iopt.argv);
+    /* parse, positions are indices in the original argv */
+    flexop_parse_cmdline_from(flexop_iopt.argc, &flexop_iopt.argv, FLEXOP_SRC_CMDLINE, NULL, NULL, 1);
 
     /* parse option file */
     if (flexop_iopt.opt_file != NULL) flexop_parse_options_file(flexop_iopt.opt_file);
@@ -1206,8 +2198,8 @@ void flexop_parse(int *argc, char ***argv)
 
 void flexop_init(int *argc, char ***argv)
 {
-    /* option init */
-    flexop_register(NULL, NULL, NULL, NULL, NULL, VT_INIT);
+    /* option init, done already if flexop_attach failed */
+    if (!flexop_iopt.initialized) flexop_register(NULL, NULL, NULL, NULL, NULL, VT_INIT);
 
     /* option parse */
     flexop_parse(argc, argv);
@@ -1217,11 +2209,30 @@ void flexop_init(int *argc, char ***argv)
     flexop_iopt.initialized = 1;
 }
 
+void flexop_init_registry(void)
+{
+    if (flexop_iopt.initialized) return;
+
+    flexop_register(NULL, NULL, NULL, NULL, NULL, VT_INIT);
+    flexop_sort(&flexop_iopt);
+
+    flexop_iopt.initialized = 1;
+}
+
 void flexop_finalize(void)
 {
     int i;
 
+    /* the control and watch threads use the options */
+    flexop_control_stop();
+    flexop_watch_stop();
+
     flexop_reset(&flexop_iopt);
+    flexop_diags_destroy(&flexop_diags);
+    flexop_profile_free();
+
+    /* vectors may point into images */
+    flexop_image_release();
 
     /* clean up, argv */
     for (i = 0; i < flexop_iopt.argc; i++) {
@@ -1244,30 +2255,26 @@ void flexop_finalize(void)
 
     if (flexop_iopt.argcf > 0) flexop_free(flexop_iopt.argvf);
 
-    flexop_iopt.initialized = 0;
-}
-
-static int get_option(const char *op_name, void **pvar, int type, const char *func)
-{
-    int *k;
-    FLEXOP_KEY *o;
-    FLEXOP_KEY *key;
+    flexop_free(flexop_iopt.linef);
 
-    if (!flexop_iopt.initialized) flexop_error(1, "%s must be called after flexop_init!\n", func);
-
-    if (op_name[0] == '-' || op_name[1] == '+') op_name++;
+    /* clean up, names of options files */
+    for (i = 0; i < flexop_iopt.nfiles; i++) {
+        free(flexop_iopt.files[i]);
+    }
 
-    /* get key */
-    key = flexop_iopt.options + flexop_iopt.size;
+    flexop_free(flexop_iopt.files);
 
-    key->name = (void *)op_name;
-    k = bsearch(flexop_iopt.index + flexop_iopt.size, flexop_iopt.index, flexop_iopt.size,
-            sizeof(*flexop_iopt.index), flexop_comp);
-    key->name = NULL;        /* reset key->name */
+    flexop_iopt.files = NULL;
+    flexop_iopt.nfiles = 0;
+    flexop_iopt.linef = NULL;
+    flexop_iopt.initialized = 0;
+}
 
-    if (k == NULL) flexop_error(1, "%s: unknown option \"-%s\"!\n", func, op_name);
+/* returns option 'o', *pvar is its variable or value */
+static FLEXOP_KEY * get_value(FLEXOP_KEY *o, void **pvar, int type, const char *func)
+{
+    const char *op_name = o->name;
 
-    o = flexop_iopt.options + (*k);
     if (type >= 0 && (int)o->type != type) {
         flexop_printf("%s: wrong function type for \"-%s\".", func, op_name);
         switch (o->type) {
@@ -1287,6 +2294,14 @@ static int get_option(const char *op_name, void **pvar, int type, const char *fu
                 flexop_error(1, "Please use flexop_get_double instead.\n");
                 break;
 
+            case VT_SIZE:
+                flexop_error(1, "Please use flexop_get_size instead.\n");
+                break;
+
+            case VT_DURATION:
+                flexop_error(1, "Please use flexop_get_duration instead.\n");
+                break;
+
             case VT_STRING:
                 flexop_error(1, "Please use flexop_get_string instead.\n");
                 break;
@@ -1315,6 +2330,14 @@ static int get_option(const char *op_name, void **pvar, int type, const char *fu
                 flexop_error(1, "Please use flexop_get_vec_string instead.\n");
                 break;
 
+            case VT_VEC_SIZE:
+                flexop_error(1, "Please use flexop_get_vec_size instead.\n");
+                break;
+
+            case VT_VEC_DURATION:
+                flexop_error(1, "Please use flexop_get_vec_duration instead.\n");
+                break;
+
             default:
                 flexop_error(1, "No flexop_get_XXXX function for \"-%s\".\n", op_name);
                 break;
@@ -1327,6 +2350,8 @@ static int get_option(const char *op_name, void **pvar, int type, const char *fu
         case VT_INT:
         case VT_UINT:
         case VT_FLOAT:
+        case VT_SIZE:
+        case VT_DURATION:
             *pvar = o->var;
             break;
 
@@ -1339,8 +2364,11 @@ static int get_option(const char *op_name, void **pvar, int type, const char *fu
             break;
 
         case VT_VEC_INT:
+        case VT_VEC_UINT:
         case VT_VEC_FLOAT:
         case VT_VEC_STRING:
+        case VT_VEC_SIZE:
+        case VT_VEC_DURATION:
             *pvar = o->var;
             break;
 
@@ -1349,7 +2377,46 @@ static int get_option(const char *op_name, void **pvar, int type, const char *fu
             flexop_error(1, "%s:%d: unsupported or unimplemented option type.\n", __FILE__, __LINE__);
     }
 
-    return *pvar == NULL ? 0 : 1;
+    return o;
+}
+
+/* returns the option, *pvar is its variable or value */
+static FLEXOP_KEY * get_option(const char *op_name, void **pvar, int type, const char *func)
+{
+    int *k;
+    FLEXOP_KEY *key;
+
+    if (!flexop_iopt.initialized) flexop_error(1, "%s must be called after flexop_init!\n", func);
+
+    if (op_name[0] == '-' || op_name[1] == '+') op_name++;
+
+    /* get key */
+    key = flexop_iopt.options + flexop_iopt.size;
+
+    key->name = (void *)op_name;
+    k = bsearch(flexop_iopt.index + flexop_iopt.size, flexop_iopt.index, flexop_iopt.size,
+            sizeof(*flexop_iopt.index), flexop_comp);
+    key->name = NULL;        /* reset key->name */
+
+    if (k == NULL) flexop_error(1, "%s: unknown option \"-%s\"!\n", func, op_name);
+
+    return get_value(flexop_iopt.options + (*k), pvar, type, func);
+}
+
+/* get_option for option 'name' of namespace ns */
+static FLEXOP_KEY * get_ns_option(const FLEXOP_NS *ns, const char *name, void **pvar, int type,
+        const char *func)
+{
+    FLEXOP_KEY *o;
+
+    if ((o = flexop_ns_lookup(ns, name)) == NULL) {
+        if (ns->node < 0) flexop_error(1, "%s: unknown option \"%s\" in an empty namespace!\n", func, name);
+
+        flexop_error(1, "%s: unknown option \"-%.*s%s\"!\n", func, ns->depth,
+                flexop_trie_name(&flexop_iopt, flexop_iopt.trie + ns->node), name);
+    }
+
+    return get_value(o, pvar, type, func);
 }
 
 int flexop_get_bool(const char *op_name)
@@ -1363,94 +2430,579 @@ int flexop_get_bool(const char *op_name)
 
 FLEXOP_INT flexop_get_int(const char *op_name)
 {
+    FLEXOP_KEY *o;
+    FLEXOP_INT t;
     void *value;
 
-    get_option(op_name, &value, VT_INT, __func__);
+    o = get_option(op_name, &value, VT_INT, __func__);
+    flexop_load(&t, o->width, value);
 
-    return *(FLEXOP_INT *)value;
+    return t;
 }
 
 FLEXOP_UINT flexop_get_uint(const char *op_name)
 {
+    FLEXOP_KEY *o;
+    FLEXOP_UINT t;
     void *value;
 
-    get_option(op_name, &value, VT_UINT, __func__);
+    o = get_option(op_name, &value, VT_UINT, __func__);
+    flexop_load(&t, o->width, value);
 
-    return *(FLEXOP_INT *)value;
+    return t;
 }
 
 FLEXOP_FLOAT flexop_get_float(const char *op_name)
 {
+    FLEXOP_KEY *o;
+    FLEXOP_FLOAT t;
     void *value;
 
-    get_option(op_name, &value, VT_FLOAT, __func__);
+    o = get_option(op_name, &value, VT_FLOAT, __func__);
+    flexop_load(&t, o->width, value);
+
+    return t;
+}
+
+/* options with a width, which must be the one of the getter */
+#define FLEXOP_GET_WIDTH(S, T, W, VT)                                                   \
+T flexop_get_##S(const char *op_name)                                                   \
+{                                                                                       \
+    FLEXOP_KEY *o;                                                                      \
+    void *value;                                                                        \
+    T t;                                                                                \
+                                                                                        \
+    o = get_option(op_name, &value, VT, __func__);                                      \
+    if (o->width != W) {                                                                \
+        flexop_error(1, "%s: option \"-%s\" is %s, not " #S ".\n", __func__, o->name,   \
+                flexop_width_name(o->width));                                           \
+    }                                                                                   \
+                                                                                        \
+    memcpy(&t, value, sizeof(t));                                                       \
+    return t;                                                                           \
+}
+
+FLEXOP_GET_WIDTH(int8, int8_t, FLEXOP_INT8, VT_INT)
+FLEXOP_GET_WIDTH(int16, int16_t, FLEXOP_INT16, VT_INT)
+FLEXOP_GET_WIDTH(int32, int32_t, FLEXOP_INT32, VT_INT)
+FLEXOP_GET_WIDTH(int64, int64_t, FLEXOP_INT64, VT_INT)
+FLEXOP_GET_WIDTH(uint8, uint8_t, FLEXOP_UINT8, VT_UINT)
+FLEXOP_GET_WIDTH(uint16, uint16_t, FLEXOP_UINT16, VT_UINT)
+FLEXOP_GET_WIDTH(uint32, uint32_t, FLEXOP_UINT32, VT_UINT)
+FLEXOP_GET_WIDTH(uint64, uint64_t, FLEXOP_UINT64, VT_UINT)
+FLEXOP_GET_WIDTH(float32, float, FLEXOP_FLOAT32, VT_FLOAT)
+FLEXOP_GET_WIDTH(float64, double, FLEXOP_FLOAT64, VT_FLOAT)
+FLEXOP_GET_WIDTH(long_double, long double, FLEXOP_LONG_DOUBLE, VT_FLOAT)
+
+FLEXOP_SIZE flexop_get_size(const char *op_name)
+{
+    void *value;
+
+    get_option(op_name, &value, VT_SIZE, __func__);
+
+    return *(FLEXOP_SIZE *)value;
+}
+
+FLEXOP_DURATION flexop_get_duration(const char *op_name)
+{
+    void *value;
+
+    get_option(op_name, &value, VT_DURATION, __func__);
+
+    return *(FLEXOP_DURATION *)value;
+}
+
+const char * flexop_get_keyword(const char *op_name)
+{
+    void *value;
+
+    get_option(op_name, &value, VT_KEYWORD, __func__);
+
+    return value;
+}
+
+/* position of the keyword in the list, -1 if none */
+int flexop_get_keyword_index(const char *op_name)
+{
+    void *value;
+
+    return *(int *)get_option(op_name, &value, VT_KEYWORD, __func__)->var;
+}
+
+int flexop_get_origin(const char *op_name, FLEXOP_ORIGIN *origin)
+{
+    FLEXOP_KEY *o = flexop_lookup(op_name);
+
+    if (o == NULL) return 0;
+    if (origin != NULL) *origin = o->origin;
+
+    return 1;
+}
+
+const char * flexop_get_string(const char *op_name)
+{
+    void *value;
+
+    get_option(op_name, &value, VT_STRING, __func__);
+
+    return value;
+}
+
+FLEXOP_VEC * flexop_get_vec_int(const char *op_name)
+{
+    void *value;
+
+    get_option(op_name, &value, VT_VEC_INT, __func__);
+
+    return value;
+}
+
+FLEXOP_VEC * flexop_get_vec_uint(const char *op_name)
+{
+    void *value;
+
+    get_option(op_name, &value, VT_VEC_UINT, __func__);
+
+    return value;
+}
+
+FLEXOP_VEC * flexop_get_vec_float(const char *op_name)
+{
+    void *value;
+
+    get_option(op_name, &value, VT_VEC_FLOAT, __func__);
+
+    return value;
+}
+
+FLEXOP_VEC * flexop_get_vec_string(const char *op_name)
+{
+    void *value;
+
+    get_option(op_name, &value, VT_VEC_STRING, __func__);
+
+    return value;
+}
+
+FLEXOP_VEC * flexop_get_vec_size(const char *op_name)
+{
+    void *value;
+
+    get_option(op_name, &value, VT_VEC_SIZE, __func__);
+
+    return value;
+}
+
+FLEXOP_VEC * flexop_get_vec_duration(const char *op_name)
+{
+    void *value;
+
+    get_option(op_name, &value, VT_VEC_DURATION, __func__);
+
+    return value;
+}
+
+int flexop_ns_get_bool(const FLEXOP_NS *ns, const char *name)
+{
+    void *value;
+
+    get_ns_option(ns, name, &value, VT_BOOL, __func__);
+
+    return *(int *)value;
+}
+
+FLEXOP_INT flexop_ns_get_int(const FLEXOP_NS *ns, const char *name)
+{
+    FLEXOP_KEY *o;
+    FLEXOP_INT t;
+    void *value;
+
+    o = get_ns_option(ns, name, &value, VT_INT, __func__);
+    flexop_load(&t, o->width, value);
+
+    return t;
+}
+
+FLEXOP_UINT flexop_ns_get_uint(const FLEXOP_NS *ns, const char *name)
+{
+    FLEXOP_KEY *o;
+    FLEXOP_UINT t;
+    void *value;
+
+    o = get_ns_option(ns, name, &value, VT_UINT, __func__);
+    flexop_load(&t, o->width, value);
+
+    return t;
+}
+
+FLEXOP_FLOAT flexop_ns_get_float(const FLEXOP_NS *ns, const char *name)
+{
+    FLEXOP_KEY *o;
+    FLEXOP_FLOAT t;
+    void *value;
+
+    o = get_ns_option(ns, name, &value, VT_FLOAT, __func__);
+    flexop_load(&t, o->width, value);
+
+    return t;
+}
+
+FLEXOP_SIZE flexop_ns_get_size(const FLEXOP_NS *ns, const char *name)
+{
+    void *value;
+
+    get_ns_option(ns, name, &value, VT_SIZE, __func__);
+
+    return *(FLEXOP_SIZE *)value;
+}
+
+FLEXOP_DURATION flexop_ns_get_duration(const FLEXOP_NS *ns, const char *name)
+{
+    void *value;
+
+    get_ns_option(ns, name, &value, VT_DURATION, __func__);
+
+    return *(FLEXOP_DURATION *)value;
+}
+
+const char * flexop_ns_get_keyword(const FLEXOP_NS *ns, const char *name)
+{
+    void *value;
+
+    get_ns_option(ns, name, &value, VT_KEYWORD, __func__);
+
+    return value;
+}
+
+const char * flexop_ns_get_string(const FLEXOP_NS *ns, const char *name)
+{
+    void *value;
+
+    get_ns_option(ns, name, &value, VT_STRING, __func__);
+
+    return value;
+}
+
+/* vectors of any type */
+FLEXOP_VEC * flexop_ns_get_vec(const FLEXOP_NS *ns, const char *name)
+{
+    FLEXOP_KEY *o;
+    void *value;
+
+    o = get_ns_option(ns, name, &value, -1, __func__);
+
+    switch (o->type) {
+        case VT_VEC_INT:
+        case VT_VEC_UINT:
+        case VT_VEC_FLOAT:
+        case VT_VEC_STRING:
+        case VT_VEC_SIZE:
+        case VT_VEC_DURATION:
+            return value;
+
+        default:
+            flexop_error(1, "%s: option \"-%s\" is not a vector!\n", __func__, o->name);
+    }
+
+    return NULL;
+}
+
+/* an invalid flexop_set_xxx call on option 'name': exits, or, if 'fatal'
+ * is 0 or with FLEXOP_ERRORS_RETURN, is recorded and returns 0 */
+static int flexop_fail(int fatal, const char *name, const char *fmt, ...)
+{
+    va_list ap;
+    char reason[1024], option[256];
+
+    va_start(ap, fmt);
+    vsnprintf(reason, sizeof(reason), fmt, ap);
+    va_end(ap);
+
+    if (fatal && flexop_error_mode == FLEXOP_ERRORS_EXIT) flexop_error(1, "%s.\n", reason);
+
+    snprintf(option, sizeof(option), "-%s", name);
+    flexop_diag_add(&flexop_diags, option, FLEXOP_SRC_API, -1, "%s", reason);
+    flexop_warning("%s.\n", reason);
+
+    return 0;
+}
+
+void flexop_set_error_mode(int mode)
+{
+    flexop_error_mode = mode == FLEXOP_ERRORS_RETURN ? FLEXOP_ERRORS_RETURN : FLEXOP_ERRORS_EXIT;
+}
+
+int flexop_get_error_mode(void)
+{
+    return flexop_error_mode;
+}
+
+int flexop_diag_count(void)
+{
+    return flexop_diags.n;
+}
+
+const FLEXOP_DIAG * flexop_diag_get(int i)
+{
+    if (i < 0 || i >= flexop_diags.n) return NULL;
+
+    return flexop_diags.d + i;
+}
+
+/* the value of an option before a batch of options is applied */
+typedef struct FLEXOP_SAVED_
+{
+    FLEXOP_KEY *o;
+    int used;
+    FLEXOP_ORIGIN origin;
+
+    union {
+        int b;
+        int64_t i;
+        uint64_t u;
+        long double f;
+        FLEXOP_INT ni;
+        FLEXOP_UINT nu;
+        FLEXOP_FLOAT nf;
+        FLEXOP_SIZE s;
+        FLEXOP_DURATION d;
+    } v;                /* scalars, numbers with the width of the option */
+    size_t size;        /* bytes of v */
+
+    char *str;          /* strings, a copy if used; arguments of handlers */
+    FLEXOP_VEC vec;     /* vectors, a copy */
+
+} FLEXOP_SAVED;
+
+/* saved options, restored in reverse order since one may be saved twice */
+typedef struct FLEXOP_UNDO_
+{
+    FLEXOP_SAVED *d;
+    int n;
+    int alloc;
+
+} FLEXOP_UNDO;
+
+static void flexop_undo_key(FLEXOP_UNDO *u, FLEXOP_KEY *o, const char *arg);
+
+static void flexop_undo_save(FLEXOP_UNDO *u, FLEXOP_KEY *o)
+{
+    FLEXOP_SAVED *s;
+
+    if (u->n >= u->alloc) {
+        u->alloc = u->alloc == 0 ? 8 : 2 * u->alloc;
+        u->d = flexop_realloc(u->d, u->alloc * sizeof(*u->d));
+    }
+
+    s = u->d + (u->n++);
+    memset(s, 0, sizeof(*s));
+
+    s->o = o;
+    s->used = o->used;
+    s->origin = o->origin;
+
+    switch (o->type) {
+        case VT_BOOL:
+        case VT_KEYWORD:
+            s->size = sizeof(int);
+            break;
+
+        case VT_INT:
+        case VT_UINT:
+        case VT_FLOAT:
+            s->size = flexop_width_size(o->width);
+            break;
+
+        case VT_SIZE:
+            s->size = sizeof(FLEXOP_SIZE);
+            break;
+
+        case VT_DURATION:
+            s->size = sizeof(FLEXOP_DURATION);
+            break;
+
+        case VT_STRING:
+            /* the default is not owned by the option */
+            s->str = *(char **)o->var;
+            if (o->used && s->str != NULL) s->str = strdup(s->str);
+            break;
+
+        case VT_HANDLER:
+            if (o->keys != NULL && o->keys[0] != NULL) s->str = strdup(o->keys[0]);
+            break;
+
+        case VT_VEC_INT:
+        case VT_VEC_UINT:
+        case VT_VEC_FLOAT:
+        case VT_VEC_STRING:
+        case VT_VEC_SIZE:
+        case VT_VEC_DURATION:
+            flexop_vec_copy(&s->vec, o->var);
+            break;
+
+        default:
+            break;
+    }
+
+    if (s->size > 0) memcpy(&s->v, o->var, s->size);
+}
+
+/* saves the options named in argv, which has been checked */
+static void flexop_undo_argv(FLEXOP_UNDO *u, int argc, char **argv)
+{
+    FLEXOP_KEY *o;
+    char *q, *arg;
+    int i, m;
+
+    for (i = 0; i < argc; i++) {
+        if (argv[i][0] != '-' && argv[i][0] != '+') continue;
+
+        q = strdup(argv[i][0] == '-' && argv[i][1] == '-' ? argv[i] + 2 : argv[i] + 1);
+        if ((arg = strchr(q, '=')) != NULL) *(arg++) = '\0';
+
+        if ((o = flexop_match(q, &m)) != NULL) {
+            if (o->type != VT_BOOL && arg == NULL) arg = argv[++i];
+
+            flexop_undo_key(u, o, arg);
+        }
+
+        flexop_free(q);
+    }
+}
+
+/* saves o, and the options set by profiles if o is -profile */
+static void flexop_undo_key(FLEXOP_UNDO *u, FLEXOP_KEY *o, const char *arg)
+{
+    FLEXOP_KEY **keys;
+    int i, n;
+
+    flexop_undo_save(u, o);
+
+    if (o->type != VT_HANDLER || o->var != (void *)flexop_profile_handler || arg == NULL) return;
+
+    keys = flexop_profile_keys(arg, &n);
+    for (i = 0; i < n; i++) flexop_undo_save(u, keys[i]);
+
+    flexop_free(keys);
+}
+
+static void flexop_undo_restore(FLEXOP_UNDO *u)
+{
+    FLEXOP_SAVED *s;
+    FLEXOP_KEY *o;
+
+    for (s = u->d + u->n - 1; s >= u->d; s--) {
+        o = s->o;
+
+        switch (o->type) {
+            case VT_STRING:
+                if (o->used) flexop_free(*(char **)o->var);
+
+                *(char **)o->var = s->str;
+                s->str = NULL;
+                break;
+
+            case VT_HANDLER:
+                if (o->keys != NULL) {
+                    flexop_free(o->keys[0]);
+                    o->keys[0] = s->str;
+                    s->str = NULL;
+                }
+
+                break;
 
-    return *(FLEXOP_FLOAT *)value;
-}
+            case VT_VEC_INT:
+            case VT_VEC_UINT:
+            case VT_VEC_FLOAT:
+            case VT_VEC_STRING:
+            case VT_VEC_SIZE:
+            case VT_VEC_DURATION:
+                flexop_vec_destroy(o->var);
 
-const char * flexop_get_keyword(const char *op_name)
-{
-    void *value;
+                *(FLEXOP_VEC *)o->var = s->vec;
+                memset(&s->vec, 0, sizeof(s->vec));
+                break;
 
-    get_option(op_name, &value, VT_KEYWORD, __func__);
+            default:
+                if (s->size > 0) memcpy(o->var, &s->v, s->size);
+                break;
+        }
 
-    return value;
+        o->used = s->used;
+        o->origin = s->origin;
+    }
 }
 
-const char * flexop_get_string(const char *op_name)
+static void flexop_undo_destroy(FLEXOP_UNDO *u)
 {
-    void *value;
-
-    get_option(op_name, &value, VT_STRING, __func__);
+    FLEXOP_SAVED *s;
 
-    return value;
-}
+    for (s = u->d; s < u->d + u->n; s++) {
+        /* not a copy */
+        if (s->o->type == VT_STRING && !s->used) s->str = NULL;
 
-FLEXOP_VEC * flexop_get_vec_int(const char *op_name)
-{
-    void *value;
+        flexop_free(s->str);
+        if (flexop_vec_initialized(&s->vec)) flexop_vec_destroy(&s->vec);
+    }
 
-    get_option(op_name, &value, VT_VEC_INT, __func__);
+    flexop_free(u->d);
 
-    return value;
+    u->d = NULL;
+    u->n = u->alloc = 0;
 }
 
-FLEXOP_VEC * flexop_get_vec_uint(const char *op_name)
+/* flexop_parse_cmdline_from for argv, which has been checked, without
+ * exiting: handlers which reject their argument add the error to d, and
+ * all options of argv get their previous values back then. Returns 1 if
+ * argv is applied. */
+static int flexop_apply(int argc, char **argv, FLEXOP_SOURCE src, const char *file, const int *lines,
+        FLEXOP_DIAGS *d)
 {
-    void *value;
-
-    get_option(op_name, &value, VT_VEC_UINT, __func__);
+    FLEXOP_DIAGS *d0 = flexop_src_diags;
+    FLEXOP_UNDO u = {NULL, 0, 0};
+    int n = d->n;
 
-    return value;
-}
+    flexop_undo_argv(&u, argc, argv);
 
-FLEXOP_VEC * flexop_get_vec_float(const char *op_name)
-{
-    void *value;
+    flexop_src_diags = d;
+    flexop_parse_cmdline_from(argc, &argv, src, file, lines, 0);
+    flexop_src_diags = d0;
 
-    get_option(op_name, &value, VT_VEC_FLOAT, __func__);
+    if (d->n > n) flexop_undo_restore(&u);
+    flexop_undo_destroy(&u);
 
-    return value;
+    return d->n == n;
 }
 
-FLEXOP_VEC * flexop_get_vec_string(const char *op_name)
+int flexop_apply_options(int argc, char **argv, FLEXOP_SOURCE src, const char *file, const int *lines,
+        char *msg, size_t n)
 {
-    void *value;
+    FLEXOP_DIAGS d = {NULL, 0, 0};
+    int ok;
 
-    get_option(op_name, &value, VT_VEC_STRING, __func__);
+    if (!(ok = flexop_apply(argc, argv, src, file, lines, &d)) && msg != NULL && n > 0) {
+        snprintf(msg, n, "%s", d.d[0].reason);
+    }
 
-    return value;
+    flexop_diags_destroy(&d);
+
+    return ok;
 }
 
 static int set_option(const char *op_name, void *value, int type, const char *func)
 {
-    int j, *k;
+    int j, *k, ok;
     FLEXOP_KEY *o, *key;
-    char **pp;
+    FLEXOP_UNDO u = {NULL, 0, 0};
+    FLEXOP_DIAGS *d0 = flexop_src_diags;
+    char **pp, msg[256];
+    const char *use;
 
     if (!flexop_iopt.initialized)
         flexop_error(1, "%s must be called after flexop_init!\n", func);
 
+    flexop_diags_clear(&flexop_diags);
+
     if (value == NULL) return 1;
 
     if (op_name[0] == '-' || op_name[1] == '+') op_name++;
@@ -1463,62 +3015,116 @@ static int set_option(const char *op_name, void *value, int type, const char *fu
 
     key->name = NULL;        /* reset key->name */
 
-    if (k == NULL) flexop_error(1, "%s: unknown option \"-%s\"!\n", func, op_name);
+    if (k == NULL) return flexop_fail(1, op_name, "%s: unknown option \"-%s\"", func, op_name);
 
     o = flexop_iopt.options + (*k);
 
     if (type >= 0 && (int)o->type != type) {
-        flexop_printf("%s: wrong function type for \"-%s\".", func, op_name);
-
         switch (o->type) {
             case VT_BOOL:
-                flexop_error(1, "Please use flexop_set_bool instead.\n");
+                use = "flexop_set_bool";
                 break;
 
             case VT_INT:
-                flexop_error(1, "Please use flexop_set_int instead.\n");
+                use = "flexop_set_int";
                 break;
 
             case VT_UINT:
-                flexop_error(1, "Please use flexop_set_uint instead.\n");
+                use = "flexop_set_uint";
                 break;
 
             case VT_FLOAT:
-                flexop_error(1, "Please use flexop_set_double instead.\n");
+                use = "flexop_set_float";
+                break;
+
+            case VT_SIZE:
+                use = "flexop_set_size";
+                break;
+
+            case VT_DURATION:
+                use = "flexop_set_duration";
                 break;
 
             case VT_STRING:
-                flexop_error(1, "Please use flexop_set_string instead.\n");
+                use = "flexop_set_string";
                 break;
 
             case VT_KEYWORD:
-                flexop_error(1, "Please use flexop_set_keyword instead.\n");
+                use = "flexop_set_keyword";
                 break;
 
             case VT_HANDLER:
-                flexop_error(1, "Please use flexop_set_handler instead.\n");
+                use = "flexop_set_handler";
                 break;
 
             case VT_VEC_INT:
-                flexop_error(1, "Please use flexop_set_vec_int instead.\n");
+                use = "flexop_set_vec_int";
                 break;
 
             case VT_VEC_UINT:
-                flexop_error(1, "Please use flexop_set_vec_uint instead.\n");
+                use = "flexop_set_vec_uint";
                 break;
 
             case VT_VEC_FLOAT:
-                flexop_error(1, "Please use flexop_set_vec_float instead.\n");
+                use = "flexop_set_vec_float";
+                break;
+
+            case VT_VEC_STRING:
+                use = "flexop_set_vec_string";
+                break;
+
+            case VT_VEC_SIZE:
+                use = "flexop_set_vec_size";
+                break;
+
+            case VT_VEC_DURATION:
+                use = "flexop_set_vec_duration";
+                break;
+
+            default:
+                return flexop_fail(1, op_name, "%s: no flexop_set_xyz function for \"-%s\"", func, op_name);
+        }
+
+        return flexop_fail(1, op_name, "%s: wrong function type for \"-%s\", please use %s instead",
+                func, op_name, use);
+    }
+
+    /* vectors are parsed while they are set */
+    if (o->type >= VT_VEC_INT && o->type <= VT_VEC_DURATION && !flexop_check_arg(o, value)) {
+        return flexop_fail(1, op_name, "%s: invalid argument \"%s\" for option \"-%s\"", func,
+                (const char *)value, op_name);
+    }
+
+    if (o->width != FLEXOP_WNONE && o->type < VT_VEC_INT && !flexop_store(NULL, o->width, value)) {
+        return flexop_fail(1, op_name, "%s: value out of the range of %s for option \"-%s\"", func,
+                flexop_width_name(o->width), op_name);
+    }
+
+    /* constraints, nothing is changed if they are violated */
+    if (o->check != NULL) {
+        switch (o->type) {
+            case VT_STRING:
+            case VT_KEYWORD:
+                ok = flexop_constraint_check(o, &value, 1, msg, sizeof(msg));
                 break;
 
+            case VT_VEC_INT:
+            case VT_VEC_UINT:
+            case VT_VEC_FLOAT:
             case VT_VEC_STRING:
-                flexop_error(1, "Please use flexop_set_vec_string instead.\n");
+            case VT_VEC_SIZE:
+            case VT_VEC_DURATION:
+                ok = flexop_constraint_check_arg(o, value, msg, sizeof(msg));
                 break;
 
             default:
-                flexop_error(1, "No flexop_set_xyz function for \"-%s\".\n", op_name);
+                ok = flexop_constraint_check(o, value, 1, msg, sizeof(msg));
                 break;
         }
+
+        if (!ok) {
+            return flexop_fail(0, op_name, "%s: invalid value for option \"-%s\": %s", func, o->name, msg);
+        }
     }
 
     switch (o->type) {
@@ -1528,17 +3134,19 @@ static int set_option(const char *op_name, void *value, int type, const char *fu
             break;
 
         case VT_INT:
-            *(FLEXOP_INT *)o->var = *(FLEXOP_INT *)value;
+        case VT_UINT:
+        case VT_FLOAT:
+            flexop_store(o->var, o->width, value);
             o->used = 1;
             break;
 
-        case VT_UINT:
-            *(FLEXOP_UINT *)o->var = *(FLEXOP_UINT *)value;
+        case VT_SIZE:
+            *(FLEXOP_SIZE *)o->var = *(FLEXOP_SIZE *)value;
             o->used = 1;
             break;
 
-        case VT_FLOAT:
-            *(FLEXOP_FLOAT *)o->var = *(FLEXOP_FLOAT *)value;
+        case VT_DURATION:
+            *(FLEXOP_DURATION *)o->var = *(FLEXOP_DURATION *)value;
             o->used = 1;
             break;
 
@@ -1555,26 +3163,42 @@ static int set_option(const char *op_name, void *value, int type, const char *fu
                 break;
             }
 
-            for (pp = o->keys; *pp != NULL; pp++)
-                if (!strcmp(*pp, value)) break;
-
-            if (*pp == NULL) {
-                flexop_printf("%s:%d, invalid argument \"%s\" "
-                        "for the option \"-%s\".\n", __FILE__, __LINE__, value, op_name);
-
-                flexop_printf("Valid keywords are: ");
-                for (pp = o->keys; *pp != NULL; pp++) flexop_printf("%s\"%s\"", pp == o->keys ? "":", ", *pp);
+            if ((j = flexop_keyword_index(o, value)) < 0) {
+                if (flexop_error_mode == FLEXOP_ERRORS_EXIT) {
+                    flexop_printf("Valid keywords are: ");
+                    for (pp = o->keys; *pp != NULL; pp++) flexop_printf("%s\"%s\"", pp == o->keys ? "":", ", *pp);
+                    flexop_printf("\n");
+                }
 
-                flexop_printf("\n");
-                flexop_error(1, "abort.\n");
-                break;
+                return flexop_fail(1, op_name, "%s: invalid argument \"%s\" for the option \"-%s\"", func,
+                        (const char *)value, op_name);
             }
 
-            *(int *)o->var = pp - o->keys;
+            *(int *)o->var = j;
             o->used = 1;
             break;
 
         case VT_HANDLER:
+            /* call user supplied option handler, the options it sets itself
+             * (profiles) are restored if it fails */
+            if (o->var != NULL) {
+                flexop_undo_key(&u, o, value);
+
+                if (flexop_error_mode == FLEXOP_ERRORS_RETURN) flexop_src_diags = &flexop_diags;
+                ok = ((FLEXOP_HANDLER)o->var)(o, value) && flexop_diags.n == 0;
+                flexop_src_diags = d0;
+
+                if (!ok) flexop_undo_restore(&u);
+                flexop_undo_destroy(&u);
+
+                if (!ok) {
+                    if (flexop_error_mode == FLEXOP_ERRORS_EXIT) ((FLEXOP_HANDLER)o->var)(o, NULL);
+
+                    return flexop_fail(1, op_name, "%s: invalid argument \"%s\" for \"-%s\" option", func,
+                            (const char *)value, o->name);
+                }
+            }
+
             j = 0;
             if (o->keys != NULL) {
                 flexop_free(o->keys[0]);
@@ -1585,164 +3209,290 @@ static int set_option(const char *op_name, void *value, int type, const char *fu
             o->keys[j] = strdup(value);
             o->keys[j + 1] = NULL;
 
-            /* call user supplied option handler */
-            if (o->var != NULL) {
-                if (!((FLEXOP_HANDLER)o->var)(o, value)) {
-                    flexop_printf("invalid argument for \"-%s\" option.\n", o->name);
-
-                    ((FLEXOP_HANDLER)o->var)(o, NULL);
-                    flexop_error(1, "flexop: abort.\n");
-                }
-            }
-
             o->used = 1;
             break;
 
         case VT_VEC_INT:
-            {
-                FLEXOP_VEC *v;
-                FLEXOP_INT tp;
-                char *ta = NULL;
-                char *ip;
-
-                /* init vec */
-                v = o->var;
-                if (o->used && flexop_vec_initialized(v)) {
-                    flexop_vec_destroy(v);
-                    flexop_vec_init(v, VT_INT, -1, o->name);
-                }
+        case VT_VEC_UINT:
+        case VT_VEC_FLOAT:
+        case VT_VEC_STRING:
+        case VT_VEC_SIZE:
+        case VT_VEC_DURATION:
+            flexop_parse_vec(o, value);
+            break;
 
-                /* parse */
-                ta = strdup(value);
-                ip = strtok(ta, " \t");
+        default:
+            /* not allowed */
+            flexop_error(1, "%s:%d: unsupported or unimplemented option type.\n", __FILE__, __LINE__);
+    }
 
-                while (ip != NULL) {
-                    tp = flexop_atoi(ip);
+    flexop_mark(o, FLEXOP_SRC_API, NULL, -1);
 
-                    flexop_vec_add_entry(v, &tp);
-                    ip = strtok(NULL, " \t");
-                }
+    return 1;
+}
 
-                o->used = 1;
-                free(ta);
-            }
+static void flexop_msg(char *msg, size_t n, const char *fmt, ...)
+{
+    va_list ap;
 
-            break;
+    if (msg == NULL || n == 0) return;
 
-        case VT_VEC_UINT:
-            {
-                FLEXOP_VEC *v;
-                FLEXOP_UINT tp;
-                char *ta = NULL;
-                char *ip;
-
-                /* init vec */
-                v = o->var;
-                if (o->used && flexop_vec_initialized(v)) {
-                    flexop_vec_destroy(v);
-                    flexop_vec_init(v, VT_UINT, -1, o->name);
-                }
+    va_start(ap, fmt);
+    vsnprintf(msg, n, fmt, ap);
+    va_end(ap);
+}
+
+/* checks one value of type 'type' and width w at s, *end is set after
+ * the value */
+static int flexop_check_value(FLEXOP_VTYPE type, FLEXOP_WIDTH w, const char *s, const char **end)
+{
+    union {
+        FLEXOP_WIDE x;
+        FLEXOP_SIZE s;
+        FLEXOP_DURATION d;
+    } v;
+
+    *end = s;
+    switch (type) {
+        case VT_INT:
+        case VT_UINT:
+        case VT_FLOAT:
+            return flexop_parse_wide(s, end, w, &v.x) == 1 && flexop_store_wide(NULL, w, &v.x);
 
-                /* parse */
-                ta = strdup(value);
-                ip = strtok(ta, " \t");
+        case VT_SIZE:
+            return flexop_parse_size(s, end, &v.s) == 1;
 
-                while (ip != NULL) {
-                    tp = flexop_atou(ip);
+        case VT_DURATION:
+            return flexop_parse_duration(s, end, &v.d) == 1;
 
-                    flexop_vec_add_entry(v, &tp);
-                    ip = strtok(NULL, " \t");
-                }
+        default:
+            /* strings */
+            while (**end != '\0' && **end != ' ' && **end != '\t') (*end)++;
+            return 1;
+    }
+}
 
-                o->used = 1;
-                free(ta);
-            }
+/* checks that 'arg' is a valid argument for 'o', the same rules as
+ * flexop_parse_cmdline */
+int flexop_check_arg(FLEXOP_KEY *o, const char *arg)
+{
+    const char *end;
 
-            break;
+    switch (o->type) {
+        case VT_INT:
+        case VT_UINT:
+        case VT_FLOAT:
+        case VT_SIZE:
+        case VT_DURATION:
+            return flexop_check_value(o->type, o->width, arg, &end) && (*end == '\0' || isspace(*end));
+
+        case VT_KEYWORD:
+            return flexop_keyword_index(o, arg) >= 0;
 
+        case VT_VEC_INT:
+        case VT_VEC_UINT:
         case VT_VEC_FLOAT:
-            {
-                FLEXOP_VEC *v;
-                FLEXOP_FLOAT tp;
-                char *ta = NULL;
-                char *ip;
-
-                /* init vec */
-                v = o->var;
-                if (o->used && flexop_vec_initialized(v)) {
-                    flexop_vec_destroy(v);
-                    flexop_vec_init(v, VT_FLOAT, -1, o->name);
-                }
+        case VT_VEC_STRING:
+        case VT_VEC_SIZE:
+        case VT_VEC_DURATION:
+            while (1) {
+                while (*arg == ' ' || *arg == '\t') arg++;
+                if (*arg == '\0') break;
 
-                /* parse */
-                ta = strdup(value);
-                ip = strtok(ta, " \t");
+                if (!flexop_check_value(((FLEXOP_VEC *)o->var)->type, o->width, arg, &end)) return 0;
+                if (*end != '\0' && *end != ' ' && *end != '\t') return 0;
 
-                while (ip != NULL) {
-                    tp = flexop_atof(ip);
+                arg = end;
+            }
 
-                    flexop_vec_add_entry(v, &tp);
-                    ip = strtok(NULL, " \t");
-                }
+            return 1;
 
-                o->used = 1;
-                free(ta);
+        case VT_HANDLER:
+            /* handlers check their own arguments, except profiles */
+            return o->var != (void *)flexop_profile_handler || flexop_profile_check(arg);
+
+        default:
+            /* strings */
+            return 1;
+    }
+}
+
+/* checks the options in argv as flexop_set_options would set them, all
+ * errors are added to d. Returns 1 if there are none. */
+static int flexop_check_argv(int argc, char **argv, FLEXOP_DIAGS *d)
+{
+    int i, m, n = d->n;
+    char *p, *q, *arg, cmsg[256], opt[256];
+    FLEXOP_KEY *o;
+
+    for (i = 0; i < argc; i++) {
+        p = argv[i];
+
+        if (p[0] != '-' && p[0] != '+') {
+            flexop_diag_add(d, NULL, FLEXOP_SRC_SET, i, "unexpected argument \"%s\"", p);
+            continue;
+        }
+
+        q = strdup(p[0] == '-' && p[1] == '-' ? p + 2 : p + 1);
+        if ((arg = strchr(q, '=')) != NULL) *(arg++) = '\0';
+
+        /* the option without its argument */
+        snprintf(opt, sizeof(opt), "%c%s", p[0], q);
+        p = opt;
+
+        if ((o = flexop_match(q, &m)) == NULL) {
+            flexop_diag_add(d, p, FLEXOP_SRC_SET, i, "%s option \"%s\"", m > 1 ? "ambiguous" : "unknown", p);
+
+            /* and its argument */
+            if (arg == NULL && argv[i + 1] != NULL && argv[i + 1][0] != '-' && argv[i + 1][0] != '+') i++;
+        }
+        else if (o->type != VT_BOOL) {
+            if (arg == NULL) arg = argv[++i];
+
+            if (arg == NULL) {
+                flexop_diag_add(d, p, FLEXOP_SRC_SET, i - 1, "missing argument for option \"%s\"", p);
+            }
+            else if (!flexop_check_arg(o, arg)) {
+                flexop_diag_add(d, p, FLEXOP_SRC_SET, i, "invalid argument \"%s\" for option \"%s\"", arg, p);
             }
+            else if (!flexop_constraint_check_arg(o, arg, cmsg, sizeof(cmsg))) {
+                flexop_diag_add(d, p, FLEXOP_SRC_SET, i, "invalid value for option \"%s\": %s", p, cmsg);
+            }
+        }
+
+        flexop_free(q);
+    }
+
+    return d->n == n;
+}
+
+int flexop_check_options(const char *str, char *msg, size_t n)
+{
+    FLEXOP_DIAGS d = {NULL, 0, 0};
+    char **argv = NULL;
+    int i, argc = 0, alloc = 0, ret = 1;
+    size_t len;
+
+    if (!flexop_split_options(&argc, &argv, &alloc, str)) {
+        flexop_diag_add(&d, NULL, FLEXOP_SRC_SET, -1, "unbalanced quotes");
+    }
+    else {
+        flexop_check_argv(argc, argv, &d);
+    }
+
+    /* all errors, separated by "; " */
+    if (d.n > 0 && msg != NULL && n > 0) {
+        msg[0] = '\0';
+
+        for (i = 0; i < d.n; i++) {
+            len = strlen(msg);
+            flexop_msg(msg + len, n - len, "%s%s", i > 0 ? "; " : "", d.d[i].reason);
+        }
+    }
+
+    ret = d.n == 0;
+    flexop_diags_destroy(&d);
+
+    for (i = 0; i < argc; i++) flexop_free(argv[i]);
+    flexop_free(argv);
+
+    return ret;
+}
 
+void flexop_format_value(FLEXOP_BUF *b, FLEXOP_KEY *o)
+{
+    const char *p;
+
+    switch (o->type) {
+        case VT_BOOL:
+            flexop_buf_puts(b, *(int *)o->var ? "true" : "false");
             break;
 
-        case VT_VEC_STRING:
-            {
-                FLEXOP_VEC *v;
-                char *ta = NULL;
-                char *ip;
-
-                /* init vec */
-                v = o->var;
-                if (o->used && flexop_vec_initialized(v)) {
-                    flexop_vec_destroy(v);
-                    flexop_vec_init(v, VT_STRING, -1, o->name);
-                }
+        case VT_INT:
+        case VT_UINT:
+        case VT_FLOAT:
+            flexop_buf_put_number(b, o->width, o->var);
+            break;
 
-                /* parse */
-                ta = strdup(value);
-                ip = strtok(ta, " \t");
+        case VT_SIZE:
+            flexop_buf_put_size(b, *(FLEXOP_SIZE *)o->var);
+            break;
 
-                while (ip != NULL) {
-                    flexop_vec_add_entry(v, ip);
-                    ip = strtok(NULL, " \t");
-                }
+        case VT_DURATION:
+            flexop_buf_put_duration(b, *(FLEXOP_DURATION *)o->var);
+            break;
 
-                o->used = 1;
-                free(ta);
-            }
+        case VT_STRING:
+            p = *(char **)o->var;
+            flexop_buf_puts(b, p == NULL ? "" : p);
+            break;
+
+        case VT_KEYWORD:
+            flexop_buf_puts(b, *(int *)o->var < 0 ? "none" : o->keys[*(int *)o->var]);
+            break;
 
+        case VT_HANDLER:
+            flexop_buf_puts(b, o->keys == NULL || o->keys[0] == NULL ? "" : o->keys[0]);
+            break;
+
+        case VT_VEC_INT:
+        case VT_VEC_UINT:
+        case VT_VEC_FLOAT:
+        case VT_VEC_STRING:
+        case VT_VEC_SIZE:
+        case VT_VEC_DURATION:
+            flexop_vec_format(b, o->var, FLEXOP_VFMT_QUOTE);
             break;
 
         default:
-            /* not allowed */
-            flexop_error(1, "%s:%d: unsupported or unimplemented option type.\n", __FILE__, __LINE__);
+            break;
     }
-
-    return 1;
 }
 
-void flexop_set_options(const char *str)
+int flexop_set_options(const char *str)
 {
-    int i, argc = 0, argc_allocated = 0;
+    int i, argc = 0, alloc = 0, ret = 1;
     char **argv = NULL;
 
     if (!flexop_iopt.initialized)
         flexop_error(1, "%s must be called after flexop_init!\n", __func__);
 
-    if (str == NULL) return;
+    flexop_diags_clear(&flexop_diags);
 
-    flexop_parse_options(&argc, &argv, &argc_allocated, str);
-    flexop_parse_cmdline(argc, &argv);
+    if (str == NULL) return 1;
 
-    for (i = 0; i < argc; i++) flexop_free(argv[i]);
+    /* all options are checked before any is set */
+    if (!flexop_split_options(&argc, &argv, &alloc, str)) {
+        flexop_diag_add(&flexop_diags, NULL, FLEXOP_SRC_SET, -1, "unbalanced quotes");
+    }
+    else {
+        flexop_check_argv(argc, argv, &flexop_diags);
+    }
+
+    if (flexop_diags.n > 0) {
+        for (i = 0; i < flexop_diags.n; i++) {
+            if (flexop_error_mode == FLEXOP_ERRORS_EXIT) {
+                flexop_error(i + 1 == flexop_diags.n, "%s.\n", flexop_diags.d[i].reason);
+            }
+            else {
+                flexop_warning("%s.\n", flexop_diags.d[i].reason);
+            }
+        }
+
+        ret = 0;
+    }
+    else if (flexop_error_mode == FLEXOP_ERRORS_RETURN) {
+        /* nothing is changed if a handler fails */
+        ret = flexop_apply(argc, argv, FLEXOP_SRC_SET, NULL, NULL, &flexop_diags);
+    }
+    else {
+        flexop_parse_cmdline_from(argc, &argv, FLEXOP_SRC_SET, NULL, NULL, 0);
+    }
 
+    for (i = 0; i < argc; i++) flexop_free(argv[i]);
     flexop_free(argv);
+
+    return ret;
 }
 
 int flexop_set_bool(const char *op_name, int value)
@@ -1765,6 +3515,16 @@ int flexop_set_float(const char *op_name, FLEXOP_FLOAT value)
     return set_option(op_name, &value, VT_FLOAT, __func__);
 }
 
+int flexop_set_size(const char *op_name, FLEXOP_SIZE value)
+{
+    return set_option(op_name, &value, VT_SIZE, __func__);
+}
+
+int flexop_set_duration(const char *op_name, FLEXOP_DURATION value)
+{
+    return set_option(op_name, &value, VT_DURATION, __func__);
+}
+
 int flexop_set_keyword(const char *op_name, const char *value)
 {
     return set_option(op_name, (void *)value, VT_KEYWORD, __func__);
@@ -1799,3 +3559,13 @@ int flexop_set_vec_string(const char *op_name, const char *value)
 {
     return set_option(op_name, (void *)value, VT_VEC_STRING, __func__);
 }
+
+int flexop_set_vec_size(const char *op_name, const char *value)
+{
+    return set_option(op_name, (void *)value, VT_VEC_SIZE, __func__);
+}
+
+int flexop_set_vec_duration(const char *op_name, const char *value)
+{
+    return set_option(op_name, (void *)value, VT_VEC_DURATION, __func__);
+}